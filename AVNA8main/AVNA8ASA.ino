@@ -22,183 +22,690 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+/* The 512 bin spectrum is averaged per ASAAveMode, see specAveR2.h.  Block
+ * mode shows a new trace every SAnAve frames, the others every frame.  The
+ * result, pwr[], is always scaled as a sum of SAnAve frames of power so that
+ * the display, serial data and distortion numbers are the same for all modes.
+ */
 void doFFT(void)
   {
-  float32_t specDB, pTemp;
   static uint16_t countMax = 10;  //  Make global and user adjustable
   static uint16_t countAve = 0;
-  float32_t aveFactorDB;
-  static float32_t avePower[512];
-  uint16_t iiMax;
-  float32_t vm, vc, vp, R;
+  float32_t aveFactorDB, nAve;
+  static float32_t avePower[512];    // Sum, average or hold, power or dB
+  static float32_t tracePower[512];  // Frame in dB, and pwr[] when not avePower
+  static bool zoomWaiting = false;   // For the work area, see setASAZoom()
+  const float32_t *pFrame;
+  float32_t *pwr;
+  uint16_t nAveNow;
 
-  if (fft1024p.available())
+  bool zoomOn = (zoomFFT.getZoom() > 0);
+
+  // Zoom gave the work area up, or can have it back.  Redo the display
+  // either way, see setASAZoom().
+  if(ASADual == ASA_DUAL_OFF && ASAZoom > 1 &&
+     (zoomWaiting != !zoomOn || (!zoomOn && workUser == WORK_FREE)))
+    {
+    prepSpectralDisplay();
+    zoomOn = (zoomFFT.getZoom() > 0);
+    zoomWaiting = !zoomOn;
+    }
+  if(ASADual != ASA_DUAL_OFF)
     {
- //   aveFactorDB = 10.0f*log10f(countMax);
-    aveFactorDB = 10.0f*log10f((float)freqASA[ASAI2SFreqIndex].SAnAve);
+    // avePower[] is free, and the restart below clears it on the way back
+    doDualFFT(tracePower, avePower);
+    return;
+    }
+  if(ASARestartAve)     // Span or mode changed, partial average is no good
+    {
+    ASARestartAve = false;
+    countAve = 0;
+    }
+  if ( (zoomOn && zoomFFT.available()) || (!zoomOn && fft1024p.available()) )
+    {
+    nAve = (float32_t)freqASA[ASAI2SFreqIndex].SAnAve;
+    aveFactorDB = 10.0f*log10f(nAve);
     specMax = -200.0f;
-    for (int ii=0; ii<512; ii++)
+    // zoomFFT has the same scaling as fft1024p, 0.0 for sine wave full scale
+    pFrame = zoomOn ? zoomFFT.getOutput() : fft1024p.getOutput();
+    if(ASALogAve)
       {
-      avePower[ii] += fft1024p.read(ii);   // Power average, 0.0 for sine wave full scale down to -80 or so
+      specToDB(tracePower, pFrame, 512);
+      pFrame = tracePower;
       }
+    if(countAve == 0)           // Any mode starts from one frame
+      memcpy(avePower, pFrame, 512*sizeof(float32_t));
+    else if(ASAAveMode == ASA_AVE_EXP)
+      {
+      // Until SAnAve frames are in, this is the plain average
+      nAveNow = countAve + 1;
+      if(nAveNow > freqASA[ASAI2SFreqIndex].SAnAve)
+        nAveNow = freqASA[ASAI2SFreqIndex].SAnAve;
+      specExpAve(avePower, pFrame, 1.0f/(float32_t)nAveNow, 512);
+      }
+    else if(ASAAveMode == ASA_AVE_MAX)
+      specMaxHold(avePower, pFrame, 512);
+    else if(ASAAveMode == ASA_AVE_MIN)
+      specMinHold(avePower, pFrame, 512);
+    else
+      specAdd(avePower, pFrame, 512);
+    if(countAve < 65535)
+      countAve++;
 
-      if(++countAve >= freqASA[ASAI2SFreqIndex].SAnAve)
+    if(ASAAveMode != ASA_AVE_BLOCK || countAve >= freqASA[ASAI2SFreqIndex].SAnAve)
       {
-      specMax = 0.0f; iiMax = 0;
-      for(int ii=0; ii<512; ii++)
+      pwr = tracePower;
+      if(ASALogAve && ASAAveMode == ASA_AVE_BLOCK)   // Mean of the dB sum
+        specFromDB(pwr, avePower, 1.0f/(float32_t)countAve, nAve, 512);
+      else if(ASALogAve)
+        specFromDB(pwr, avePower, 1.0f, nAve, 512);
+      else if(ASAAveMode == ASA_AVE_BLOCK)
+        pwr = avePower;                 // Already the sum
+      else
+        specScale(pwr, avePower, nAve, 512);
+
+      ASAPeakAndDistortion(pwr, aveFactorDB);
+      ASAPowerToPixels(pixelnew, pwr, aveFactorDB);
+      show_spectrum();
+      ASASendSpectrum(pwr);
+
+      if(ASAAveMode == ASA_AVE_BLOCK)    // Start the next block
+        countAve = 0;
+      }  // End, if averging is finished
+    }  // End, if fft available
+  }
+
+/* Dual channel ASA, for ASADual not ASA_DUAL_OFF.  fft2 transforms the
+ * measure (y, channel 0) and reference (x, channel 1) inputs as one complex
+ * FFT and sums the auto and cross spectra, in place of fft1024p.  Both
+ * spectra cost about what fft1024p does alone.  The window is Hann, the
+ * same as fft1024p.  The average is always a block of SAnAve frames, so
+ * ASAAveMode and ASALogAve do not apply.  pwr[] is the measure spectrum,
+ * scaled as in doFFT(), and the peak, distortion and log come from it as
+ * usual.  ref[] is the reference spectrum.  SPECTRUM data is all of the
+ * spectra, see sendXSpectrum().  The screen has
+ *   ASA_DUAL_AUTO   Measure (white) and reference (cyan) spectra, dBm
+ *   ASA_DUAL_GAIN   |H1| = |Gxy|/Gxx in dB (white) and coherence (cyan)
+ *   ASA_DUAL_PHASE  Phase of Gxy, -180 to 180 deg (white) and coherence
+ * Coherence is full scale, 0 at the bottom and 1 at the top.  A pixel
+ * combines 2 bins by summing Gxx, Gyy and Gxy over the pair.
+ */
+void doDualFFT(float32_t *pwr, float32_t *ref)
+  {
+  float32_t nAve, aveFactorDB, gxx, gyy, re, im, re2, im2, dB, coh;
+  uint16_t nFrames = freqASA[ASAI2SFreqIndex].SAnAve;
+
+  if(workUser != WORK_ASA_DUAL)     // fft2 needs the work area, see workTake()
+    {
+    if(!workTake(WORK_ASA_DUAL))
+      return;
+    ASARestartAve = true;
+    }
+  if(ASARestartAve || (!fft2.busy() && !fft2.available()))
+    {
+    ASARestartAve = false;
+    AudioNoInterrupts();
+    fft2.start(nFrames, workArea);
+    AudioInterrupts();
+    return;
+    }
+  if(!fft2.available())
+    return;
+
+  nAve = (float32_t)fft2.frames();     // SAnAve may have changed since start
+  aveFactorDB = 10.0f*log10f(nAve);
+  for(int ii=0; ii<512; ii++)
+    {
+    pwr[ii] = nAve*fft2.autoY(ii);
+    ref[ii] = nAve*fft2.autoX(ii);
+    }
+  ASAPeakAndDistortion(pwr, aveFactorDB);
+
+  if(ASADual == ASA_DUAL_AUTO)
+    {
+    ASAPowerToPixels(pixelnew, pwr, aveFactorDB);
+    ASAPowerToPixels(pixel2, ref, aveFactorDB);
+    }
+  else
+    {
+    for(int ii=0; ii<255; ii++)
+      {
+      gxx = ref[2*ii] + ref[2*ii+1];
+      gyy = pwr[2*ii] + pwr[2*ii+1];
+      fft2.cross(2*ii, &re, &im);
+      fft2.cross(2*ii+1, &re2, &im2);
+      re = nAve*(re + re2);
+      im = nAve*(im + im2);
+      coh = (gxx > 0.0f && gyy > 0.0f) ? (re*re + im*im)/(gxx*gyy) : 0.0f;
+      if(ASADual == ASA_DUAL_GAIN)
         {
-        if (avePower[ii] > specMax)  // Find highest peak of 512
-          {
-          specMax = avePower[ii];
-          iiMax = ii;
-          }
+        if(gxx > 0.0f && (re*re + im*im) > 0.0f)
+          dB = 10.0f*log10f((re*re + im*im)/(gxx*gxx));
+        else
+          dB = -150.0f;
+        pixelnew[ii] = (int16_t)(160.0f+20.0f*(ASAdbOffset+dB)/dbPerDiv);
+        if (pixelnew[ii] < 0)
+          pixelnew[ii] = 0;
         }
+      else       // 0 deg is mid screen
+        pixelnew[ii] = (int16_t)(80.5f + 0.444444f*57.29578f*atan2f(im, re));
+      pixel2[ii] = (int16_t)(160.0f*coh + 0.5f);
+      }
+    }
+  show_spectrum();
+  ASASendSpectrum(pwr);
+
+  AudioNoInterrupts();       // Next block of frames
+  fft2.start(nFrames, workArea);
+  AudioInterrupts();
+  }
+
+// Peak level and frequency for the top corners, then distortion and the log.
+// pwr[] is a sum of frames, aveFactorDB is 10*log10 of the number.
+void ASAPeakAndDistortion(float32_t *pwr, float32_t aveFactorDB)
+  {
+  uint16_t iiMax;
+  bool zoomOn = (zoomFFT.getZoom() > 0);
+
+  specMax = 0.0f; iiMax = 0;
+  for(int ii=0; ii<512; ii++)
+    {
+    if (pwr[ii] > specMax)  // Find highest peak of 512
+      {
+      specMax = pwr[ii];
+      iiMax = ii;
+      }
+    }
+
+  // Power at peak for top left corner, use 3 bins
+  if(iiMax < 2)
+     pwr10 = pwr[0] + pwr[1];
+  else if(iiMax>509)
+     pwr10 = pwr[510] + pwr[511];
+  else
+     pwr10 = pwr[iiMax] + pwr[iiMax + 1] + pwr[iiMax - 1];
+  pwr10DB = 10*log10f(pwr10) - aveFactorDB;
+
+  // Interpolate peak frequency for top right corner, see interpolatePeakBin()
+  if(iiMax<2 && !zoomOn)
+    specMaxFreq = 0.0f;  // DC term is problematic.  Reduce sample rate for low frequencies.
+  else if(zoomOn)
+    specMaxFreq = ASAFreqOfBin(interpolatePeakBin(pwr, iiMax));
+  else   // 0.05 Hz upward error makes display more readable
+    specMaxFreq = 0.05f + ASAFreqOfBin(interpolatePeakBin(pwr, iiMax));
 
-      // Power at peak for top left corner, use 3 bins
-      if(iiMax < 2)
-         pwr10 = avePower[0] + avePower[1];
-      else if(iiMax>509)
-         pwr10 = avePower[510] + avePower[511];
+  // THD, THD+N, SINAD and S/N from the same averaged spectrum
+  analyzeDistortion(pwr);
+  logASA();
+  }
+
+// Screen trace of 255 pixels, 2 bins each, from a sum of frames of power
+void ASAPowerToPixels(int16_t *pixel, float32_t *pwr, float32_t aveFactorDB)
+  {
+  float32_t specDB, pTemp;
+
+  for(int ii=0; ii<255; ii++)
+    {
+    // Combine 2 bins for each pixel, convert to dB
+    pTemp = pwr[2*ii] + pwr[2*ii+1];
+
+    if (pTemp > 0.0f)   // Don't log zero
+      specDB = uSave.lastState.SAcalCorrectionDB + 10.0f*log10f(pTemp) - aveFactorDB;
+    else
+      specDB = -90.288f;  // 6 dB below lsb, arbitrary
+
+    // pixel[]   0=bottom of display, 160=top.
+    pixel[ii] = (int16_t)(160.0f+20.0f*(ASAdbOffset+specDB)/dbPerDiv);
+    if (pixel[ii] < 0)
+       pixel[ii] = 0;
+    }   // End, over all 256 pixels
+  }
+
+/* The nRun and doRun for ASA only refer to sending data over serial
+ * The on-screen stuff continues.  ASASerialFormat has the following:
+ *  1  = Comma dividers
+ *  2  = Space Dividers (can be after comma)
+ *  4  = Column of 512 (0 is row of 512)
+ *  8  = CR-LF not just LF (for columns)
+ * 16  = Leading/Trailing '|'
+ * 32  = dB, not power
+ * 64  = Append distortion line
+ *128  = Distortion line only
+ * In a dual channel mode the spectrum is sendXSpectrum() in place of the above.
+ */
+void ASASendSpectrum(float32_t *pwr)
+  {
+  if(nRun>=0 && doRun!=RUNNOT)
+    {
+    if( !(ASASerialFormat & 128) )
+      {
+      if(ASADual != ASA_DUAL_OFF)
+        sendXSpectrum(Serial);
+      else if(binaryOut)
+        sendASAFrame(Serial, pwr);
       else
-         pwr10 = avePower[iiMax] + avePower[iiMax + 1] + avePower[iiMax - 1];
-      pwr10DB = 10*log10f(pwr10) - aveFactorDB;
-      // Serial.print(iiMax-1);  Serial.print(" <iiMax-1    avePower[iiMax]> ");  Serial.println(avePower[iiMax-1]/(float)countMax, 5);
-      // Serial.print(iiMax);    Serial.print(" <iiMax      avePower[iiMax]> ");  Serial.println(avePower[iiMax]  /(float)countMax, 5);
-      // Serial.print(iiMax+1);  Serial.print(" <iiMax+1    avePower[iiMax]> ");  Serial.println(avePower[iiMax+1]/(float)countMax, 5);
-
-      // Interpolate peak frequency for top right corner per DerekR/Granke procedure
-      // Following from DerekR
-      // https://forum.pjrc.com/threads/36358-A-New-Accurate-FFT-Interpolator-for-Frequency-Estimation
-      // " 1) A record of length 1024 samples is windowed with a Hanning window
-      //   2) The magnitude spectrum is computed from the FFT, and the two (adjacent)
-      //      largest amplitude lines are found.  Let the largest be line L, and the
-      //      other be either L+1, of L-1.
-      //   3) Compute the ratio R of the amplitude of the two largest lines.
-      //   4) If the amplitude of L+1 is greater than L-1 then
-      //              f = (L + (2-R)/(1+R))*f_sample/1024
-      //        otherwise
-      //              f = (L - (2-R)/(1+R))*f_sample/1024  "
-      vm = 0.0000001; vp = 0.0000001;  // Stop compiler warning
-      if (iiMax > 0)
-        vm = sqrtf(avePower[iiMax - 1]);
-      vc = sqrtf(avePower[iiMax]);
-      if (iiMax < 511)
-        vp = sqrtf(avePower[iiMax + 1]);
-      if(iiMax<2)
-        specMaxFreq = 0.0f;  // DC term is problematic.  Reduce sample rate for low frequencies.
-      else if(vp > vm)
-        {
-        R = vc/vp;
-        // 0.05 Hz upward error makes display more readable
-        specMaxFreq = 0.05f + ( (float32_t)iiMax + (2-R)/(1+R) )*freqASA[ASAI2SFreqIndex].sampleRate/1024.0f;
-        }
-      else if(iiMax==511 || vp < vm)
-        {
-        R = vc/vm;
-        specMaxFreq = 0.05f + ( (float32_t)iiMax - (2-R)/(1+R) )*freqASA[ASAI2SFreqIndex].sampleRate/1024.0f;
-        }
+        printASAData(Serial, pwr);
+      }
+    if(ASASerialFormat & (64 | 128))
+      printDistortion();
 
-      /* SINAD & Distortion Analysis use the SA with sample rate of 12KHz.  This gives bin spacing of
-       * 11.71875 Hz.  The bin85 is at 996.094 and will be used as notch center.  Notch out
-       * 5 bins and add the center 3 together as signal.  Cut the bottom off at 300 Hz (bin26 is 305)
-       * and at 4kHz (bin 342 is 4008 Hz).  That includes the 4th harmonic for SINAD purposes.
-       */
-      sinadNoisePower = 0.0f;           // Denominator for S/N and SINAD
-      for(int ii=26;  ii<83;  ii++)     // Omit edges, 57 bins here
-         sinadNoisePower += avePower[ii];
-      for(int ii=88;  ii<343;  ii++)    // 4 kHz top, 255 bins here
-         sinadNoisePower += avePower[ii];
-      sinadNoisePowerDB = 10.0f*log10f(sinadNoisePower);
-      signalOnlyPower = avePower[84] + avePower[85] + avePower[86];  // S/N numerator
-      signalOnlyPowerDB = 10.0f*log10f(signalOnlyPower);
-      // Interestingly, SINAD numerator is sig+noise+distortion
-      sinadSignalPower = sinadNoisePower + signalOnlyPower;
-      sinadSignalPowerDB = 10*log10f(sinadSignalPower);
-
- // Serial.print(sinadNoisePowerDB, 3);  Serial.print(" <--Noise  Signal--> "); Serial.println(sinadSignalPowerDB, 3);
-
-      // Find x-y  for spectral plot
-      for(int ii=0; ii<255; ii++)
-        {
-        // Combine 2 bins for each pixel, convert to dB
-        pTemp = avePower[2*ii] + avePower[2*ii+1];
+    if(nRun>0 && --nRun==0)
+      {
+      nRun = -1;
+      doRun = RUNNOT;;  // Don't go continuous
+      }
+    }
+  }
 
-        if (pTemp > 0.0f)   // Don't log zero
-          specDB = uSave.lastState.SAcalCorrectionDB + 10.0f*log10f(pTemp) - aveFactorDB;
-        else
-          specDB = -90.288f;  // 6 dB below lsb, arbitrary
+/* Dual channel spectra from fft2, powers as a sum of SAnAve frames.  Binary
+ * is a BF_XSPEC frame.  Text is a line per bin, 1 to 511,
+ *   XS,Hz,ref dB,meas dB,gain dB,phase deg,coherence
+ * with dB as SPECTRUM format 32, and then XS,END,frames
+ */
+void sendXSpectrum(Print &p)
+  {
+  float32_t nAve, gxx, gyy, re, im, binHz;
+  float32_t v[5];
+  char line[96];
 
-        // pixelnew[]   0=bottom of display, 160=top.
-        pixelnew[ii] = (int16_t)(160.0f+20.0f*(ASAdbOffset+specDB)/dbPerDiv);
-        if (pixelnew[ii] < 0)
-           pixelnew[ii] = 0;
-        }   // End, over all 256 pixels
+  nAve = (float32_t)fft2.frames();
+  binHz = ASABinHz();
+  if(binaryOut)
+    {
+    BinFrame bf(p);
+    bf.begin(BF_XSPEC, 512, sizeof(v), ASAFreqOfBin(0.0f), binHz);
+    for(uint16_t k=0; k<512; k++)
+      {
+      v[0] = nAve*fft2.autoX(k);
+      v[1] = nAve*fft2.autoY(k);
+      fft2.cross(k, &re, &im);
+      v[2] = nAve*re;
+      v[3] = nAve*im;
+      v[4] = fft2.coherence(k);
+      bf.add(v, sizeof(v));
+      }
+    bf.end();
+    return;
+    }
+  FormatBuffer fb(p, line, sizeof(line));
+  if(annotate)
+    fb.addStr("XS, Hz, ref dB, meas dB, gain dB, phase deg, coherence\r\n");
+  for(uint16_t k=1; k<512; k++)
+    {
+    gxx = nAve*fft2.autoX(k);
+    gyy = nAve*fft2.autoY(k);
+    fft2.cross(k, &re, &im);
+    fb.addStr("XS,");
+    fb.addFloat(binHz*(float32_t)k, 2);
+    fb.addChar(',');
+    fb.addFloat(gxx > 0.0f ? 10.0f*log10f(gxx) : -150.0f, 3);
+    fb.addChar(',');
+    fb.addFloat(gyy > 0.0f ? 10.0f*log10f(gyy) : -150.0f, 3);
+    fb.addChar(',');
+    if(gxx > 0.0f && (re*re + im*im) > 0.0f)
+      fb.addFloat(10.0f*log10f((re*re + im*im)/(gxx*gxx)), 3);
+    else
+      fb.addStr("-200.000");
+    fb.addChar(',');
+    fb.addFloat(fft2.phase(k), 2);
+    fb.addChar(',');
+    fb.addFloat(fft2.coherence(k), 4);
+    fb.addStr("\r\n");
+    }
+  fb.flush();
+  p.print("XS,END,");
+  p.println(fft2.frames());
+  }
 
-      show_spectrum();
-      countAve = 0;
-
-      /* The nRun and doRun for ASA only refer to sending data over serial
-       * The on-screen stuff continues.  ASASerialFormat has the following:
-       *  1  = Comma dividers
-       *  2  = Space Dividers (can be after comma)
-       *  4  = Column of 512 (0 is row of 512)
-       *  8  = CR-LF not just LF (for columns)
-       * 16  = Leading/Trailing '|'
-       * 32  = dB, not power          */
-      if(nRun>=0 && doRun!=RUNNOT)
-        {
-        if(ASASerialFormat & 16)
-          Serial.print("|");
-        for (int ii=0; ii<512; ii++)
-          {
-          if(ASASerialFormat & 32)
-            if (avePower[ii] <= 0.0f)
-              Serial.print("-150.000");
-            else
-              Serial.print(10.0f*log10f(avePower[ii]), 3);
-          else
-            Serial.print(avePower[ii],8);
-          if((ASASerialFormat & 1) && ii<511)
-            Serial.print(",");
-          if(ASASerialFormat & 2)
-            Serial.print(" ");
-          if(ASASerialFormat & 8)
-            Serial.print("\r");
-          if(ASASerialFormat & 4)
-            Serial.print("\n");
-          }
-        if(ASASerialFormat & 16)
-          Serial.println("|");
-
-        if(nRun>0 && --nRun==0)
-          {
-          nRun = -1;
-          doRun = RUNNOT;;  // Don't go continuous
-          }
-        }
-      for(int ii=0; ii<512; ii++)    // Clear powers for next measurement
-        avePower[ii] = 0.0f;
-      }  // End, if averging is finished
-    }  // End, if fft available
+// The 512 averaged powers as a frame.  ASASerialFormat & 32 selects 0.01 dB
+// int16 (BF_SPECTRUM_CDB), otherwise float32 power.
+void sendASAFrame(Print &p, float32_t *avePower)
+  {
+  int16_t cdB[128];
+  float32_t dB;
+  BinFrame bf(p);
+
+  if(ASASerialFormat & 32)
+    {
+    bf.begin(BF_SPECTRUM_CDB, 512, 2, ASAFreqOfBin(0.0f), ASABinHz());
+    for (int ii=0; ii<512; ii++)
+      {
+      dB = (avePower[ii] <= 0.0f ? -150.0f : 10.0f*log10f(avePower[ii]));
+      if(dB < -327.0f)  dB = -327.0f;
+      if(dB >  327.0f)  dB =  327.0f;
+      cdB[ii & 127] = (int16_t)lrintf(100.0f*dB);
+      if((ii & 127) == 127)
+        bf.add(cdB, sizeof(cdB));
+      }
+    }
+  else
+    {
+    bf.begin(BF_SPECTRUM_F32, 512, 4, ASAFreqOfBin(0.0f), ASABinHz());
+    bf.add(avePower, 512*sizeof(float32_t));
+    }
+  bf.end();
+  }
+
+// The 512 averaged powers, formatted per ASASerialFormat.  The text is
+// as from print(x, 8) or print(dB, 3), but by formatR2 and a buffer
+// full at a time.
+void printASAData(Print &p, float32_t *avePower)
+  {
+  char buf[256];
+  FormatBuffer fb(p, buf, sizeof(buf));
+
+  if(ASASerialFormat & 16)
+    fb.addChar('|');
+  for (int ii=0; ii<512; ii++)
+    {
+    if(ASASerialFormat & 32)
+      if (avePower[ii] <= 0.0f)
+        fb.addStr("-150.000");
+      else
+        fb.addFloat(10.0f*log10f(avePower[ii]), 3);
+    else
+      fb.addFloat(avePower[ii], 8);
+    if((ASASerialFormat & 1) && ii<511)
+      fb.addChar(',');
+    if(ASASerialFormat & 2)
+      fb.addChar(' ');
+    if(ASASerialFormat & 8)
+      fb.addChar('\r');
+    if(ASASerialFormat & 4)
+      fb.addChar('\n');
+    }
+  if(ASASerialFormat & 16)
+    fb.addStr("|\r\n");
+  fb.flush();
+  }
+
+/* Interpolate the fractional bin of a spectral peak per DerekR/Granke procedure
+ * https://forum.pjrc.com/threads/36358-A-New-Accurate-FFT-Interpolator-for-Frequency-Estimation
+ * " 1) A record of length 1024 samples is windowed with a Hanning window
+ *   2) The magnitude spectrum is computed from the FFT, and the two (adjacent)
+ *      largest amplitude lines are found.  Let the largest be line L, and the
+ *      other be either L+1, of L-1.
+ *   3) Compute the ratio R of the amplitude of the two largest lines.
+ *   4) If the amplitude of L+1 is greater than L-1 then
+ *              f = (L + (2-R)/(1+R))*f_sample/1024
+ *        otherwise
+ *              f = (L - (2-R)/(1+R))*f_sample/1024  "
+ * Input is power, so sqrt for amplitude.  Returns bin number, not Hz.
+ */
+float32_t interpolatePeakBin(float32_t *pwr, uint16_t iPk)
+  {
+  float32_t vm, vc, vp, R;
+
+  vm = 0.0000001; vp = 0.0000001;  // Stop compiler warning
+  if (iPk > 0)
+    vm = sqrtf(pwr[iPk - 1]);
+  vc = sqrtf(pwr[iPk]);
+  if (iPk < 511)
+    vp = sqrtf(pwr[iPk + 1]);
+  if(vp > vm)
+    {
+    R = vc/vp;
+    return (float32_t)iPk + (2-R)/(1+R);
+    }
+  else if(iPk==511 || vp < vm)
+    {
+    R = vc/vm;
+    return (float32_t)iPk - (2-R)/(1+R);
+    }
+  return (float32_t)iPk;
+  }
+
+// Bin spacing in Hz for avePower[], full span or zoom
+float32_t ASABinHz(void)
+  {
+  if(zoomFFT.getZoom() > 0)
+    return zoomFFT.getBinHz();
+  return freqASA[ASAI2SFreqIndex].sampleRate/1024.0f;
+  }
+
+// Frequency in Hz of a (fractional) avePower[] bin
+float32_t ASAFreqOfBin(float32_t bin)
+  {
+  if(zoomFFT.getZoom() > 0)
+    return zoomFFT.getStartFreq() + bin*zoomFFT.getBinHz();
+  return bin*freqASA[ASAI2SFreqIndex].sampleRate/1024.0f;
+  }
+
+// Name of the averaging mode, for the LCD and verbose serial
+const char *ASAAveName(void)
+  {
+  static const char *names[8] = {"Block", "Exponential", "Max hold", "Min hold",
+                  "Block, dB", "Exponential, dB", "Max hold, dB", "Min hold, dB"};
+  return names[(ASAAveMode & 3) + (ASALogAve ? 4 : 0)];
+  }
+
+/* Zoom is only run for the ASA.  The center is kept far enough from 0 and
+ * fs/2 that the span does not fold over.  Called with every display prep
+ * since that follows any sample rate change.
+ */
+void setASAZoom(void)
+  {
+  float32_t halfSpan;
+
+  if(instrument!=ASA || ASAZoom<2 || ASADual!=ASA_DUAL_OFF)   // fft2 is full span
+    {
+    // Zoom frames must not go into a full span average, and fft2 may
+    // have frames of the old rate
+    if(zoomFFT.getZoom() > 0 || ASADual != ASA_DUAL_OFF)
+      ASARestartAve = true;
+    ASAZoomOff();
+    return;
+    }
+  if(!workTake(WORK_ZOOM))    // Full span until it is free, see doFFT()
+    {
+    ASAZoomOff();
+    return;
+    }
+  halfSpan = 0.25f*(float32_t)sampleRateExact/(float32_t)ASAZoom;
+  if(ASAZoomCenter < halfSpan)
+    ASAZoomCenter = halfSpan;
+  if(ASAZoomCenter > 0.5f*(float32_t)sampleRateExact - halfSpan)
+    ASAZoomCenter = 0.5f*(float32_t)sampleRateExact - halfSpan;
+  AudioNoInterrupts();
+  zoomFFT.setZoom(ASAZoom, ASAZoomCenter, (float32_t)sampleRateExact, workArea);
+  AudioInterrupts();
+  ASARestartAve = true;
+  }
+
+// Zoom off, and the work area back if zoom had it
+void ASAZoomOff(void)
+  {
+  AudioNoInterrupts();
+  zoomFFT.setZoom(0, 0.0f, 0.0f);
+  AudioInterrupts();
+  workGive(WORK_ZOOM);
+  }
+
+// fft2 off, and the work area back, when the dual modes are off
+void ASADualOff(void)
+  {
+  if(workUser != WORK_ASA_DUAL)
+    return;
+  AudioNoInterrupts();
+  fft2.end();
+  AudioInterrupts();
+  workGive(WORK_ASA_DUAL);
+  }
+
+/* Distortion analysis on the averaged power spectrum, any sample rate.
+ * The fundamental is the largest line between distFreqLow and distFreqHigh, with
+ * its frequency interpolated.  Fundamental and harmonics 2 to distNHarmonics
+ * are each summed over +/-distBinSpan bins around their (fractional) center
+ * so that the window main lobe is captured.  Everything else in the band is noise.
+ * Since all quantities are sums of bin powers, the window noise bandwidth
+ * cancels in the ratios.  Harmonics above fs/2, or outside of a zoom span,
+ * are not counted.  Results go to
+ * the dist... globals in dB (and THD in %).
+ */
+void analyzeDistortion(float32_t *pwr)
+  {
+  float32_t binHz, fStart, fBin, totalPower, hp;
+  int16_t kLow, kHigh, kPk, kc, k1, k2, lastK;
+
+  distValid = false;
+  binHz = ASABinHz();
+  fStart = ASAFreqOfBin(0.0f);
+  kLow = (int16_t)((distFreqLow - fStart)/binHz + 0.5f);
+  if(fStart == 0.0f && kLow <= (int16_t)distBinSpan)
+    kLow = distBinSpan + 1;          // Stay out of the DC main lobe
+  else if(kLow < 0)
+    kLow = 0;
+  kHigh = (int16_t)((distFreqHigh - fStart)/binHz + 0.5f);
+  if(kHigh > 511)
+    kHigh = 511;
+  if(kHigh - kLow < 4*(int16_t)distBinSpan)
+    return;
+
+  totalPower = 0.0f;  kPk = kLow;
+  for(int16_t k=kLow; k<=kHigh; k++)
+    {
+    totalPower += pwr[k];
+    if(pwr[k] > pwr[kPk])
+      kPk = k;
+    }
+  if(pwr[kPk] <= 0.0f)
+    return;
+  fBin = interpolatePeakBin(pwr, kPk);
+  distFundFreq = ASAFreqOfBin(fBin);
+
+  distFundPower = 0.0f;
+  k1 = kPk - distBinSpan;   if(k1 < kLow)  k1 = kLow;
+  k2 = kPk + distBinSpan;   if(k2 > kHigh) k2 = kHigh;
+  for(int16_t k=k1; k<=k2; k++)
+    distFundPower += pwr[k];
+  lastK = k2;
+
+  // Harmonic spans are clipped so that no bin is counted twice
+  distHarmPower = 0.0f;
+  distHarmDB[0] = 0.0f;  distHarmDB[1] = 0.0f;
+  for(uint16_t nh=2; nh<=DIST_MAX_HARMONIC; nh++)
+    {
+    distHarmDB[nh] = -200.0f;
+    if(nh > distNHarmonics)
+      continue;
+    kc = (int16_t)(((float32_t)nh*distFundFreq - fStart)/binHz + 0.5f);
+    k1 = kc - distBinSpan;   if(k1 <= lastK)  k1 = lastK + 1;
+    k2 = kc + distBinSpan;   if(k2 > kHigh) k2 = kHigh;
+    if(k1 > k2)
+      continue;
+    hp = 0.0f;
+    for(int16_t k=k1; k<=k2; k++)
+      hp += pwr[k];
+    distHarmPower += hp;
+    if(hp > 0.0f)
+      distHarmDB[nh] = 10.0f*log10f(hp/distFundPower);
+    lastK = k2;
+    }
+
+  distNoisePower = totalPower - distFundPower - distHarmPower;
+  if(distNoisePower < 1.0E-15f)
+    distNoisePower = 1.0E-15f;
+  if(distHarmPower < 1.0E-15f)
+    distHarmPower = 1.0E-15f;
+  distTHDDB = 10.0f*log10f(distHarmPower/distFundPower);
+  distTHDPct = 100.0f*sqrtf(distHarmPower/distFundPower);
+  distTHDNDB = 10.0f*log10f((distHarmPower + distNoisePower)/distFundPower);
+  distSINADDB = 10.0f*log10f(totalPower/(distHarmPower + distNoisePower));
+  distSNRDB = 10.0f*log10f(distFundPower/distNoisePower);
+  distValid = true;
+  }
+
+// Serial line of distortion results, for SPECTRUM format 64 or 128
+void printDistortion(void)
+  {
+  if(!distValid)
+    {
+    Serial.println("DIST,---");
+    return;
+    }
+  Serial.print("DIST,");
+  Serial.print(distFundFreq, 2);  Serial.print(",");
+  Serial.print(uSave.lastState.SAcalCorrectionDB + 10.0f*log10f(distFundPower)
+        - 10.0f*log10f((float)freqASA[ASAI2SFreqIndex].SAnAve), 3);
+  Serial.print(",");
+  Serial.print(distTHDDB, 3);    Serial.print(",");
+  Serial.print(distTHDPct, 5);   Serial.print(",");
+  Serial.print(distTHDNDB, 3);   Serial.print(",");
+  Serial.print(distSINADDB, 3);  Serial.print(",");
+  Serial.print(distSNRDB, 3);
+  for(uint16_t nh=2; nh<=distNHarmonics; nh++)
+    {
+    Serial.print(",");
+    Serial.print(distHarmDB[nh], 2);
+    }
+  Serial.println("");
   }
 
 void prepSpectralDisplay(void)
   {
   tft.fillRect(0, 0, 320, 200, ILI9341_BLACK);
+  topLinesValid = false;
   //Annotate the y-axis
   tft.setTextColor(ILI9341_WHITE);
   tft.setFont(Arial_10);
-  tft.setCursor(95, 3);
-  tft.print("Audio Spectrum Analyzer");
+  if(ASADual == ASA_DUAL_OFF)
+    {
+    tft.setCursor(95, 3);
+    tft.print("Audio Spectrum Analyzer");
+    }
+  else
+    {
+    // White is measure, cyan is reference or coherence, 0 to 1 full scale
+    tft.setCursor(60, 3);
+    if(ASADual == ASA_DUAL_AUTO)
+      tft.print("Dual ASA  Meas, ");
+    else if(ASADual == ASA_DUAL_GAIN)
+      tft.print("Dual ASA  Gain, ");
+    else
+      tft.print("Dual ASA  Phase, ");
+    tft.setTextColor(ILI9341_CYAN);
+    tft.print(ASADual == ASA_DUAL_AUTO ? "Ref" : "Coherence");
+    tft.setTextColor(ILI9341_WHITE);
+    }
   for(int ii = 0; ii<5; ii++)
      {
      tft.setCursor(8, spectrum_y-4+40*ii);
-     tft.print(-ASAdbOffset-2*ii*(int)dbPerDiv, 0);
+     if(ASADual == ASA_DUAL_PHASE)
+       tft.print(180-90*ii);
+     else
+       tft.print(-ASAdbOffset-2*ii*(int)dbPerDiv, 0);
      }
   tft.setCursor(10 , spectrum_y+16);
-  tft.print("dBm");
+  if(ASADual == ASA_DUAL_PHASE)
+    tft.print("deg");
+  else if(ASADual == ASA_DUAL_GAIN)
+    tft.print("dB");
+  else
+    tft.print("dBm");
 
+  setASAZoom();
   // Anotate the x-axis
+  if(zoomFFT.getZoom() > 0)
+     {
+     float32_t span = 512.0f*ASABinHz();
+     for(int ii = 0; ii<6; ii++)
+       {
+       tft.setCursor(37+43*ii, 183);
+       if(span < 10.0f)
+         tft.print(ASAFreqOfBin(0.0f) + 0.2f*span*(float)ii, 2);
+       else if(span < 100.0f)
+         tft.print(ASAFreqOfBin(0.0f) + 0.2f*span*(float)ii, 1);
+       else
+         tft.print(ASAFreqOfBin(0.0f) + 0.2f*span*(float)ii, 0);
+       }
+     tft.setCursor(285, 183);
+     tft.print("Hz");
+     if(SDCardAvailable)
+       drawScreenSaveBox(ILI9341_GREEN);
+     else
+       drawScreenSaveBox(ILI9341_BLACK);
+     return;
+     }
   for(int ii = 0; ii<6; ii++)
      {
      if (ASAI2SFreqIndex > 0)
@@ -229,9 +736,11 @@ void show_spectrum()
   int16_t y1_new_minus = 0;
 
   if (instrument != ASA) return;
+  uint32_t tPerf = perfStart();
 
   // clear spectrum display
   tft.fillRect(spectrum_x-5, spectrum_y-1, 262, spectrum_height+2, ILI9341_BLACK);
+  audioService();       // The fill alone is tens of msec
   // prepare_spectrum_display();
   for(int ii=0; ii<=160; ii+=40)
       tft.drawFastHLine (spectrum_x-5, spectrum_y+ii,  260, ILI9341_ORANGE);
@@ -317,12 +826,35 @@ void show_spectrum()
       }
     } // End for(...) Draw 254 spectral points
 
+  // Second trace of the dual channel modes.  The area was cleared above.
+  if (ASADual != ASA_DUAL_OFF)
+    {
+    for (int16_t j = 0; j < 254; j++)
+      {
+      y_new = pixel2[j];
+      if (y_new > (spectrum_height + 1))
+         y_new = (spectrum_height + 1);
+      y1_new  = (spectrum_y + spectrum_height - 1) - y_new;
+      if (j == 0)
+        y1_new_minus = y1_new;
+      if (y1_new - y1_new_minus > 1)
+        tft.drawFastVLine(j + spectrum_x, y1_new_minus + 1, y1_new - y1_new_minus, ILI9341_CYAN);
+      else if (y1_new - y1_new_minus < -1)
+        tft.drawFastVLine(j + spectrum_x, y1_new, y1_new_minus - y1_new, ILI9341_CYAN);
+      else
+        tft.drawPixel(j + spectrum_x, y1_new, ILI9341_CYAN);
+      y1_new_minus = y1_new;
+      }
+    }
+
     //tft.drawFastVLine( , , , ILI9341_BLACK);  Cursor point (addlater)
     //tft.drawFastVLine( , , , ILI9341_RED);
     tft.setCursor(70, 21);    // (48, 21);
     tft.print(uSave.lastState.SAcalCorrectionDB + pwr10DB, 2);
     tft.setCursor(260, 21);
-    if(specMaxFreq>0.0f)
+    if(specMaxFreq>0.0f && zoomFFT.getZoom()>0)
+      tft.print(specMaxFreq, 2);  // Sub-Hz resolution
+    else if(specMaxFreq>0.0f)
       tft.print(specMaxFreq, 1);
     else
       tft.print(" ---");
@@ -332,35 +864,38 @@ void show_spectrum()
       tft.setTextColor(ILI9341_WHITE);
       tft.setFont(Arial_8);
       tft.setCursor(240, 36);
-      tft.print("fc = 996");
+      tft.print("fc=");
+      tft.setCursor(275, 36);
+      if(distValid)
+        tft.print(distFundFreq, 1);
+      else
+        tft.print(" ---");
 
       tft.setCursor(240, 46);
       tft.print("S/N=");
       tft.setCursor(275, 46);
-      tft.print((signalOnlyPowerDB - sinadNoisePowerDB + 20.214), 1);
+      tft.print(distSNRDB, 1);
 
       tft.setCursor(240, 56);
-      tft.print("NBW = 17.6");  // 12 kHz sample rate
+      tft.print("THD=");
       tft.setCursor(275, 56);
+      tft.print(distTHDDB, 1);
 
       tft.setCursor(240, 66);
-      tft.print("S/N 2500Hz");
-      // NBW for 1 bin is 17.6 Hz, so lower by (2500/17.6) in dB
+      tft.print("THD%");
+      tft.setCursor(275, 66);
+      tft.print(distTHDPct, 3);
+
+      tft.setCursor(240, 76);
+      tft.print("THD+N");
       tft.setCursor(275, 76);
-      tft.print((signalOnlyPowerDB - sinadNoisePowerDB + 20.214 - 21.53), 1);
+      tft.print(distTHDNDB, 1);
 
       tft.setCursor(240, 86);
       tft.print("SINAD");
       tft.setCursor(275, 86);
-      tft.print((sinadSignalPowerDB - sinadNoisePowerDB - 0.042), 1);
-      
-      tft.drawFastHLine (spectrum_x+13, spectrum_y+158,  28, ILI9341_GREEN);
-      tft.drawFastHLine (spectrum_x+41, spectrum_y+158,  4, ILI9341_RED);
-      tft.drawFastHLine (spectrum_x+45, spectrum_y+158,  128, ILI9341_GREEN);
-        
-      tft.drawFastHLine (spectrum_x+13, spectrum_y+159,  28, ILI9341_GREEN);
-      tft.drawFastHLine (spectrum_x+41, spectrum_y+159,  4, ILI9341_RED);
-      tft.drawFastHLine (spectrum_x+45, spectrum_y+159,  128, ILI9341_GREEN);
+      tft.print(distSINADDB, 1);
     }
+  perfStop(PERF_SHOW_SPECTRUM, tPerf);
   } // End show_spectrum()
 
@@ -0,0 +1,160 @@
+//  AVNA8bench.ino
+// BENCH command, timing of the DSP kernels and the serial output
+// formatting of the AVNA audio vector analyzer.
+/*  RSL_VNA8 Arduino sketch for audio VNA measurements.
+ *  Copyright (c) 2016-2020 Robert Larkin  W7PUA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* BenchCommand()  -  "BENCH n"   Time each kernel n times (default 100,
+ * 1 to 10000) using the DWT cycle counter of perfR2.  Inputs come from a
+ * fixed seed random number generator, so every run and every release sees
+ * the same data.  Output is CSV, one line per kernel:
+ *     name, count, min us, ave us, max us
+ * Audio interrupts continue during the timing, so min is the kernel alone
+ * and max includes interrupt time.  The globals that the kernels change
+ * are restored at the end, but the instrument should be idle.  The DSP and
+ * float formatting kernels are in benchR2, and tools/benchHost.cpp runs
+ * them on a PC.  The buffers are in the work area, see workTake().
+ */
+void BenchCommand(void)
+  {
+  char *arg;
+  uint16_t nBench = 100;
+  uint16_t ii, nPts, saveAvnaState, saveNFreq, save256, saveCycles;
+  uint32_t t0, seed;
+  bool saveVerbose;
+  struct perfStage ps;
+  struct benchWork *bw = (struct benchWork *)workArea;
+  struct measureFreq saveFD0, saveFDn;
+  double saveAV, saveAR, savePV, savePR;
+  Complex saveZ, saveY, saveZt, saveZt0;
+  float saveSLC, savePLC, saveQ, saveSave0;
+  float32_t f;
+  PerfNullPrint nullOut;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int n = atoi(arg);
+    if(n < 1 || n > 10000)
+      {
+      Serial.println("Error: BENCH count is 1 to 10000");
+      return;
+      }
+    nBench = (uint16_t)n;
+    }
+  if(!workTake(WORK_BENCH))
+    return;
+
+  seed = benchInputs(bw);
+  benchHeader(Serial, nBench);
+  benchDSP(Serial, bw, nBench, benchNoise);
+
+  // Save everything the measurement math changes
+  saveAvnaState = avnaState;   saveVerbose = verboseData;
+  saveNFreq = nFreq;  save256 = num256blocks;  saveCycles = numCycles;
+  saveFD0 = FreqData[0];  saveFDn = FreqData[nFreq];  saveSave0 = saveFreq0;
+  saveAV = amplitudeV;  saveAR = amplitudeR;  savePV = phaseV;  savePR = phaseR;
+  saveZ = Z[0];  saveY = Y[0];  saveZt = Ztuneup;  saveZt0 = Ztuneup0;
+  saveSLC = sLC[0];  savePLC = pLC[0];  saveQ = Q[0];
+  avnaState = WHATSIT;         // No LCD messages from computeZ()
+  verboseData = false;
+  nFreq = 0;
+
+  // The math of measureZ(), near 100+j100 Ohms with the 50 Ohm refR
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    seed = 1664525UL*seed + 1013904223UL;
+    amplitudeV = 0.30 + 1.0E-11*(double)seed;
+    amplitudeR = 0.35;
+    phaseV = 20.0 + 1.0E-9*(double)seed;
+    phaseR = 0.5;
+    t0 = perfStart();
+    computeZ(0);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "measureZ math", &ps, false);
+
+  // Serial output of that Z, formatted to nowhere
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    t0 = perfStart();
+    printZ(nullOut, 0);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "serialPrintZ format", &ps, false);
+
+  // modifyFreq() and prepMeasure(), 10 Hz to 40 kHz
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    seed = 1664525UL*seed + 1013904223UL;
+    f = 10.0f + 9.3132E-6f*(float32_t)seed;
+    t0 = perfStart();
+    modifyFreq(f);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "modifyFreq", &ps, false);
+
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    seed = 1664525UL*seed + 1013904223UL;
+    f = 10.0f + 9.3132E-6f*(float32_t)seed;
+    t0 = perfStart();
+    prepMeasure(f);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "prepMeasure", &ps, false);
+
+  avnaState = saveAvnaState;   verboseData = saveVerbose;
+  nFreq = saveNFreq;  num256blocks = save256;  numCycles = saveCycles;
+  FreqData[0] = saveFD0;  FreqData[nFreq] = saveFDn;  saveFreq0 = saveSave0;
+  amplitudeV = saveAV;  amplitudeR = saveAR;  phaseV = savePV;  phaseR = savePR;
+  Z[0] = saveZ;  Y[0] = saveY;  Ztuneup = saveZt;  Ztuneup0 = saveZt0;
+  sLC[0] = saveSLC;  pLC[0] = savePLC;  Q[0] = saveQ;
+
+  // nanoVNA data line and the ASA spectrum dump, formatted to nowhere.
+  // Any stored points will do, but never a zero divide.
+  nPts = (sweepPoints > 0) ? sweepPoints : 1;
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    t0 = perfStart();
+    printDataLine(nullOut, ii % nPts);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "sendDataLine format", &ps, false);
+
+  perfStageClear(&ps);
+  for (ii=0; ii<nBench; ii++)
+    {
+    t0 = perfStart();
+    printASAData(nullOut, bw->power);
+    perfStageAdd(&ps, t0);
+    }
+  perfPrintStage(Serial, "ASA dump format", &ps, false);
+
+  benchFormat(Serial, bw, nBench);
+  workGive(WORK_BENCH);
+  }
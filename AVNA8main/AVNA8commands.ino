@@ -97,7 +97,7 @@ void InstrumentCommand(void)
   }
 
 /* SIGGEN i s f a w  Command
-  i=index 1,4;  s=On/Off 1,0;  f=freq Hz; a=ampliitude 0.0, 1.0;
+  i=index 1,5;  s=On/Off 1,0;  f=freq Hz; a=ampliitude 0.0, 1.0;
   For w, see https://www.pjrc.com/teensy/gui/?info=AudioSynthWaveform
   WAVEFORM_SINE              0
   WAVEFORM_SAWTOOTH          1
@@ -106,17 +106,30 @@ void InstrumentCommand(void)
   WAVEFORM_SAWTOOTH_REVERSE  6
   This can be set anytime and is not associated with a particular instrument.
   This command may not LCD display any change. The noise generator, SG #4,
-  only reponds to on/off and amplitude (1-sigma value).  */
+  only reponds to on/off and amplitude (1-sigma value).
+  SG #5 is the arbitrary generator, src/synth_arbitrary_p.  For it w is
+  WAVEFORM_ARBITRARY         4   The wavetable, repeated at f (default)
+  ARB_STREAM                10   The uSD file of STREAM, f not used
+  and in place of s f a w, one of
+  SIGGEN 5 TABLE name        One period from a uSD file, a 16-bit mono WAV
+                             or raw samples, up to 2048 points
+  SIGGEN 5 HARM a1 a2 ...    Table of sine harmonics 1 to 8, peak amplitudes
+                             (scaled to a 1.0 peak if more)
+  SIGGEN 5 STREAM name l     uSD file, a WAV or raw as TABLE, any length,
+                             played at the sample rate.  l=1 loops (default),
+                             0 plays once.  It starts when SG #5 is turned on
+                             with w=10, and again if set after the end.  */
 void SigGenCommand(void)
   {
   char *arg;
   uint16_t sgIndex;
+  bool wantOn;
 
   arg = SCmd.next();
   if (arg != NULL)
     {
     int ii = atoi(arg);
-    if(ii>0 && ii<=4)
+    if(ii>0 && ii<=5)
       sgIndex = ii - 1;
     else
       return;
@@ -125,6 +138,11 @@ void SigGenCommand(void)
     return;
 
   arg = SCmd.next();
+  if (arg != NULL && sgIndex == 4 && isalpha(arg[0]))
+    {
+    arbGenCommand(arg);
+    return;
+    }
   if (arg != NULL)
     {
     asg[sgIndex].ASGoutputOn = (atoi(arg) != 0);  // bool
@@ -149,7 +167,12 @@ void SigGenCommand(void)
     }
 
   arg = SCmd.next();
-  if (arg != NULL && sgIndex != 3)
+  if (arg != NULL && sgIndex == 4)
+    {
+    int w = atoi(arg);
+    asg[4].type = (w == ARB_STREAM) ? ARB_STREAM : WAVEFORM_ARBITRARY;
+    }
+  else if (arg != NULL && sgIndex != 3)
     {
     int w = atoi(arg);
     if (w==0 || w==1 || w==2 || w==3 || w==4 || w==6)
@@ -169,6 +192,74 @@ void SigGenCommand(void)
   if(currentMenu == 15)  tToASGHome();  // Redraw
   if(currentMenu == 16)  tToASGn();
   checkSGoverload();
+  wantOn = asg[sgIndex].ASGoutputOn;
+  setSigGens();
+  if (wantOn && !asg[sgIndex].ASGoutputOn)       // Only the arb gen stream
+    {
+    Serial.print("Error: SG 5 could not open \"");
+    Serial.print(arbStreamName);
+    Serial.println("\", see SIGGEN 5 STREAM");
+    }
+  }
+
+/* arbGenCommand()  -  The SIGGEN 5 TABLE, HARM and STREAM forms, with
+ * arg the keyword.  See SigGenCommand().
+ */
+void arbGenCommand(char *arg)
+  {
+  float32_t a[ARB_HARM_MAX];
+  uint16_t n;
+
+  if (strcmp(arg, "TABLE") == 0)
+    {
+    arg = SCmd.next();
+    if (arg == NULL || !SDCardAvailable || !arbWave.loadTable(arg))
+      {
+      Serial.println("Error: SIGGEN 5 TABLE needs a uSD file, WAV or raw 16-bit mono");
+      return;
+      }
+    asg[4].type = WAVEFORM_ARBITRARY;
+    if (verboseData)
+      {
+      Serial.print("Arb gen table of ");
+      Serial.print(arbWave.tableLength());
+      Serial.println(" points");
+      }
+    }
+  else if (strcmp(arg, "HARM") == 0)
+    {
+    for (n = 0; n < ARB_HARM_MAX && (arg = SCmd.next()) != NULL; n++)
+      a[n] = (float32_t)atof(arg);
+    if (n == 0)
+      {
+      Serial.println("Error: SIGGEN 5 HARM needs 1 to 8 amplitudes");
+      return;
+      }
+    arbWave.setHarmonics(a, n);
+    asg[4].type = WAVEFORM_ARBITRARY;
+    }
+  else if (strcmp(arg, "STREAM") == 0)
+    {
+    arg = SCmd.next();
+    if (arg == NULL || strlen(arg) > 12)
+      {
+      Serial.println("Error: SIGGEN 5 STREAM needs an 8.3 file name");
+      return;
+      }
+    arbWave.closeStream();           // A new file starts from the top
+    workGive(WORK_ARB);
+    strcpy(arbStreamName, arg);
+    arg = SCmd.next();
+    arbStreamLoop = (arg == NULL || atoi(arg) != 0);
+    asg[4].type = ARB_STREAM;
+    }
+  else
+    {
+    Serial.println("Error: SIGGEN 5 takes s f a w, TABLE, HARM or STREAM");
+    return;
+    }
+  if(currentMenu == 15)  tToASGHome();
+  if(currentMenu == 16)  tToASGn();
   setSigGens();
   }
 
@@ -176,6 +267,9 @@ void SigGenCommand(void)
 //   Continuous: "RUN 0"
 //   n Measurements over Serial: "RUN n"
 //   Stop measure over Serial:  "RUN -2"
+// VECTORVM s u p w r
+//   w = sliding window in ms, 0 for block measurements, up to about 500
+//   r = readings per second in sliding mode, 1 to 100
 void VVMCommand(void)
   {
   char *arg;
@@ -203,6 +297,28 @@ void VVMCommand(void)
     else               phaseOffset = p;
     }
 
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int w = atoi(arg);
+    if(w < 0 || w > 500)
+      {
+      Serial.println("Error: VVM window is 0 to 500 ms");
+      return;
+      }
+    VVMWindowMs = (uint16_t)w;
+    VVMSlideRestart = true;
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int r = atoi(arg);
+    if(r < 1)         VVMPublishHz = 1;
+    else if(r > 100)  VVMPublishHz = 100;
+    else              VVMPublishHz = (uint16_t)r;
+    }
+
   if (verboseData)  Serial.println("VVM successfully programmed.");
 
   if(instrument == VVM)
@@ -215,12 +331,32 @@ void VVMCommand(void)
   }
 
 /* Command the Spectrum Analyzer on
- * ASACommand fmt sr m d of
+ * ASACommand fmt sr m d of nh lo hi am dm
  *  fmt = Serial Format
  *   sr = sample rate, 0 to 6
  *    m = number of averages > 0
  *    d = dB/div e.g., 10.0
  *   of = offset in dB, e.g. 12.5
+ *   nh = highest harmonic for THD, 2 to 10
+ *   lo = low frequency limit for THD+N and SINAD, Hz
+ *   hi = high frequency limit for THD+N and SINAD, Hz
+ *   am = averaging of the m frames, 0 to 7 (restarts the average)
+ *        0 = Block power sum, a new result every m frames
+ *        1 = Exponential, time constant of m frames, a new result every frame
+ *        2 = Max hold, every frame
+ *        3 = Min hold, every frame
+ *        4 to 7 = The same, but averaging dB, not power
+ *   dm = dual channel mode, 0 to 3, with the reference channel (restarts)
+ *        0 = Off, the measure channel only
+ *        1 = Measure and reference spectra
+ *        2 = Gain, measure/reference, and coherence
+ *        3 = Phase, measure to reference, and coherence
+ *        Dual modes are full span and always block averaged, am is not used.
+ *        The serial data is then the XS lines or BF_XSPEC frame, see
+ *        sendXSpectrum().
+ * For all averaging modes the output is scaled as a sum of m power frames.
+ * Format bits 64 and 128 add a line with
+ *   DIST,fund Hz,fund dBm,THD dB,THD %,THD+N dB,SINAD dB,S/N dB,H2 dBc,...
  */
 void ASACommand(void)
   {
@@ -295,9 +431,63 @@ void ASACommand(void)
       ASAdbOffset = of;
     }
 
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int nh = atoi(arg);
+    if(nh>=2  &&  nh<=DIST_MAX_HARMONIC)
+      distNHarmonics = nh;
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    float lo = atof(arg);
+    if(lo>=0.0f  &&  lo<100000.0f)
+      distFreqLow = lo;
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    float hi = atof(arg);
+    if(hi>distFreqLow  &&  hi<=100000.0f)
+      distFreqHigh = hi;
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int am = atoi(arg);
+    if(am>=0  &&  am<=7)
+      {
+      ASAAveMode = (uint16_t)(am & 3);
+      ASALogAve = (am >= 4);
+      ASARestartAve = true;
+      }
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int dm = atoi(arg);
+    if(dm>=ASA_DUAL_OFF  &&  dm<=ASA_DUAL_PHASE)
+      {
+      ASADual = (uint16_t)dm;
+      if(ASADual == ASA_DUAL_OFF)
+        ASADualOff();
+      ASARestartAve = true;
+      }
+    }
+
   instrument = ASA;
 
-  if (verboseData)  Serial.println("ASA successfully programmed.");
+  if (verboseData)
+    {
+    Serial.print("ASA averaging: ");
+    Serial.println(ASAAveName());
+    Serial.println("ASA successfully programmed.");
+    }
 
   nRun =  RUNNOT;    // Wait for RUNn trigger
   doRun = CONTINUOUS;
@@ -306,6 +496,51 @@ void ASACommand(void)
   writeMenus(12);
   }
 
+/* ZoomCommand zf fc
+ *   zf = zoom factor, 1 for full span, or even 2 to 256
+ *   fc = center frequency, Hz
+ * Bin spacing becomes sampleRate/(1024*zf) and the span is 512 bins.
+ * The I2S sample rate is not changed.  ASA only.
+ */
+void ZoomCommand(void)
+  {
+  char *arg;
+  if(instrument != ASA)
+     {
+     Serial.println("Error: Execute \"INSTRUMENT 2\" first");
+     return;
+     }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    int zf = atoi(arg);
+    if(zf==1 || (zf>=2 && zf<=ZOOM_MAX && (zf&1)==0))
+      ASAZoom = zf;
+    else
+      {
+      Serial.println("Error: Zoom must be 1 or even, 2 to 256");
+      return;
+      }
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    float fc = atof(arg);
+    if(fc>0.0f && fc<100000.0f)
+      ASAZoomCenter = fc;
+    }
+
+  prepSpectralDisplay();     // Sets up zoomFFT
+  if (verboseData)
+    {
+    Serial.print("Zoom ");  Serial.print(ASAZoom);
+    Serial.print("  Center Hz ");  Serial.print(ASAZoomCenter, 3);
+    Serial.print("  Bin Hz ");  Serial.println(ASABinHz(), 5);
+    }
+  }
+
 void ScreenSaveCommand(void)
   {
   char *arg;
@@ -321,7 +556,9 @@ void ScreenSaveCommand(void)
     else if ((d == 2) && SDCardAvailable)
        {
        bmpScreenSDCardRequest = true;  // Do anything useful? It is needed!
+       uint32_t tPerf = perfStart();
        char* pf = dumpScreenToSD();
+       perfStop(PERF_SCREEN_DUMP, tPerf);
        if(verboseData || printFilename)
          {
          Serial.print("Screen Save: ");
@@ -827,6 +1064,167 @@ void DelayCommand()
   }                 // ELSE ERROR RESPONSE
 }
 
+/* SettleCommand()  -  "SETTLE m tol pc"
+ *    m = 0 fixed delays, ZDELAY + 1000/f for transmission
+ *    m = 1 settling detector, see settleDelay()
+ *  tol = relative change of V and R between chunks, e.g., 0.002
+ *   pc = 1 for phase continuous LO stepping, 0 resets LO phase each freq
+ * With no parameters, prints the settle statistics since the last SETTLE
+ * and restarts them.  Points with fixed delays and with the detector are
+ * counted apart, so the same sweep run both ways shows the saving.  The
+ * detector line also has the average of the fixed delays it replaced.
+ */
+void SettleCommand(void)
+  {
+  char *arg;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    printSettleStats("Fixed ", SETTLE_FIXED);
+    Serial.println();
+    printSettleStats("Detect", SETTLE_DETECT);
+    Serial.print("  Fixed ave ms=");
+    if(settleCount[SETTLE_DETECT] > 0)
+      Serial.print(0.001f*(float)settleFixedUs/(float)settleCount[SETTLE_DETECT], 2);
+    else
+      Serial.print("---");
+    Serial.print("  Timeouts=");  Serial.println(settleTimeouts);
+    clearSettleStats();
+    return;
+    }
+  settleMode = (atoi(arg)==0 ? SETTLE_FIXED : SETTLE_DETECT);
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    float tol = atof(arg);
+    if(tol>0.0f && tol<1.0f)
+      settleTolerance = tol;
+    }
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    phaseContinuous = (atoi(arg) != 0);
+    loPhaseSet = false;       // Start from 0/270 deg at next freq
+    }
+  clearSettleStats();
+  if (verboseData)  Serial.println("Settling successfully programmed.");
+  }
+
+// One mode of the SETTLE statistics, without the end of line
+void printSettleStats(const char *name, uint16_t m)
+  {
+  Serial.print(name);
+  Serial.print(" points=");  Serial.print(settleCount[m]);
+  Serial.print("  Ave ms=");
+  if(settleCount[m] > 0)
+    Serial.print(0.001f*(float)settleSumUs[m]/(float)settleCount[m], 2);
+  else
+    Serial.print("---");
+  }
+
+void clearSettleStats(void)
+  {
+  settleCount[SETTLE_FIXED] = 0;   settleSumUs[SETTLE_FIXED] = 0;
+  settleCount[SETTLE_DETECT] = 0;  settleSumUs[SETTLE_DETECT] = 0;
+  settleFixedUs = 0;  settleTimeouts = 0;
+  }
+
+/* HarmonicsCommand()  -  "HARMONICS h"
+ *    h = 0  No harmonic measurement (default)
+ *    h = 1  Measure H2 to H5 with every data point, same acquisition as
+ *           the fundamental.  Transmission output lines get four more values,
+ *           dB relative to the fundamental, "---" if above fs/2.
+ *    h = 2  Print the harmonics of the last nanoVNA sweep, one line per freq.
+ *           "---" for a point measured with h = 0, or not yet measured.
+ */
+void HarmonicsCommand(void)
+  {
+  char *arg;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    Serial.println("Error: HARMONICS needs 0, 1 or 2");
+    return;
+    }
+  if (atoi(arg) == 2)
+    {
+    for (uint16_t ii = 0; ii < sweepPoints; ii++)
+      {
+      Serial.print(dataFreq[ii], 3);
+      for (uint16_t k = 2; k <= HARM_MAX; k++)
+        {
+        Serial.print(",");
+        if (dataHarmCdB[ii][k-2] <= -19900)
+          Serial.print("---");
+        else
+          Serial.print(0.01f*(float)dataHarmCdB[ii][k-2], 2);
+        }
+      Serial.println("");
+      }
+    return;
+    }
+  measureHarmonics = (atoi(arg) != 0);
+  if (verboseData)  Serial.println("Harmonics successfully programmed.");
+  }
+
+/* BgSpectrumCommand()  -  "BGSPECTRUM b n"
+ *    b = 0  Off (default).  The 1024 FFT then runs only for the ASA.
+ *    b = 1  While getNmeasQI() waits for data, the FFT of the same ADC
+ *           samples is checked for spurs and noise.  This adds no
+ *           measurement time.  Each Z, T, VVM or STREAMSWEEP output line
+ *           is followed by
+ *             SPEC,freq,spur dBc,spur Hz,noise dBc/bin,ADC peak %,frames
+ *           Bins near DC, the fundamental and H2 to H5 (aliased or not) are
+ *           neither spur nor noise.  Spur is the worst of the frames, noise
+ *           the average.  n = 1 to 16 does the FFT for 1 of n frames,
+ *           default 2, to limit the audio interrupt load.
+ *    b = 2  Print spur, noise and peak of the last nanoVNA sweep, one
+ *           line per freq.
+ *  The sliding window VVM does not use getNmeasQI() and has no SPEC lines.
+ */
+void BgSpectrumCommand(void)
+  {
+  char *arg;
+  int n;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    Serial.println("Error: BGSPECTRUM needs 0, 1 or 2");
+    return;
+    }
+  if (atoi(arg) == 2)
+    {
+    for (uint16_t ii = 0; ii < sweepPoints; ii++)
+      {
+      Serial.print(dataFreq[ii], 3);
+      Serial.print(",");
+      Serial.print(0.01f*(float)dataSpurCdB[ii], 2);
+      Serial.print(",");
+      Serial.print(0.01f*(float)dataNoiseCdB[ii], 2);
+      Serial.print(",");
+      Serial.println(dataPeakPct[ii]);
+      }
+    return;
+    }
+  bgSpectrumOn = (atoi(arg) != 0);
+  arg = SCmd.next();
+  if (arg != NULL)
+    {
+    n = atoi(arg);
+    if (n<1 || n>16)
+      {
+      Serial.println("Error: BGSPECTRUM interval is 1 to 16");
+      return;
+      }
+    bgSpectrumInterval = (uint16_t)n;
+    }
+  if (verboseData)  Serial.println("Background spectrum successfully programmed.");
+  }
 
 //  From CALDAT command.
 void CalDatCommand(void)
@@ -912,6 +1310,140 @@ void TestCommand(void)
   Serial.println("Restart required to reset to ordinary measurements.");
   }
 
+/* PerfCommand()  -  "PERF p"   Run time profile from the DWT cycle counter.
+ * Count, min, average and max in microseconds for each timed stage, see
+ * perfR2.h.  Time is with all interrupts, i.e., under real load.  Also the
+ * FFT spectra read by loop() and those lost, i.e., replaced by a newer one
+ * before loop() got to them, the max audio blocks used, see AUDIO_BLOCKS,
+ * and the sliding VVM window restarts, see VVMDrain().  Last, the RAM left
+ * between the heap and the stack, and the user of the work area, as the
+ * RAM check on the hardware.
+ *    p = 0  Print the summary (default)
+ *    p = 1  Print the summary and the power of 2 histograms
+ *    p = 2  Reset all stages, the spectra counts, audio blocks and restarts
+ *    p = 3  Stop collecting,  p = 4  Start collecting (default is on)
+ */
+extern "C" char* sbrk(int incr);
+
+void PerfCommand(void)
+  {
+  char stackNow;             // The address is the stack pointer, near enough
+  char *arg;
+  int p = 0;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    p = atoi(arg);
+  if(p==0 || p==1)
+    {
+    perfPrint(Serial, p==1);
+    Serial.print("Audio processor usage, max percent = ");
+    Serial.println(AudioProcessorUsageMax());
+    Serial.print("FFT spectra read = ");
+    Serial.print(fft1024p.frames());
+    Serial.print(", lost = ");
+    Serial.println(fft1024p.lost());
+    Serial.print("Zoom FFT spectra read = ");
+    Serial.print(zoomFFT.frames());
+    Serial.print(", lost = ");
+    Serial.println(zoomFFT.lost());
+    Serial.print("Audio blocks, max used = ");
+    Serial.print(AudioMemoryUsageMax());
+    Serial.print(" of ");
+    Serial.print(AUDIO_BLOCKS);
+    Serial.print(", sliding VVM restarts = ");
+    Serial.println(VVMGaps);
+    Serial.print("RAM free, heap to stack = ");
+    Serial.print((uint32_t)(&stackNow - sbrk(0)));
+    Serial.print(" bytes, work area ");
+    Serial.print(WORK_BYTES);
+    Serial.print(" bytes in use by ");
+    Serial.println(workUserName(workUser));
+    }
+  else if(p==2)
+    {
+    perfReset();
+    AudioProcessorUsageMaxReset();
+    AudioMemoryUsageMaxReset();
+    VVMGaps = 0;
+    fft1024p.clearCounts();
+    zoomFFT.clearCounts();
+    }
+  else if(p==3)
+    perfEnable = false;
+  else if(p==4)
+    perfEnable = true;
+  else
+    Serial.println("Error: PERF is 0 to 4");
+  }
+
+/* SchedCommand()  -  "SCHED p"   loop() task statistics, see schedR2.h.
+ * For each task, the runs, the runs over the time budget, the average and
+ * max run time and the max latency, from due to start, all in us.
+ *    p = 0  Print (default)
+ *    p = 1  Clear the statistics
+ */
+void SchedCommand(void)
+  {
+  char *arg;
+  int p = 0;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    p = atoi(arg);
+  if(p==0)
+    sched.printStats(Serial);
+  else if(p==1)
+    sched.clearStats();
+  else
+    Serial.println("Error: SCHED is 0 or 1");
+  }
+
+/* SetupTimeCommand()  -  "SETUPTIME"   Timing probe for setUpNewFreq().
+ * Steps through the 13 sweep frequencies and a 101 point linear sweep,
+ * 10 to 40000 Hz, first with configCacheOn false (every point reprograms
+ * I2S, both FIR's, the sig gens and the LCD top lines, the original way)
+ * and then with the cache on.  Nothing is measured.  Prints uSec per point.
+ */
+void SetupTimeCommand(void)
+  {
+  uint16_t saveNFreq = nFreq;
+  struct measureFreq saveF0 = FreqData[0];
+  bool saveCache = configCacheOn;
+  uint32_t t0, t13[2], t101[2];
+
+  for(int pass=0; pass<2; pass++)
+    {
+    configCacheOn = (pass == 1);
+    t0 = micros();
+    for(nFreq=1; nFreq<=13; nFreq++)
+      setUpNewFreq(nFreq);
+    t13[pass] = micros() - t0;
+
+    nFreq = 0;
+    t0 = micros();
+    for(int ii=0; ii<101; ii++)
+      {
+      FreqData[0].freqHz = 10.0f + 399.9f*(float)ii;
+      setUpNewFreq(0);
+      }
+    t101[pass] = micros() - t0;
+    }
+
+  configCacheOn = saveCache;
+  FreqData[0] = saveF0;
+  nFreq = saveNFreq;
+  setUpNewFreq(nFreq);
+
+  Serial.println("Setup time per point, uSec  No cache, Cache");
+  Serial.print(" 13 pt sweep:  ");
+  Serial.print((float)t13[0]/13.0f, 1);  Serial.print(", ");
+  Serial.println((float)t13[1]/13.0f, 1);
+  Serial.print("101 pt sweep:  ");
+  Serial.print((float)t101[0]/101.0f, 1);  Serial.print(", ");
+  Serial.println((float)t101[1]/101.0f, 1);
+  }
+
 // Param1Command()  -  "PARAM1 0 50.22 5017.3"
 // The '0' means "no default."  Set to the number 99 and ALL EEPROM values will be set to the
 // defaults.  For this reset, the next two parameters are ignored, and are not required.
@@ -1689,6 +2221,20 @@ void frequenciesCommand()
   {
   uint16_t kk;
   doingNano = true;
+  if (binaryOut)
+    {
+    if (portSelect & NANO_USE_USB)
+      {
+      sendFloatFrame(Serial, BF_FREQ, dataFreq, sweepPoints, 1);
+      Serial.print("ch> "); Serial.send_now();
+      }
+    if (portSelect & NANO_USE_HW4)
+      {
+      sendFloatFrame(HWSERIAL4, BF_FREQ, dataFreq, sweepPoints, 1);
+      HWSERIAL4.print("ch> ");
+      }
+    return;
+    }
   if (portSelect & NANO_USE_USB)
     {
     for (kk=0; kk<sweepPoints; kk++)
@@ -1730,37 +2276,93 @@ void dataCommand()
 void sendDataLine(uint16_t nSD)
   {
   if (portSelect & NANO_USE_USB)
+    printDataLine(Serial, nSD);
+  if (portSelect & NANO_USE_HW4)
+    printDataLine(HWSERIAL4, nSD);
+  }
+
+// All the S11 or S21 points of "data 0/1" as one BF_S11/BF_S21 frame
+void sendDataFrame(void)
+  {
+  if (portSelect & NANO_USE_USB)
+    sendDataFrameTo(Serial);
+  if (portSelect & NANO_USE_HW4)
+    sendDataFrameTo(HWSERIAL4);
+  }
+
+void sendDataFrameTo(Print &p)
+  {
+  float pair[2*64];          // Sent 64 points at a time
+  uint16_t kk, jj = 0;
+  BinFrame bf(p);
+
+  bf.begin((sendDataType==0 ? BF_S11 : BF_S21), totalDataPoints, 2*sizeof(float), 0.0f, 0.0f);
+  for (kk=0; kk<totalDataPoints; kk++)
     {
-    if(sendDataType == 0)
+    pair[jj++] = (sendDataType==0 ? dataReReflec[kk] : dataReTrans[kk]);
+    pair[jj++] = (sendDataType==0 ? dataImReflec[kk] : dataImTrans[kk]);
+    if (jj == 2*64 || kk == totalDataPoints-1)
       {
-      // These are reflection coefficient (S11) in re and im form
-      Serial.print  (dataReReflec[nSD],6);
-      Serial.print  (" ");
-      Serial.println(dataImReflec[nSD],6);
-      }
-    else
-      {
-      Serial.print  (dataReTrans[nSD],6);
-      Serial.print  (" ");
-      Serial.println(dataImTrans[nSD],6);
+      bf.add(pair, jj*sizeof(float));
+      jj = 0;
       }
     }
+  bf.end();
+  }
 
-  if (portSelect & NANO_USE_HW4)
+// Frame of count items of perItem floats each, axes 0
+void sendFloatFrame(Print &p, uint8_t type, float *data, uint16_t count, uint16_t perItem)
+  {
+  BinFrame bf(p);
+
+  bf.begin(type, count, perItem*sizeof(float), 0.0f, 0.0f);
+  bf.add(data, (uint32_t)count*perItem*sizeof(float));
+  bf.end();
+  }
+
+/* BinaryCommand()  -  "BINARY b"  Binary frames in place of text, for
+ * the SPECTRUM stream, "data 0/1", "frequencies" and the Z output of
+ * single and sweep measurements.  Frame layout is in binFrameR2.h and
+ * tools/avnaBinDecode.py reads them on a host.
+ *    b = 0  Text, as always (default)
+ *    b = 1  Binary frames
+ */
+void BinaryCommand(void)
+  {
+  char *arg;
+
+  arg = SCmd.next();
+  if (arg == NULL)
     {
-    if(sendDataType == 0)
-      {
-      HWSERIAL4.print  (dataReReflec[nSD],6);
-      HWSERIAL4.print  (" ");
-      HWSERIAL4.println(dataImReflec[nSD],6);
-      }
-    else
-      {
-      HWSERIAL4.print  (dataReTrans[nSD],6);
-      HWSERIAL4.print  (" ");
-      HWSERIAL4.println(dataImTrans[nSD],6);
-      }
+    Serial.println("Error: BINARY needs 0 or 1");
+    return;
+    }
+  binaryOut = (atoi(arg) != 0);
+  if (verboseData)  Serial.println("Binary output successfully programmed.");
+  }
+
+// Same characters as print(x, 6), but formatted by formatR2 and sent
+// with a single write()
+void printDataLine(Print &p, uint16_t nSD)
+  {
+  char line[48];
+  FormatBuffer fb(p, line, sizeof(line));
+
+  if(sendDataType == 0)
+    {
+    // These are reflection coefficient (S11) in re and im form
+    fb.addFloat(dataReReflec[nSD], 6);
+    fb.addChar(' ');
+    fb.addFloat(dataImReflec[nSD], 6);
+    }
+  else
+    {
+    fb.addFloat(dataReTrans[nSD], 6);
+    fb.addChar(' ');
+    fb.addFloat(dataImTrans[nSD], 6);
     }
+  fb.addStr("\r\n");
+  fb.flush();
   }
 
 /* sweep–sets the start/stop for the next sweep.
@@ -1768,21 +2370,18 @@ void sendDataLine(uint16_t nSD)
  * [points]-If no inputs,then sweeps current setup.
  * For the nanovna this sets things up, but  does not trigger a sweep.
  * Here it triggers the series of measurements.  Also here, it is not
- * restricted to 101 points but anything from 2 to 1601.
+ * restricted to 101 points but anything from 2 to 1601, and other
+ * counts get an Error line.
  * Data measurements occur one at a time in loop() to not hold things up.
  */
 void sweepCommand()
   {
   char *arg;
-  uint16_t kk;
+  uint16_t start, stop, points;
 
   arg = SCmd.next();
   if (arg != NULL)       // There are arguments
-     {
-     sweepStart = (uint16_t)atoi(arg);
-     // nanoState stays until end of printing in loop()
-     nanoState = MEASURE_NANO;
-     }
+     start = (uint16_t)atoi(arg);
   else                   // Just send back current start, stop, points
      {
      if (portSelect & NANO_USE_USB)
@@ -1804,15 +2403,42 @@ void sweepCommand()
      sendEOT();
      return;
      }
-  // We've already setup start, and need to do two more.
+  // We've already got start, and need to do two more.
+  stop = sweepStop;  points = sweepPoints;
   arg = SCmd.next();
   if (arg != NULL)
-     sweepStop = (uint16_t)atoi(arg);
+     stop = (uint16_t)atoi(arg);
   arg = SCmd.next();
   if (arg != NULL)
-     sweepPoints = (uint16_t)atoi(arg);
+     points = (uint16_t)atoi(arg);
+  if (points<2 || points>1601)     // Sizes of the data[] arrays
+     {
+     Serial.println("Error: sweep needs 2 to 1601 points");
+     sendEOT();
+     return;
+     }
+  sweepStart = start;  sweepStop = stop;  sweepPoints = points;
+  // nanoState stays until end of printing in loop()
+  nanoState = MEASURE_NANO;
+  streamSweep = false;          // This one takes over
+  adaptSweep = false;
+  startSweepPoints();
+  // Hold up commands(store in serialInBuffer) until data is collected
+  commandOpen = false;
+  }
+
+// Frequencies and hardware for a sweep of sweepPoints from sweepStart to
+// sweepStop, measured one point per loop() from sweepCurrentPoint = 0.
+void startSweepPoints(void)
+  {
+  uint16_t kk;
+
   for(kk=0; kk<sweepPoints; kk++)
+     {
      dataFreq[kk] = sweepStart + (float)kk * ((sweepStop - sweepStart) / ((float)sweepPoints - 1.0));
+     for (uint16_t k = 2; k <= HARM_MAX; k++)
+        dataHarmCdB[kk][k-2] = -20000;      // Not measured at this freq
+     }
   // For now, nano emulate is always 50 Ohms
   uSave.lastState.iRefR = R50;
   setRefR(R50);
@@ -1820,17 +2446,427 @@ void sweepCommand()
   sweepCurrentPoint = 0;
   // For use by data command, to know how many to send
   totalDataPoints = sweepPoints;
-  // Hold up commands(store in serialInBuffer) until data is collected
-  commandOpen = false;
   // For nanoVNA style sweep, all data is collected at nFreq=0.  The 13 sweep
   // points for the serial SWEEP are not used.  Thus:
   nFreq = 0;
   DC1.amplitude(dacLevel);     // Turn on sine wave
   }
 
+/* StreamSweepCommand()  -  "STREAMSWEEP start stop points"  A nanoVNA style
+ * sweep (S11 and S21 at every point, as "sweep") but each point is sent
+ * as soon as it is measured, and commands are not held up.  Each point is
+ *      freq,reS11,imS11,reS21,imS21
+ * or with BINARY 1, a BF_SWEEP_PT frame.  After the last point "END" is
+ * sent.  "STREAMSWEEP" with no parameters aborts at the end of the point
+ * being measured and sends "ABORT".  The data is also saved, so "data 0/1"
+ * works afterwards.  start and stop are Hz, 10 to 40000, points 2 to 1601.
+ */
+void StreamSweepCommand(void)
+  {
+  char *arg;
+  uint16_t start, stop, points;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    if (streamSweep)
+      {
+      streamSweep = false;
+      sweepCurrentPoint = sweepPoints;
+      streamSweepText("ABORT");
+      }
+    return;
+    }
+  start = (uint16_t)atoi(arg);
+  stop = start;  points = 0;
+  arg = SCmd.next();
+  if (arg != NULL)
+    stop = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    points = (uint16_t)atoi(arg);
+  if(start<10 || stop>40000 || stop<=start || points<2 || points>1601)
+    {
+    Serial.println("Error: STREAMSWEEP needs start, stop from 10 to 40000 Hz, 2 to 1601 points");
+    return;
+    }
+  sweepStart = start;  sweepStop = stop;  sweepPoints = points;
+  nanoState = NO_NANO;     // Not the "sweep" / "data" sequence
+  adaptSweep = false;      // This one takes over
+  startSweepPoints();
+  streamSweep = true;
+  }
+
+// Called from loop() after getDataPt(nSP) has finished
+void sendStreamPoint(uint16_t nSP)
+  {
+  if (portSelect & NANO_USE_USB)
+    printStreamPoint(Serial, nSP);
+  if (portSelect & NANO_USE_HW4)
+    printStreamPoint(HWSERIAL4, nSP);
+  }
+
+void printStreamPoint(Print &p, uint16_t nSP)
+  {
+  char line[80];
+  float v[4];
+
+  v[0] = dataReReflec[nSP];  v[1] = dataImReflec[nSP];
+  v[2] = dataReTrans[nSP];   v[3] = dataImTrans[nSP];
+  if (binaryOut)
+    {
+    BinFrame bf(p);
+    bf.begin(BF_SWEEP_PT, 1, sizeof(v), dataFreq[nSP], (float)nSP);
+    bf.add(v, sizeof(v));
+    bf.end();
+    }
+  else
+    {
+    FormatBuffer fb(p, line, sizeof(line));
+    fb.addFloat(dataFreq[nSP], 3);
+    for (uint16_t kk=0; kk<4; kk++)
+      {
+      fb.addChar(',');
+      fb.addFloat(v[kk], 6);
+      }
+    fb.addStr("\r\n");
+    fb.flush();
+    if (bgSpectrumOn && streamSweep)      // Just measured
+      printBgSpectrum(p, dataFreq[nSP]);
+    }
+  }
+
+void streamSweepText(const char *s)
+  {
+  if (portSelect & NANO_USE_USB)
+    Serial.println(s);
+  if (portSelect & NANO_USE_HW4)
+    HWSERIAL4.println(s);
+  }
+
+/* ResonanceCommand()  -  "RESONANCE f1 f2 t n"  Finds a resonance of the Z
+ * being measured, between f1 and f2 Hz (10 to 40000) with a log grid of n
+ * points (5 to 41, default 15).  t selects the resonance:
+ *    t = 0  The sharpest phase zero crossing (default)
+ *    t = 1  Series, |Z| minimum, X goes from - to +
+ *    t = 2  Parallel, |Z| maximum, X goes from + to -
+ * Output, annotated or CSV, is f0, Q and R at f0 with the series and the
+ * parallel R-L-C that have the same f0, Q and R, and the number of
+ * measurements used.  Without a Q and R more than 0 there is no R-L-C, and
+ * CSV sends 0 for it.  See findResonance().  Uses the present reference R.
+ */
+void ResonanceCommand(void)
+  {
+  char *arg;
+  float f1 = 0.0f, f2 = 0.0f;
+  uint16_t t = 0, n = 15;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    f1 = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    f2 = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    t = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    n = (uint16_t)atoi(arg);
+  if(f1<10.0f || f2>40000.0f || f2<=f1 || t>RES_PARALLEL || n<5 || n>41)
+    {
+    Serial.println("Error: RESONANCE needs f1, f2 from 10 to 40000 Hz, t 0 to 2, n 5 to 41");
+    return;
+    }
+  findResonance(f1, f2, t, n);
+  printResonance();
+  }
+
+/* FitCommand()  -  "FIT m s"  Fits an equivalent circuit to Z data, see
+ * fitR2.h.  Prints the parameters and the rms error relative to |Z|.
+ *    m = 0  Series RLC           3  Speaker, Thiele-Small
+ *        1  Parallel RLC         4  Crystal, BVD
+ *        2  R+L in parallel with C
+ *        5  Each, and report the simplest that fits (default)
+ *    s = 0  Z[] of the last serial SWEEP (default)
+ *        1  S11 of the last sweep, STREAMSWEEP or ADAPTSWEEP
+ */
+void FitCommand(void)
+  {
+  char *arg;
+  uint16_t m = FIT_N_MODELS, src = 0;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    m = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    src = (uint16_t)atoi(arg);
+  if (m > FIT_N_MODELS || src > 1)
+    {
+    Serial.println("Error: FIT needs m 0 to 5 and s 0 or 1");
+    return;
+    }
+  if (!fitData(m, src))
+    {
+    Serial.println("Error: FIT, not enough data");
+    return;
+    }
+  printFit();
+  }
+
+/* LockInCommand()  -  "LOCKIN rate f"  Continuous Z or T (per the last
+ * IMPEDANCE or TRANSMISSION command) at f Hz, rate results per second,
+ * 10 to 1000 and not over f/2.  f defaults to the last FREQ.  Each result
+ * is a line "LI,t,R,X" or "LI,t,gain,phase" with t in seconds from the
+ * start.  Results are a continuous CIC average of the mixer outputs, with
+ * no gaps.  "LOCKIN 0" or any other measurement stops it.
+ */
+void LockInCommand(void)
+  {
+  char *arg;
+  float rate = 0.0f, f = uSave.lastState.freqHz0;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    rate = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    f = atof(arg);
+  if (rate == 0.0f)
+    {
+    if (lockInOn)
+      lockInStop();
+    return;
+    }
+  if (rate<10.0f || rate>1000.0f || f<10.0f || f>40000.0f || rate>0.5f*f)
+    {
+    Serial.println("Error: LOCKIN needs rate 10 to 1000 and f 10 to 40000 Hz, rate up to f/2");
+    return;
+    }
+  if (VVMSumsRunning)
+    {
+    Serial.println("Error: LOCKIN is in use by the sliding VVM");
+    return;
+    }
+  doingNano = false;
+  lockInStart(f, rate);
+  }
+
+/* AdaptSweepCommand()  -  "ADAPTSWEEP start stop points m dB deg"  A log
+ * sweep that puts the points where the data changes.  A log grid of
+ * points/4 (at least 5) is measured first.  Then the pair of neighbors with
+ * the largest change gets a new point at their geometric mean frequency,
+ * until the change is below the threshold everywhere or all points are
+ * used.  Neighbors less than 1 Hz apart are not split.
+ *    m = 0  Measure S11 only and refine on Z (default)
+ *    m = 1  Measure S21 only and refine on T
+ *    m = 2  Measure both and refine on either
+ *    dB, deg  The change in |Z| or |T| and in phase that adds a point,
+ *           default 0.5 dB and 5 deg.
+ * At the end all points are sent in frequency order, in the STREAMSWEEP
+ * format (text or BINARY frames), followed by "END".  Values not measured
+ * are 0.  "ADAPTSWEEP" with no parameters aborts and sends "ABORT".  The
+ * data is kept, so "data 0/1" and "frequencies" work afterwards.  start
+ * and stop are Hz, 10 to 40000, points 5 to 1601.
+ */
+void AdaptSweepCommand(void)
+  {
+  char *arg;
+  uint16_t start, stop, points, m, kk;
+  float dB = 0.5f, deg = 5.0f;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    if (adaptSweep)
+      adaptSweepEnd("ABORT");
+    return;
+    }
+  start = (uint16_t)atoi(arg);
+  stop = start;  points = 0;  m = ADAPT_Z;
+  arg = SCmd.next();
+  if (arg != NULL)
+    stop = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    points = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    m = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    dB = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    deg = atof(arg);
+  if(start<10 || stop>40000 || stop<=start || points<5 || points>1601)
+    {
+    Serial.println("Error: ADAPTSWEEP needs start, stop from 10 to 40000 Hz, 5 to 1601 points");
+    return;
+    }
+  if(m > ADAPT_ZT || dB <= 0.0f || deg <= 0.0f)
+    {
+    Serial.println("Error: ADAPTSWEEP m is 0 to 2, dB and deg more than 0");
+    return;
+    }
+  sweepStart = start;  sweepStop = stop;
+  adaptMode = m;  adaptBudget = points;
+  adaptThreshDB = dB;  adaptThreshDeg = deg;
+  adaptNCoarse = points/4;
+  if (adaptNCoarse < 5)
+    adaptNCoarse = 5;
+  sweepPoints = adaptNCoarse;
+  nanoState = NO_NANO;
+  streamSweep = false;
+  startSweepPoints();
+  for(kk=0; kk<adaptNCoarse; kk++)       // Log spacing, replacing linear
+     dataFreq[kk] = (float)start*powf((float)stop/(float)start, (float)kk/(float)(adaptNCoarse - 1));
+  adaptSweep = true;
+  }
+
+// One ADAPTSWEEP point per call, from loop()
+void adaptSweepStep(void)
+  {
+  uint16_t ii, iMax = 0;
+  float c, cMax = 0.0f;
+
+  if (sweepCurrentPoint < adaptNCoarse)       // The log grid
+    {
+    getAdaptPt(sweepCurrentPoint++);
+    return;
+    }
+  if (sweepPoints < adaptBudget)
+    {
+    for (ii=0; ii<sweepPoints-1; ii++)
+      {
+      if (dataFreq[ii+1] - dataFreq[ii] < 1.0f)
+        continue;
+      c = adaptChange(ii);
+      if (c > cMax)
+        {
+        cMax = c;
+        iMax = ii;
+        }
+      }
+    if (cMax > 1.0f)
+      {
+      insertSweepPoint(iMax + 1, sqrtf(dataFreq[iMax]*dataFreq[iMax+1]));
+      getAdaptPt(iMax + 1);
+      return;
+      }
+    }
+  adaptSweepEnd("END");
+  }
+
+// Measures the quantities of adaptMode at point mf
+void getAdaptPt(uint16_t mf)
+  {
+  if (adaptMode == ADAPT_T)
+    {
+    FreqData[0].freqHz = dataFreq[mf];
+    prepMeasure(FreqData[0].freqHz);
+    setSwitch(TRANSMISSION_37);
+    setUpNewFreq(0);
+    settleDelay(ZDELAY + (unsigned long)(1000.0 / FreqData[0].freqHz));
+    getDataPtT(mf);
+    dataReReflec[mf] = 0.0f;  dataImReflec[mf] = 0.0f;
+    }
+  else if (adaptMode == ADAPT_Z)
+    {
+    getDataPtZ(mf);
+    dataReTrans[mf] = 0.0f;  dataImTrans[mf] = 0.0f;
+    }
+  else
+    getDataPt(mf);
+  }
+
+// Room for a new point at index mf, with all per-point data moved up
+void insertSweepPoint(uint16_t mf, float f)
+  {
+  uint16_t n = sweepPoints - mf;
+
+  memmove(&dataFreq[mf+1], &dataFreq[mf], n*sizeof(float));
+  memmove(&dataReReflec[mf+1], &dataReReflec[mf], n*sizeof(float));
+  memmove(&dataImReflec[mf+1], &dataImReflec[mf], n*sizeof(float));
+  memmove(&dataReTrans[mf+1], &dataReTrans[mf], n*sizeof(float));
+  memmove(&dataImTrans[mf+1], &dataImTrans[mf], n*sizeof(float));
+  memmove(&dataHarmCdB[mf+1][0], &dataHarmCdB[mf][0], n*sizeof(dataHarmCdB[0]));
+  memmove(&dataSpurCdB[mf+1], &dataSpurCdB[mf], n*sizeof(int16_t));
+  memmove(&dataNoiseCdB[mf+1], &dataNoiseCdB[mf], n*sizeof(int16_t));
+  memmove(&dataPeakPct[mf+1], &dataPeakPct[mf], n*sizeof(uint8_t));
+  dataFreq[mf] = f;
+  sweepPoints++;
+  }
+
+// Change from point ii to ii+1, relative to the ADAPTSWEEP thresholds.
+// Z comes back from S11, as |Z| shows a resonance better than |S11|.
+float adaptChange(uint16_t ii)
+  {
+  float c = 0.0f, cT;
+
+  if (adaptMode != ADAPT_T)
+    {
+    Complex Zo(uSave.lastState.valueRRef[uSave.lastState.iRefR], 0.0);
+    Complex one(1.0, 0.0);
+    Complex g1(dataReReflec[ii], dataImReflec[ii]);
+    Complex g2(dataReReflec[ii+1], dataImReflec[ii+1]);
+    c = adaptScore(Zo*(one + g1)/(one - g1), Zo*(one + g2)/(one - g2));
+    }
+  if (adaptMode != ADAPT_Z)
+    {
+    cT = adaptScore(Complex(dataReTrans[ii], dataImTrans[ii]),
+                    Complex(dataReTrans[ii+1], dataImTrans[ii+1]));
+    if (cT > c)
+      c = cT;
+    }
+  return c;
+  }
+
+float adaptScore(Complex a, Complex b)
+  {
+  float ma, mb, dB, dPh;
+
+  ma = (float)a.modulus();
+  mb = (float)b.modulus();
+  if (ma <= 0.0f || mb <= 0.0f)
+    return (ma == mb) ? 0.0f : 1000.0f;   // Split, unless both are 0
+  dB = fabsf(20.0f*log10f(mb/ma));
+  dPh = (float)(b.phase() - a.phase());
+  dPh = r2df(dPh);
+  if (dPh > 180.0f)
+    dPh -= 360.0f;
+  else if (dPh < -180.0f)
+    dPh += 360.0f;
+  dPh = fabsf(dPh);
+  return max(dB/adaptThreshDB, dPh/adaptThreshDeg);
+  }
+
+// Send the ADAPTSWEEP points, in order, then "END" or "ABORT"
+void adaptSweepEnd(const char *s)
+  {
+  uint16_t kk;
+
+  if (sweepCurrentPoint < adaptNCoarse)   // Aborted in the log grid
+    sweepPoints = sweepCurrentPoint;
+  adaptSweep = false;
+  sweepCurrentPoint = sweepPoints;
+  totalDataPoints = sweepPoints;
+  for (kk=0; kk<sweepPoints; kk++)
+    sendStreamPoint(kk);
+  streamSweepText(s);
+  }
+
 // To support the sweep command, we need to get reflection and transmission data
 // points for one frequency of index nf:
 void getDataPt(uint16_t mf)
+  {
+  getDataPtZ(mf);      // Sets up the frequency
+  getDataPtT(mf);      // Same frequency, no more settling
+  }
+
+// Reflection part of getDataPt()
+void getDataPtZ(uint16_t mf)
   {
   //Complex Crefl(0.0, 0.0);
 
@@ -1840,7 +2876,7 @@ void getDataPt(uint16_t mf)
   FreqData[0].freqHz = dataFreq[mf];
   prepMeasure(FreqData[0].freqHz);   // This sets FreqData[0]
   setUpNewFreq(0);   // Sets up sample frequency and waveform freq
-  delay(ZDELAY);        // Delay until level is constant
+  settleDelay(ZDELAY);      // Delay until level is constant
   measureZ(0);      //  uses FreqData[0], result is Z[0]
 
  // Crefl = (Z[0] - Complex(50.0, 0.0)) / (Z[0] + Complex(50.0, 0.0));
@@ -1850,7 +2886,11 @@ void getDataPt(uint16_t mf)
   ReflCoeff = (Z[0] - Zo) / (Z[0] + Zo);
   dataReReflec[mf] = ReflCoeff.real();
   dataImReflec[mf] = ReflCoeff.imag();
+  }
 
+// Transmission part of getDataPt(), frequency already set up
+void getDataPtT(uint16_t mf)
+  {
   // And also a transmission measurement
   //  DC1.amplitude(dacLevel);     // Turn on sine wave
   //  setUpNewFreq(nFreq);
@@ -1860,6 +2900,19 @@ void getDataPt(uint16_t mf)
   measureT();      // result is Tmeas
   dataReTrans[mf] = Tmeas.real();
   dataImTrans[mf] = Tmeas.imag();
+  for (uint16_t k = 2; k <= HARM_MAX; k++)   // From the same T acquisition
+    {
+    if (measureHarmonics)
+      dataHarmCdB[mf][k-2] = (int16_t)(100.0f*harmonicDB[k] + (harmonicDB[k]<0.0f ? -0.5f : 0.5f));
+    else
+      dataHarmCdB[mf][k-2] = -20000;
+    }
+  if (bgSpectrumOn)         // Also from the T acquisition
+    {
+    dataSpurCdB[mf] = (int16_t)(100.0f*bgSpurDBc - 0.5f);    // Always negative
+    dataNoiseCdB[mf] = (int16_t)(100.0f*bgNoiseDBc - 0.5f);
+    dataPeakPct[mf] = (uint8_t)(bgPeakPct + 0.5f);
+    }
   }
 
 // For nanoVNA this starts sweep back up.  AVNA doesn't need that
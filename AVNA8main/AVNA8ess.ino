@@ -0,0 +1,288 @@
+//  AVNA8ess.ino
+// ESS command, impulse response and harmonic responses from an exponential
+// sine sweep, for the AVNA audio vector analyzer.
+/*  RSL_VNA8 Arduino sketch for audio VNA measurements.
+ *  Copyright (c) 2016-2020 Robert Larkin  W7PUA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Farina's method.  sweepExp, see src/synth_sweepExp_p, replaces the AVNA
+ * source at the output, the switches are set as for a T measurement, and
+ * ess, see src/analyze_ess_p, captures the reference and measure channels
+ * for ESS_N samples from the start of the sweep.  The sweep is ESS_SWEEP_N
+ * long, the rest of the capture is for the codec delay and the DUT's tail.
+ * Deconvolving by the captured reference gives y/x, as measureT(), for
+ * every bin at once, and the distortion of the DUT is sorted out by
+ * harmonic number from where it lands in time.  It all runs from
+ * taskMeasure() by essPoll(), so loop() is never held up.
+ *
+ * There is no through cal, as TFNOISE has.  The reference channel is in
+ * the ratio, so only the difference of the two input channels remains.
+ */
+
+/* EssCommand()  -  "ESS f1 f2 lvl sr h m"  Impulse response and harmonic
+ * responses of the DUT in the transmission fixture, from one exponential
+ * sweep.
+ *    f1, f2 = sweep start and end, Hz.  f1 at least ESS_MIN_CYCLES periods
+ *             in the sweep, ESS_MIN_CYCLES*sampleRate/ESS_SWEEP_N, 62.5 Hz
+ *             at 48 kHz, and never under 10.  f2 at least 2*f1 and at most
+ *             0.45 of the sample rate (default that lowest f1, 20000)
+ *    lvl = sweep amplitude, fraction of full scale, 0.01 to 0.9 (default 0.5)
+ *    sr  = sample rate index as SPECTRUM, 0 to 4 (default 3, 48 kHz)
+ *    h   = harmonics, 1 (linear only) to 5 (default 3).  Fewer are sent if
+ *          f2/f1 is too small to keep them apart.
+ *    m   = 0  Responses to serial (default)
+ *          1  Responses to a uSD file, ESSnnn.TXT
+ *          2  Impulse response to serial
+ * "ESS 0" aborts.  A capture is ESS_N/sampleRate, 85 msec at 48 kHz, with
+ * 64 msec of sweep, and the bin spacing is sampleRate/ESS_N.  Lower f1
+ * would leave about one period of it in the sweep, too little for the LF
+ * response or to keep the harmonics apart.  Responses are text, comment
+ * lines starting with "!", and a line per bin, f1 to f2,
+ *      Hz re(H1) im(H1) re(H2) im(H2) ...
+ * H1 is the linear y/x and Hk the response at k*Hz to the sweep at Hz,
+ * 0 0 when k*Hz is past half the sample rate.  There is no Touchstone
+ * option line, as this is not an S-parameter file.  The impulse response is
+ *      IR,n,time sec,h(n)
+ * for n = -ESS_N/2 to ESS_N/2-1, the harmonics being at negative time.
+ * Both end with "ESS,END,h".
+ */
+void EssCommand(void)
+  {
+  char *arg;
+  int sr = 3, h = 3, m = 0;
+  float f1 = -1.0f, f2 = 20000.0f, lvl = 0.5f, f1Min;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    f1 = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    f2 = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    lvl = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    sr = atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    h = atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    m = atoi(arg);
+
+  if (f1 == 0.0f)
+    {
+    if (essState != ESS_IDLE)
+      {
+      essStop();
+      workGive(WORK_ESS);
+      Serial.println("ESS,ABORT");
+      }
+    return;
+    }
+  if (sr<0 || sr>4)
+    {
+    Serial.println("Error: ESS needs sr 0 to 4");
+    return;
+    }
+  f1Min = ESS_MIN_CYCLES*freqASA[sr].sampleRate/(float)ESS_SWEEP_N;
+  if (f1Min < 10.0f)
+    f1Min = 10.0f;
+  if (f1 < 0.0f)                 // Not given
+    f1 = f1Min;
+  if (f1<f1Min || f2<2.0f*f1 || f2>0.45f*freqASA[sr].sampleRate ||
+      lvl<0.01f || lvl>0.9f || h<1 || h>ESS_MAX_HARM || m<0 || m>2)
+    {
+    Serial.print("Error: ESS needs f1 ");
+    Serial.print(f1Min, 1);
+    Serial.println(" or more, f2 2*f1 to 0.45*rate, lvl 0.01 to 0.9, h 1 to 5, m 0 to 2");
+    return;
+    }
+  if (m == 1 && !SDCardAvailable)
+    {
+    Serial.println("Error: ESS m=1 needs a uSD card");
+    return;
+    }
+  if (instrument != AVNA)
+    {
+    Serial.println("Error: ESS needs \"INSTRUMENT 0\" first");
+    return;
+    }
+  if (tfState != TF_IDLE)
+    {
+    Serial.println("Error: TFNOISE is running, \"TFNOISE 0\" aborts it");
+    return;
+    }
+  if (!workTake(WORK_ESS))
+    return;
+  essF1 = f1;
+  essF2 = f2;
+  essLevel = lvl;
+  essNHarm = (uint16_t)h;
+  essMode = (uint16_t)m;
+  essStart((uint16_t)sr);
+  }
+
+void essStart(uint16_t rateIndex)
+  {
+  if (lockInOn)
+     lockInStop();
+  doRun = RUNNOT;                // Nothing else may use the output
+  essRateIndex = rateIndex;
+  setSample(freqASA[rateIndex].rateIndex);
+  setRefR(uSave.lastState.iRefR);
+  setSwitch(TRANSMISSION_37);
+  mixer2.gain(0, 0.0f);          // Sig gens off
+  mixer2.gain(1, 0.0f);          // AVNA source off
+  essTime0 = millis();
+  essState = ESS_SETTLE;
+  }
+
+// Back to the AVNA source
+void essStop(void)
+  {
+  AudioNoInterrupts();
+  sweepExp.stop();
+  ess.stop();
+  AudioInterrupts();
+  essState = ESS_IDLE;
+  mixer2.gain(0, 0.0f);
+  mixer2.gain(1, 1.0f);
+  }
+
+// Called from taskMeasure() while essState is not ESS_IDLE
+void essPoll(void)
+  {
+  uint16_t nH;
+
+  if (essState == ESS_SETTLE)
+     {
+     if (millis() - essTime0 < ESS_SETTLE_MS)
+        return;
+     // Same update cycle for both, so the capture holds all of the sweep
+     AudioNoInterrupts();
+     sweepExp.begin(essF1, essF2, ESS_SWEEP_N, essLevel, sampleRateExact);
+     ess.start(workArea);
+     AudioInterrupts();
+     essState = ESS_RUN;
+     }
+  else if (essState == ESS_RUN && ess.available())
+     {
+     essStop();
+     ess.deconvolve(ESS_REG);
+     nH = ess.setHarmonics(essNHarm, (float32_t)ESS_SWEEP_N, essF2/essF1);
+     if (essMode == 2)
+        essSendIR();
+     else if (essMode == 1)
+        essSendFile(nH);
+     else
+        essSend(Serial, nH);
+     Serial.print("ESS,END,");
+     Serial.println(nH);
+     workGive(WORK_ESS);
+     }
+  }
+
+// Response lines, "!" comments then a line per bin, to Serial or a uSD file
+void essSend(Print& p, uint16_t nH)
+  {
+  float32_t binHz, re, im;
+  uint16_t j, j1, j2;
+  char line[80];
+
+  binHz = sampleRateExact/(float32_t)ESS_N;
+  j1 = (uint16_t)ceilf(essF1/binHz);
+  j2 = (uint16_t)(essF2/binHz);
+  if (j2 >= ESS_N/2)
+     j2 = ESS_N/2 - 1;
+  FormatBuffer fb(p, line, sizeof(line));
+  fb.addStr("! AVNA ESS, exponential sweep ");
+  fb.addFloat(essF1, 1);
+  fb.addStr(" to ");
+  fb.addFloat(essF2, 1);
+  fb.addStr(" Hz, sample rate ");
+  fb.addFloat(sampleRateExact, 1);
+  fb.addStr(" Hz\r\n! Hz, then re im of H1 (linear y/x) and of H2 to H");
+  fb.addChar('0' + nH);
+  fb.addStr(" at k*Hz\r\n");
+  for (j = j1; j <= j2; j++)
+     {
+     fb.addFloat(binHz*(float32_t)j, 3);
+     for (uint16_t k = 1; k <= nH; k++)
+        {
+        ess.response(k, j, &re, &im);       // 0, 0 past sampleRate/2
+        fb.addChar(' ');
+        fb.addFloat(re, 7);
+        fb.addChar(' ');
+        fb.addFloat(im, 7);
+        }
+     fb.addStr("\r\n");
+     }
+  fb.flush();
+  }
+
+void essSendFile(uint16_t nH)
+  {
+  char name[12] = "ESS000.TXT";
+  File essFile;
+  uint16_t i;
+
+  for (i = 0; i < 1000; i++)
+     {
+     name[3] = '0' + i/100;
+     name[4] = '0' + (i/10) % 10;
+     name[5] = '0' + i % 10;
+     if (!SD.exists(name))
+        break;
+     }
+  if (i >= 1000 || !(essFile = SD.open(name, FILE_WRITE)))
+     {
+     Serial.println("Error: ESS could not open a uSD file");
+     return;
+     }
+  essSend(essFile, nH);
+  essFile.close();
+  Serial.print("ESS,FILE,");
+  Serial.println(name);
+  }
+
+void essSendIR(void)
+  {
+  float32_t dt;
+  char line[80];
+
+  dt = 1.0f/sampleRateExact;
+  FormatBuffer fb(Serial, line, sizeof(line));
+  if (annotate)
+     fb.addStr("IR, n, time sec, h\r\n");
+  for (int32_t n = -ESS_N/2; n < ESS_N/2; n++)
+     {
+     fb.addStr("IR,");
+     fb.addFloat((float32_t)n, 0);
+     fb.addChar(',');
+     fb.addFloat(dt*(float32_t)n, 7);
+     fb.addChar(',');
+     fb.addFloat(ess.impulse(n), 7);
+     fb.addStr("\r\n");
+     }
+  fb.flush();
+  }
@@ -416,10 +416,35 @@ void topLines(void)
   topLine1();
   topLine2();
   topLine2a();
+  topLinesValid = true;
+  topLinesFreq = FreqData[nFreq].freqHzActual;
+  topLinesZorT = uSave.lastState.ZorT;
+  topLinesRefR = uSave.lastState.iRefR;
+  topLinesSD = SDCardAvailable;
+  }
+
+// Same as topLines() but skips the LCD writes if nothing shown has changed.
+// Line 1 is the slow one and only changes with the SD card status.
+void topLinesIfChanged(void)
+  {
+  if(!topLinesValid || topLinesSD != SDCardAvailable)
+    topLines();
+  else if(topLinesFreq != FreqData[nFreq].freqHzActual ||
+          topLinesZorT != uSave.lastState.ZorT ||
+          topLinesRefR != uSave.lastState.iRefR)
+    {
+    topLine2();
+    topLine2a();
+    topLinesValid = true;
+    topLinesFreq = FreqData[nFreq].freqHzActual;
+    topLinesZorT = uSave.lastState.ZorT;
+    topLinesRefR = uSave.lastState.iRefR;
+    }
   }
 
 void topLine1(void)
   {
+  topLinesValid = false;
   tft.fillRect(0, 0, tft.width(), 22, ILI9341_BLACK);
   tft.setTextColor(ILI9341_WHITE);
   tft.setFont(Arial_16);
@@ -435,6 +460,7 @@ void topLine1(void)
 
 void topLine2(void)
   {
+  topLinesValid = false;
   tft.fillRect(0, 22, tft.width(), 16, ILI9341_BLACK);
   tft.setTextColor(ILI9341_WHITE);
   tft.setCursor(5, 22);
@@ -682,7 +708,7 @@ void  exploreSDCard(void)
   {
   uint32_t volumesize;
   // See if the card is present and can be initialized
-  if (!SD.begin(chipSelect))
+  if (!mountSD())
     {
     Serial.println("uSD Card not present (or failed).");
     return;
@@ -0,0 +1,227 @@
+//  AVNA8log.ino
+// LOG command, long term logging of measurements to the uSD card, and the
+// uSD card presence check, for the AVNA audio vector analyzer.
+/*  RSL_VNA8 Arduino sketch for audio VNA measurements.
+ *  Copyright (c) 2016-2020 Robert Larkin  W7PUA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* The records are written by dataLog, see src/logR2/logR2.h.  The
+ * measurements add them with the logXxx() functions here, each only if
+ * its bit is set in logSources.  The v[] of each type are:
+ *   LOG_VVM     V rms, phase deg, amplitudeR, ADC % p-p.  flags=1 for the
+ *               sliding window VVM
+ *   LOG_Z       R, X, amplitudeV, amplitudeR.  aux = iRefR
+ *   LOG_T       gain V/V, phase deg, amplitudeV, amplitudeR
+ *   LOG_ASA     peak dB, SINAD dB, THD dB, S/N dB, f = peak freq.
+ *               flags=1 if the distortion values are valid
+ *   LOG_LOCKIN  R, X or gain V/V, phase deg, t sec (see LOCKIN), 0.
+ *               flags=1 for transmission
+ * f is the measurement frequency in Hz.
+ */
+
+void logVVM(float32_t mt, float32_t pt, float32_t pkPct, bool slide)
+  {
+  if (logSources & LOGSRC_VVM)
+    dataLog.add(LOG_VVM, slide ? 1 : 0, 0, FreqData[nFreq].freqHz,
+                mt, pt, (float)amplitudeR, pkPct);
+  }
+
+void logZ(uint16_t iF)
+  {
+  if (logSources & LOGSRC_ZT)
+    dataLog.add(LOG_Z, 0, uSave.lastState.iRefR, FreqData[iF].freqHz,
+                Z[iF].real(), Z[iF].imag(), (float)amplitudeV, (float)amplitudeR);
+  }
+
+void logT(uint16_t iF)
+  {
+  float32_t re = Tmeas.real();
+  float32_t im = Tmeas.imag();
+  float32_t ph;
+
+  if (logSources & LOGSRC_ZT)
+    {
+    ph = atan2f(im, re);
+    dataLog.add(LOG_T, 0, 0, FreqData[iF].freqHz, sqrtf(re*re + im*im),
+                r2df(ph), (float)amplitudeV, (float)amplitudeR);
+    }
+  }
+
+void logASA(void)
+  {
+  if (logSources & LOGSRC_ASA)
+    dataLog.add(LOG_ASA, distValid ? 1 : 0, 0, specMaxFreq,
+                uSave.lastState.SAcalCorrectionDB + pwr10DB,
+                distSINADDB, distTHDDB, distSNRDB);
+  }
+
+void logLockIn(float32_t a, float32_t b, float32_t t)
+  {
+  if (logSources & LOGSRC_LOCKIN)
+    dataLog.add(LOG_LOCKIN, (uSave.lastState.ZorT == IMPEDANCE) ? 0 : 1, 0,
+                FreqData[0].freqHzActual, a, b, t, 0.0f);
+  }
+
+/* taskSDProbe()  -  The "SD probe" task, every SD_CHECK_MS.  Keeps
+ * SDCardAvailable up to date.  card.init() resets the card, so it is not
+ * used while the log has a file open, or the arb gen is streaming; then a
+ * write error is what shows that the card is gone.  A card that is new (or
+ * back) is mounted with mountSD().
+ */
+void taskSDProbe(void)
+  {
+  bool present;
+
+  if (dataLog.writing() || arbWave.streaming())
+    {
+    SDCardAvailable = true;
+    return;
+    }
+  present = card.init(SPI_HALF_SPEED, chipSelect);
+  if (present && !SDCardAvailable)
+    present = mountSD();
+  SDCardAvailable = present;
+  }
+
+/* mountSD()  -  Mounts the card for SD, also after one has been mounted.
+ * With the SdFat based SD of Teensyduino 1.54 and later, the old volume is
+ * ended first, as SD.begin() does not do that, so every card put in gets a
+ * real mount.  The older SD library has no way to close its volume, and
+ * its FAT and cluster cache would still be of the card that was taken out.
+ * There, once a mounted card has gone, no card is used again, for logging
+ * or anything else, until a restart.
+ */
+bool mountSD(void)
+  {
+#if defined(SD_FAT_VERSION)
+  if (SDMounted)
+    SD.sdfs.end();
+  SDMounted = SD.begin(chipSelect);
+  return SDMounted;
+#else
+  static bool toldRestart = false;
+
+  if (SDMounted)                 // Was taken out, maybe a new card
+    {
+    if (!toldRestart)
+      Serial.println("uSD card was removed, restart to use a card again");
+    toldRestart = true;
+    return false;
+    }
+  SDMounted = SD.begin(chipSelect);
+  return SDMounted;
+#endif
+  }
+
+/* taskLogWrite()  -  The "Log write" task, at most a sector per run.  A
+ * write error marks the card as gone, so that taskSDProbe() mounts it
+ * again when it is back.
+ */
+void taskLogWrite(void)
+  {
+  static uint32_t lastErrors = 0;
+
+  if (dataLog.errors() != lastErrors)
+    {
+    lastErrors = dataLog.errors();
+    SDCardAvailable = false;
+    }
+  dataLog.service(SDCardAvailable);
+  }
+
+/* LogCommand()  -  "LOG s mb"  Log measurements to LOGnnn.BIN files on
+ * the uSD card.  s is the sum of the sources:
+ *    1  VVM readings            4  ASA peak and distortion, each average
+ *    2  Single frequency Z, T   8  LOCKIN results
+ * s = 0 writes what is waiting and closes the file.  mb is the file size,
+ * in MBytes, before the next file is started, 1 to 1024 (default 16).
+ * "LOG" alone prints the status.  Logging starts without a card, and the
+ * records are written when a card is put in.  tools/avnaLogDecode.py in
+ * the repository converts the files to CSV.
+ */
+void LogCommand(void)
+  {
+  char *arg;
+  uint16_t s;
+  uint32_t mb = 16;
+
+  arg = SCmd.next();
+  if (arg == NULL)
+    {
+    printLogStatus();
+    return;
+    }
+  s = (uint16_t)atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    mb = (uint32_t)atoi(arg);
+  if (s > 15 || mb < 1 || mb > 1024)
+    {
+    Serial.println("Error: LOG needs s 0 to 15 and mb 1 to 1024");
+    return;
+    }
+  if (s == 0)
+    {
+    logSources = 0;
+    if (dataLog.running())
+      {
+      dataLog.stop();
+      printLogStatus();
+      }
+    return;
+    }
+  if (!dataLog.running())
+    dataLog.start(mb*1048576UL);
+  logSources = s;
+  if (!SDCardAvailable)
+    Serial.println("Warning: No uSD card, records wait in RAM");
+  if (verboseData)
+    Serial.println("LOG successfully programmed.");
+  }
+
+void printLogStatus(void)
+  {
+  if (annotate)
+    {
+    Serial.print(dataLog.running() ? "Logging, sources=" : "Not logging, sources=");
+    Serial.print(logSources);
+    Serial.print("  file LOG");
+    if (dataLog.fileNumber() < 100)  Serial.print("0");
+    if (dataLog.fileNumber() < 10)   Serial.print("0");
+    Serial.print(dataLog.fileNumber());
+    Serial.print(dataLog.writing() ? ".BIN open, " : ".BIN closed, ");
+    Serial.print(dataLog.fileBytes());
+    Serial.print(" bytes  records=");  Serial.print(dataLog.records());
+    Serial.print(" waiting=");         Serial.print(dataLog.waiting());
+    Serial.print(" lost=");            Serial.print(dataLog.lost());
+    Serial.print(" errors=");          Serial.println(dataLog.errors());
+    return;
+    }
+  Serial.print("LOG,");
+  Serial.print(dataLog.running() ? 1 : 0);   Serial.print(",");
+  Serial.print(logSources);                  Serial.print(",");
+  Serial.print(dataLog.fileNumber());        Serial.print(",");
+  Serial.print(dataLog.fileBytes());         Serial.print(",");
+  Serial.print(dataLog.records());           Serial.print(",");
+  Serial.print(dataLog.waiting());           Serial.print(",");
+  Serial.print(dataLog.lost());              Serial.print(",");
+  Serial.println(dataLog.errors());
+  }
@@ -141,7 +141,23 @@
 #include "src/complexR2/complexR2.h"
 #include "src/SerialCommandR2/SerialCommandR2.h"
 #include "src/analyze_fft1024_p/analyze_fft1024_p.h"
+#include "src/analyze_zoomFFT_p/analyze_zoomFFT_p.h"
+#include "src/analyze_harmonics_p/analyze_harmonics_p.h"
+#include "src/analyze_lockin_p/analyze_lockin_p.h"
+#include "src/analyze_fft2_p/analyze_fft2_p.h"
+#include "src/analyze_ess_p/analyze_ess_p.h"
+#include "src/synth_sweepExp_p/synth_sweepExp_p.h"
+#include "src/synth_arbitrary_p/synth_arbitrary_p.h"
 #include "src/synth_GaussianWhiteNoiseR2/synth_GaussianWhiteNoiseR2.h"
+#include "src/perfR2/perfR2.h"
+#include "src/formatR2/formatR2.h"
+#include "src/binFrameR2/binFrameR2.h"
+#include "src/fitR2/fitR2.h"
+#include "src/sumR2/sumR2.h"
+#include "src/benchR2/benchR2.h"
+#include "src/specAveR2/specAveR2.h"
+#include "src/logR2/logR2.h"
+#include "src/schedR2/schedR2.h"
 // use fifo buffer for serial input of commands:
 #include "src/CircularBufferR2/CircularBufferR2.h"
 #include <vector>
@@ -211,6 +227,10 @@
 
 // msec delay before measurement
 #define ZDELAY 10
+// Settling, see settleDelay().  Fixed is the old delay(ZDELAY...).
+#define SETTLE_FIXED  0
+#define SETTLE_DETECT 1
+#define SETTLE_SKIP_BLOCKS 4   // Audio blocks in the DAC-to-ADC pipeline
 
 #define NOCAL 0
 #define OPEN 1
@@ -278,6 +298,7 @@
 //#define WAVEFORM_SAMPLE_HOLD       7
 //#define WAVEFORM_TRIANGLE_VARIABLE 8
 #define NOISE                      9
+#define ARB_STREAM                10     // Arb gen, uSD file in place of the table
 
 // Signal generators can display volts or power into 50 Ohms
 #define VOLTS 0
@@ -292,6 +313,7 @@ void tToASA(void);
 void tToASAFreq(void);
 void tToASAAmplitude(void);
 void tToASASinad(void);
+void tToASADual(void);
 void tToASGHome(void);
 void tToASGn(void);
 void tDoSingleFreq(void);
@@ -338,11 +360,11 @@ void (*t[22][6])(void) =
   tToAVNAHome, tNothing, tNothing, tDoSingleT, tCalCommand, tNothing,                  // 9 Single T
   tToAVNAHome, tSweepFreqDown, tSweepFreqUp, tNothing, tCalCommand, tDoSweepT,         // 10 Sweep T
   tToAVNAHome, tSweepFreqDown, tSweepFreqUp, tNothing, tCalCommand, tDoSweepZ,         // 11 Sweep Z
-  tToInstrumentHome,  tToASAFreq, tToASAAmplitude, tToASASinad, tNothing, tNothing,    // 12 ASA
-  tToASA, tToASAFreq, tToASAFreq, tToASAFreq, tToASAFreq, tNothing,                    // 13 ASA Freq
+  tToInstrumentHome,  tToASAFreq, tToASAAmplitude, tToASASinad, tToASADual, tNothing,  // 12 ASA
+  tToASA, tToASAFreq, tToASAFreq, tToASAFreq, tToASAFreq, tToASAFreq,                  // 13 ASA Freq
   tToASA, tToASAAmplitude, tToASAAmplitude, tToASAAmplitude, tToASAAmplitude, tDoHelp, // 14 ASA Amplitude
-  tToInstrumentHome, tToASGn, tToASGn, tToASGn, tToASGn, tNothing,                     // 15 ASG Home
-  tToASGHome, tToASGn, tToASGn, tToASGn, tToASGn, tNothing,                            // 16 ASG N
+  tToInstrumentHome, tToASGn, tToASGn, tToASGn, tToASGn, tToASGn,                      // 15 ASG Home
+  tToASGHome, tToASGn, tToASGn, tToASGn, tToASGn, tToASGn,                             // 16 ASG N
   tToInstrumentHome, tToVVM, tToVVM, tToVVM, tNothing, tNothing,                       // 17 VVM Home
   tToInstrumentHome, tTouchCal, tVInCal, tVOutCal, tNothing, tNothing,                 // 18 Service
   tNothing, tNothing, tNothing, tNothing, tNothing, tNothing,                          // 19 Touch Cal
@@ -364,17 +386,28 @@ XPT2046_Touchscreen ts(T_CS_PIN, TIRQ_PIN);  // Param 2 - Touch IRQ Pin - interr
 //Audio objects          instance name
 AudioSynthWaveform       sgWaveform[4];   //Added for 4-channel; sig gen 3 used now
 AudioSynthNoiseGaussian  noise1;
+AudioSynthArbitrary_p    arbWave;         // Sig gen 5, wavetable or uSD stream
+AudioSynthSweepExp_p     sweepExp;        // Exponential sweep, silent unless ESS
+AudioSynthNoiseGaussian  benchNoise;      // Not connected, only for BENCH timing
 AudioMixer4              mixer1;          // Combine 4 waveforms
 AudioMixer4              mixer2;          // Add waveforms to AVNA source
+AudioMixer4              mixer3;          // Sig gens 1 to 4 plus the arb gen
 AudioConnection          patchCordp(sgWaveform[0], 0, mixer1, 0);
 AudioConnection          patchCordq(sgWaveform[1], 0, mixer1, 1);
 AudioConnection          patchCordr(sgWaveform[2], 0, mixer1, 2);
 AudioConnection          patchCords(noise1,        0, mixer1, 3);
-AudioConnection          patchCordt(mixer1,        0, mixer2, 0);
+AudioConnection          patchCordt(mixer1,        0, mixer3, 0);
+AudioConnection          patchCordv(arbWave,       0, mixer3, 1);
+AudioConnection          patchCordw(mixer3,        0, mixer2, 0);
+AudioConnection          patchCordu(sweepExp,      0, mixer2, 2);
 // Regular AVNA objects
 AudioControlSGTL5000     audioShield;
 AudioInputI2S            audioInput;      // Measurement signal
 AudioAnalyzeFFT1024_p    fft1024p;
+AudioAnalyzeZoomFFT_p    zoomFFT;         // Narrow span ASA, off unless ASAZoom>1
+AudioAnalyzeHarmonics_p  harmDet;         // H2 to H5 of the AVNA measure channel
+AudioAnalyzeFFT2_p       fft2;            // Ref and measure channels, TFNOISE or dual ASA
+AudioAnalyzeESS_p        ess;             // Ref and measure capture, off unless ESS
 AudioFilterFIR           firIn1;
 AudioFilterFIR           firIn2;
 AudioSynthWaveform       waveform1;       // Test signal
@@ -388,6 +421,7 @@ AudioRecordQueue         queueNN[4];      // Two pairs of I and Q
 // And for the reference channel
 AudioEffectMultiply      multR1;          // I mixer
 AudioEffectMultiply      multR2;          // Q mixer
+AudioAnalyzeLockIn_p     lockIn;          // Continuous decimated I-Q, off unless LOCKIN
 // Additional measurments
 AudioAnalyzePeak         pkDet;           // These 2 watch for overload
 AudioAnalyzePeak         pkDetR;
@@ -395,6 +429,8 @@ AudioAnalyzeRMS          rms1;
 //                                  Into cord     Out-of cord
 //                                 coming from    going to
 AudioConnection          patchCord4(audioInput, 0, fft1024p, 0);    // Transmission ADC to FFTAudioAnalyzeFFT1024_p
+AudioConnection          patchCord4Z(audioInput, 0, zoomFFT, 0);    // Transmission ADC to zoom FFT
+AudioConnection          patchCord4H(audioInput, 0, harmDet, 0);    // Unfiltered, so above LPF2300 also
 AudioConnection          patchCord0(waveform1, 0, multGainDAC, 0);  // Test signal
 AudioConnection          patchCord0A(DC1, 0,      multGainDAC, 1);  // Set gain
 //Was AudioConnection          patchCord0C(multGainDAC, 0, i2s2, 0);    // Test signal to L output
@@ -417,9 +453,29 @@ AudioConnection          patchCordG2(firIn2, 0, multR1, 0);         // FIR LPF t
 AudioConnection          patchCordG3(firIn2, 0, multR2, 0);         // FIR LPF to mixer Q
 AudioConnection          patchCordR5(multR1, 0, queueNN[2], 0);     // RQ
 AudioConnection          patchCordR6(multR2, 0, queueNN[3], 0);     // RI
+AudioConnection          patchCordL0(mult1, 0,  lockIn, 0);         // Q, same order as queueNN[]
+AudioConnection          patchCordL1(mult2, 0,  lockIn, 1);         // I
+AudioConnection          patchCordL2(multR1, 0, lockIn, 2);         // RQ
+AudioConnection          patchCordL3(multR2, 0, lockIn, 3);         // RI
 AudioConnection          patchCordRp(audioInput, 1, pkDetR, 0);
+AudioConnection          patchCordX0(audioInput, 1, fft2, 0);       // x, reference channel
+AudioConnection          patchCordX1(audioInput, 0, fft2, 1);       // y, measure channel
+AudioConnection          patchCordE0(audioInput, 1, ess, 0);        // x, reference channel
+AudioConnection          patchCordE1(audioInput, 0, ess, 1);        // y, measure channel
 AudioConnection          pc100(audioInput, 0, rms1, 0);
 
+// Audio blocks for AudioMemory(), the worst case of the graph above:
+//    I2S input filling, L and R                        2
+//    I2S output, two per channel                       4
+//    fft1024p, 8 held for the overlapped FFT           8
+//    One output from each object that sends blocks,
+//    as if all were alive at once in one update       23
+//    queueNN[], up to 3 each in getNmeasQI()          12
+// The rest hold none between updates, and lockIn keeps the sliding VVM
+// sums out of the pool.  Counted from the code, not measured, "PERF"
+// prints AudioMemoryUsageMax() to check it on the hardware.
+#define AUDIO_BLOCKS 49
+
 
 // "Complex" objects are a set of two ordered float32
 // Object array as a vectors, Z, Y and T
@@ -509,6 +565,81 @@ uint16_t sendDataType = 0;
 int16_t sendDataCount = -1;
 // Need to keep a "total" in case another quantity is set by sweep command
 uint16_t totalDataPoints = 0;
+// BINARY command.  Spectra, data, frequencies and Z as frames, see binFrameR2.h
+bool binaryOut = false;
+// STREAMSWEEP in progress, one point per loop(), sent as measured
+bool streamSweep = false;
+// ADAPTSWEEP in progress, log grid and then refinement, one point per loop()
+#define ADAPT_Z  0
+#define ADAPT_T  1
+#define ADAPT_ZT 2
+bool adaptSweep = false;
+uint16_t adaptMode = ADAPT_Z;    // Which of S11, S21 or both decide refinement
+uint16_t adaptNCoarse = 0;       // Log grid points, measured first
+uint16_t adaptBudget = 0;        // Total points
+float adaptThreshDB = 0.5f;      // Change between neighbors that adds a point
+float adaptThreshDeg = 5.0f;
+// RESONANCE command, result of the last search.  resType is 0=none,
+// RES_SERIES (|Z| min, X goes - to +) or RES_PARALLEL (|Z| max, X + to -)
+#define RES_SERIES   1
+#define RES_PARALLEL 2
+#define RES_MAX_ITER 10
+uint16_t resType = 0;
+float32_t resF0, resQ, resR0;
+uint16_t resCount;              // Measurements used
+// FIT command and WHATSIT, Z data for the circuit fit and the last result
+float fitRe[1601];
+float fitIm[1601];
+float fitF[14];                 // Frequencies for Z[] data.  Sweeps use dataFreq[]
+FitResult fitLast;
+// LOCKIN command, continuous Z or T from the lockIn object
+bool lockInOn = false;
+uint16_t lockInR;               // Audio samples per output
+float32_t lockInRate;           // Outputs per second, sampleRateExact/lockInR
+uint32_t lockInLost;            // Last lockIn.lost() reported
+// TFNOISE command, noise excited transfer function.  See AVNA8tf.ino
+#define TF_IDLE   0
+#define TF_SETTLE 1             // Noise on, waiting TF_SETTLE_MS
+#define TF_RUN    2             // fft2 averaging
+#define TF_SETTLE_MS 50
+uint16_t tfState = TF_IDLE;
+uint16_t tfNAve;
+uint16_t tfRateIndex;           // Index to freqASA[]
+bool tfThruMeas;                // This measurement is the through cal
+uint32_t tfTime0;
+float32_t tfThruRe[512];        // H1 of the through connection
+float32_t tfThruIm[512];
+int16_t tfThruRateIndex = -1;   // tfRateIndex of the through cal, -1 for none
+// ESS command, exponential sweep impulse and harmonic responses.  See AVNA8ess.ino
+#define ESS_IDLE   0
+#define ESS_SETTLE 1            // Rate and switches set, waiting ESS_SETTLE_MS
+#define ESS_RUN    2            // Sweep out, ess capturing
+#define ESS_SETTLE_MS 50
+#define ESS_REG 1.0E-4f         // Deconvolution floor, relative to the peak |X|^2
+#define ESS_SWEEP_N (3*ESS_N/4)  // Sweep samples, the rest of ESS_N is delay and IR tail
+#define ESS_MIN_CYCLES 4        // Least periods of f1 in the sweep
+uint16_t essState = ESS_IDLE;
+float32_t essF1, essF2, essLevel;
+uint16_t essRateIndex;          // Index to freqASA[]
+uint16_t essNHarm;              // Asked for, 1 to ESS_MAX_HARM
+uint16_t essMode;               // 0 serial, 1 uSD file, 2 impulse response
+uint32_t essTime0;
+// One work area for the big buffers of objects that are not needed at the
+// same time, see workTake().  Each library gives the bytes it needs.
+#define WORK_FREE     0
+#define WORK_ZOOM     1         // zoomFFT, ASA zoom in the background
+#define WORK_ASA_DUAL 2         // fft2, ASA dual channel in the background
+#define WORK_TFNOISE  3         // fft2, until the results are sent
+#define WORK_ESS      4         // ess, until the results are sent
+#define WORK_ARB      5         // Sig gen 5 stream halves, while streaming
+#define WORK_BENCH    6         // BENCH buffers, while it runs
+#define WORK_BYTES    ESS_WORK_BYTES   // The largest
+uint32_t workArea[WORK_BYTES/4];       // uint32_t for the alignment
+uint16_t workUser = WORK_FREE;
+static_assert(ZOOM_WORK_BYTES <= WORK_BYTES, "Work area too small for zoomFFT");
+static_assert(FFT2_WORK_BYTES <= WORK_BYTES, "Work area too small for fft2");
+static_assert(ARB_STREAM_WORK_BYTES <= WORK_BYTES, "Work area too small for arbWave");
+static_assert(BENCH_WORK_BYTES <= WORK_BYTES, "Work area too small for BENCH");
 
 //  ===  Variables added to support nanoVNA-saver   ===
 // Not measuring, notsending data
@@ -528,6 +659,12 @@ float dataReReflec[1601];
 float dataImReflec[1601];
 float dataReTrans[1601];
 float dataImTrans[1601];
+// Harmonics 2 to HARM_MAX re fundamental, 0.01 dB units.  See HARMONICS command
+int16_t dataHarmCdB[1601][HARM_MAX-1];
+// Background spectrum, spur and noise dBc in 0.01 dB and ADC peak %.  See BGSPECTRUM
+int16_t dataSpurCdB[1601];
+int16_t dataNoiseCdB[1601];
+uint8_t dataPeakPct[1601];
 
 // portSelect                |------ Use USB Serial for nanoVNA-saver data
 //                           ||------Use HWSERIAL4 for  nanoVNA-saver data
@@ -549,20 +686,41 @@ uint16_t numCycles;
 */
 boolean   doTuneup = false;  // Change print during tuneup
 boolean   NNReady[4] = {false, false, false, false};
-float32_t sumNN[4];
+bool      measureHarmonics = false;       // harmDet runs with each getNmeasQI()
+float32_t harmonicDB[HARM_MAX+1];         // dB re fundamental, index is harmonic number
+// Background spectrum stats from fft1024p during getNmeasQI().  See BGSPECTRUM
+bool      bgSpectrumOn = false;
+uint16_t  bgSpectrumInterval = 2;         // FFT 1 of n frames while measuring
+uint8_t   bgSpecMask[512];                // 1 for bins that are noise or spurs
+float32_t bgSpecPwr1, bgSpecSpurMax, bgSpecNoiseSum;
+uint16_t  bgSpecSpurBin, bgSpecFrames;
+float32_t bgSpurDBc, bgSpurHz, bgNoiseDBc, bgPeakPct;   // Results, last measurement
 double    superAveNN[4];
-int16_t   bufferNN[4][256];
+// Settling detector and phase continuous LO stepping
+uint16_t  settleMode = SETTLE_DETECT;
+float32_t settleTolerance = 0.002f;  // Max relative change of V and R, chunk to chunk
+bool      phaseContinuous = true;    // LO not reset to 0/270 deg with each new freq
+bool      loPhaseSet = false;
+// Statistics for SETTLE command, [SETTLE_FIXED] and [SETTLE_DETECT]
+uint32_t  settleCount[2] = {0, 0};
+uint64_t  settleSumUs[2] = {0, 0};   // uint32_t would wrap after 71 minutes
+uint64_t  settleFixedUs = 0;         // Fixed delays the detected points replaced
+uint32_t  settleTimeouts = 0;
 
 struct sigGen {  // Structure defined here.  See EEPROM save for asg[]
     float32_t freq;
     float32_t amplitude;
     bool ASGoutputOn;
     short type;
-} asg[4] = {
+} asg[5] = {
     996.094f, 0.2828f,  false, WAVEFORM_SINE,
     1900.0f,  0.05f,    false, WAVEFORM_SINE,
     3000.0f,  0.0f,     false, WAVEFORM_SQUARE,
-    40000.0f, 0.1f,     false, NOISE};
+    40000.0f, 0.1f,     false, NOISE,
+    1000.0f,  0.1f,     false, WAVEFORM_ARBITRARY};
+// Sig gen 5, the arb gen, when its type is ARB_STREAM.  See SIGGEN.
+char arbStreamName[13] = "";
+bool arbStreamLoop = true;
 
 //          ----------------------------------------------------------
 // Data to be saved when updated and used at power up.
@@ -660,7 +818,7 @@ uint16_t lcdMenu[22][6]    // Select next as 0 to 6. Indices are [current menu][
      0, 13, 14, 12, 12, 12,  // Menu 12 Spectrum analyzer Home
     12, 13, 13, 13, 13, 13,  // Menu 13 Spectrum analyzer frequency
     12, 14, 14, 14, 14, 14,  // Menu 14 Spectrum analyzer amplitude
-     0, 16, 16, 16, 16, 15,  // Menu 15 Signal Generator Home
+     0, 16, 16, 16, 16, 16,  // Menu 15 Signal Generator Home
     15, 16, 16, 16, 16, 16,  // Menu 16 Signal Generator N
      0, 17, 17, 17, 17, 17,  // Menu 17 Vector Voltmeter
      0, 19, 20, 21, 18, 18,  // Menu 18 Service
@@ -672,6 +830,18 @@ uint16_t lcdMenu[22][6]    // Select next as 0 to 6. Indices are [current menu][
 uint16_t nSampleRate = S100K;     // Current rate,  1 is S44117 or 44711.65Hz rate
 float32_t sampleRateExact = 1.000000E8;   // = 100000000.00;
 float32_t factorFreq = 0.4411764706f;
+// Configuration cache.  setI2SFreq(), setSample(), setFilter() and topLinesIfChanged()
+// only touch hardware, filters and LCD when something changed.  configCacheOn=false
+// is the old always-reprogram behavior, used by SETUPTIME for comparison.
+bool configCacheOn = true;
+int16_t i2sFreqIndexNow = -1;      // -1 forces the first write
+double i2sFreqExactNow = 0.0;
+int16_t filterNow = -1;
+bool topLinesValid = false;        // Anything painting over y<38 clears this
+float32_t topLinesFreq = 0.0f;
+uint16_t topLinesZorT = 0;
+uint16_t topLinesRefR = 0;
+bool topLinesSD = false;
 
 Complex Ztuneup(0.0f, 0.0f);   // Adjusted for the 0.22 uF coupling cap
 Complex Ztuneup0(0.0f, 0.0f);  // No 0.22 uF adjustment
@@ -731,6 +901,23 @@ float32_t phaseOffset = 0.0f;
 int16_t VVMFormat = VVM_VOLTS;
 bool VVMSendSerial = false;
 
+// Sliding window VVM, see VVMSlideMeasure().  VVMWindowMs=0 is the block
+// measurement with getFullDataPt().
+#define VVM_MAX_BLOCKS 400
+// The block sums come from lockIn.beginBlockSums(), which holds no audio
+// blocks.  Its ring of LOCKIN_RING blocks, 340 ms at 96 kHz, takes up a late
+// loop(), and past that the window starts over, see VVMDrain().
+uint32_t VVMGaps = 0;            // Window restarts from a late drain
+uint32_t VVMNextBlock;           // Block number expected from lockIn
+uint16_t VVMWindowMs = 0;        // Integration window
+uint16_t VVMPublishHz = 50;      // New readings per second
+bool VVMSlideRestart = true;
+bool VVMSumsRunning = false;
+int32_t VVMBlockSum[VVM_MAX_BLOCKS][4];  // Ring of 128 sample sums, NN order
+int64_t VVMRunSum[4];
+uint16_t VVMnWin, VVMiRing, VVMnFilled;
+char VVMLastMag[16], VVMLastPh[16];       // As drawn, for digit by digit update
+
 // Save the freq[0] from the AVNA when using VVM
 float32_t saveFreq0;
 
@@ -750,6 +937,7 @@ int16_t sigGenUnits = VOLTS;
 // Variables added with the Spectrum Analyzer
 int16_t pixelnew[256];
 int16_t pixelold[256];
+int16_t pixel2[256];           // Second trace of the ASA dual channel modes
 int16_t spectrum_mov_average = 0;
 int  spectrum_y = 15;
 int  spectrum_x = 45;
@@ -761,6 +949,22 @@ float32_t specMax, specMaxFreq;
 //  float32_t khzPerDiv = 4.0f;
 //  float32_t khzOffset = 0.0f;
 uint16_t ASAI2SFreqIndex = 4;  // 96 kHz sample rate
+uint16_t ASAZoom = 1;          // 1 is full span, else 2 to 256 with zoomFFT
+float32_t ASAZoomCenter = 1000.0f;  // Hz
+bool ASARestartAve = false;
+// ASA averaging, over SAnAve frames.  See doFFT() and specAveR2.h
+#define ASA_AVE_BLOCK 0     // Power sum of SAnAve frames, then start over
+#define ASA_AVE_EXP   1     // Running exponential, time constant SAnAve frames
+#define ASA_AVE_MAX   2     // Max hold
+#define ASA_AVE_MIN   3     // Min hold
+uint16_t ASAAveMode = ASA_AVE_BLOCK;
+bool ASALogAve = false;     // Average dB, not power
+// ASA dual channel, fft2 on the measure and reference inputs.  See doDualFFT()
+#define ASA_DUAL_OFF   0    // fft1024p, measure channel only
+#define ASA_DUAL_AUTO  1    // Measure and reference (cyan) spectra, dBm
+#define ASA_DUAL_GAIN  2    // |H1| measure/reference in dB, coherence (cyan)
+#define ASA_DUAL_PHASE 3    // Phase of measure to reference, coherence (cyan)
+uint16_t ASADual = ASA_DUAL_OFF;
 uint16_t countMax = 100;  //  User adjustable
 uint16_t countAve = 0;     // Set to zero to start new average
 bool SASendSerial = false;
@@ -781,8 +985,17 @@ struct frequencyData {
     192000.0f, S192K, 80.0f, "192 kHz", 32, 15937.5, 85};
 
 float pwr10, pwr10DB;
-float sinadNoisePower, sinadSignalPower, signalOnlyPower;
-float sinadNoisePowerDB, sinadSignalPowerDB, signalOnlyPowerDB;
+// Distortion analysis, see analyzeDistortion() in AVNA8ASA.ino
+#define DIST_MAX_HARMONIC 10
+uint16_t distNHarmonics = 5;    // Fundamental plus harmonics 2 to 5
+uint16_t distBinSpan = 3;       // Half-width in bins; Hann main lobe is +/-2
+float32_t distFreqLow = 20.0f;  // Noise bandwidth limits, Hz
+float32_t distFreqHigh = 20000.0f;
+float32_t distFundFreq = 0.0f;
+float32_t distFundPower, distHarmPower, distNoisePower;
+float32_t distHarmDB[DIST_MAX_HARMONIC + 1];  // dB re fundamental, index is harmonic number
+float32_t distTHDDB, distTHDPct, distTHDNDB, distSINADDB, distSNRDB;
+bool distValid = false;
 bool sinadOn = false;
 uint16_t sinadLastIndex = 4;    // ASAI2SFreqIndex for return from SINAD
 bool ASASendSerial = false;
@@ -792,7 +1005,9 @@ bool ASASendSerial = false;
  *  4  = Column of 512 (0 is row of 512)
  *  8  = CR-LF not just LF (for columns)
  * 16  = Leading/Trailing '|'
- * 32  = dB, not power          */
+ * 32  = dB, not power
+ * 64  = Append distortion line
+ *128  = Distortion line only, no spectrum  */
 uint16_t ASASerialFormat = 18;
 
 // ----------- End Spectrum analyzer variables -------
@@ -800,6 +1015,7 @@ uint16_t ASASerialFormat = 18;
 // Variables to support BMP Screen Saves to SD Card
 const int chipSelect = BUILTIN_SDCARD; // for Teensy 3.6
 bool SDCardAvailable = false;
+bool SDMounted = false;         // SD.begin() has worked, see mountSD()
 bool bmpScreenSDCardRequest = false;
 bool hexScreenRequest = false;
 File bmpFile;
@@ -807,7 +1023,17 @@ File bmpFile;
 Sd2Card card;
 SdVolume volume;
 SdFile root;
-unsigned int mmmm;
+#define SD_CHECK_MS 1000        // "SD probe" task period, when not logging
+// LOG command, data logging to the uSD card.  logSources is the sum of:
+#define LOGSRC_VVM    1
+#define LOGSRC_ZT     2
+#define LOGSRC_ASA    4
+#define LOGSRC_LOCKIN 8
+DataLog dataLog;
+uint16_t logSources = 0;
+// loop() is a cooperative scheduler, the tasks are added at the end of setup()
+Scheduler sched;
+int16_t tidCommand = -1;
 //===================================================================================
 // To use STL Vector container, we need to trap some errors.
 // See https://forum.pjrc.com/threads/23467-Using-std-vector  #10 Thanks, davidthings!
@@ -925,10 +1151,13 @@ void setup()
 
   // Each additional AudioMemory uses 256 bytes of RAM (dynamic memory).
   // This stores 128-16-bit ints.   Dec 16 usage 8
-  AudioMemory(35);           // Last seen peaking at 20
+  // See AUDIO_BLOCKS.  "PERF" prints the max used.
+  AudioMemory(AUDIO_BLOCKS);
+  perfBegin();               // DWT cycle counter for PERF
  
   mixer2.gain(0, 0.0);       // Turn off signal generatrs
   mixer2.gain(1, 0.0);       // Turn off AVNA source signal 
+  mixer2.gain(2, 1.0);       // ESS sweep, sends nothing when idle
   DC1.amplitude(dacLevel);   // Gain control for DAC output
   
   AudioNoInterrupts();     // Use to synchronize all audio
@@ -994,9 +1223,25 @@ void setup()
   SCmd.addCommand("SAVE", saveStateEEPROM);
   SCmd.addCommand("LOAD", loadStateEEPROM);
   SCmd.addCommand("DELAY", DelayCommand);
+  SCmd.addCommand("SETTLE", SettleCommand);     // Settling detector and LO phase stepping
+  SCmd.addCommand("HARMONICS", HarmonicsCommand); // H2-H5 with T measurements
+  SCmd.addCommand("BGSPECTRUM", BgSpectrumCommand); // Spur and noise stats with each measurement
+  SCmd.addCommand("ADAPTSWEEP", AdaptSweepCommand);  // Log sweep, points added where data changes
+  SCmd.addCommand("RESONANCE", ResonanceCommand);    // Search for f0 and Q
+  SCmd.addCommand("FIT", FitCommand);                // Equivalent circuit of Z data
+  SCmd.addCommand("LOCKIN", LockInCommand);          // Continuous Z or T stream
+  SCmd.addCommand("LOG", LogCommand);                // Data logging to uSD
+  SCmd.addCommand("SCHED", SchedCommand);            // loop() task statistics
+  SCmd.addCommand("TFNOISE", TfNoiseCommand);        // Noise excited transfer function
+  SCmd.addCommand("ESS", EssCommand);                // Exponential sweep impulse response
   SCmd.addCommand("CALDAT", CalDatCommand);
   SCmd.addCommand("SERPAR", SerParCommand);
   SCmd.addCommand("TEST", TestCommand);
+  SCmd.addCommand("SETUPTIME", SetupTimeCommand);  // Timing probe for setUpNewFreq()
+  SCmd.addCommand("PERF", PerfCommand);        // Cycle counter times, see perfR2.h
+  SCmd.addCommand("BENCH", BenchCommand);      // Fixed data timing of DSP and formatting
+  SCmd.addCommand("BINARY", BinaryCommand);    // Binary frames for bulk data
+  SCmd.addCommand("STREAMSWEEP", StreamSweepCommand);  // Sweep, each point sent when done
   SCmd.addCommand("PARAM1", Param1Command);    // R50, R5K values and also use defaults
   SCmd.addCommand("PARAM2", Param2Command);    // Impedance correction factors`
   SCmd.addCommand("TUNEUP", TuneupCommand);    // Estimate strays
@@ -1023,6 +1268,7 @@ void setup()
   SCmd.addCommand("SIGGEN", SigGenCommand);
   SCmd.addCommand("VECTORVM", VVMCommand);
   SCmd.addCommand("SPECTRUM", ASACommand);
+  SCmd.addCommand("ZOOM", ZoomCommand);
   SCmd.addCommand("SCREENSAVE", ScreenSaveCommand);
   SCmd.addDefaultHandler(unrecognized);         // Handler for command that isn't matched
   // Response variations:  ECHO_FULL_COMMAND replies with full received line, even if command is not valid.
@@ -1072,6 +1318,10 @@ void setup()
     }
   noise1.amplitude(0.1f);       // Fourth generator is noise, turn on here.
   mixer1.gain(3, 0.0f);         // and not enabled, either
+  arbWave.frequency(asg[4].freq, sampleRateExact);   // Fifth is the arb gen, a sine table
+  arbWave.amplitude(uSave.lastState.sgCal*asg[4].amplitude);
+  mixer3.gain(0, 1.0f);         // Sig gens 1 to 4
+  mixer3.gain(1, 0.0f);         // Arb gen off
 
   // The following sets up serial port 4, 9600 baud RS-232 control of the AVNA using comands from the
   // nanoVNA.  This is compatible with using the following for control:
@@ -1086,38 +1336,177 @@ void setup()
     serInBuffer.pop();
 
   // instrument = ALL_IDLE;
-  setSample(S96K);                                      mmmm=millis();
+  setSample(S96K);
+
+  // loop() runs these, see schedR2.h.  Budgets are in us, and the
+  // measurement ones are the time for a typical point or sweep.
+  sched.add("Serial in",   taskSerialIn,   0, SCHED_EVERY, 200);
+  tidCommand =
+  sched.add("Command",     taskCommand,    0, SCHED_EVENT, 20000);
+  sched.add("Measure",     taskMeasure,    1, SCHED_EVERY, 250000);
+  sched.add("LCD Z or T",  taskLCDSingle,  1, SCHED_EVERY, 250000);
+  sched.add("RUN",         taskRun,        1, SCHED_EVERY, 2000000);
+  sched.add("Touch",       taskTouch,      2, 20000,       50000);
+  sched.add("Power sweep", taskPowerSweep, 2, 10000,       100);
+  sched.add("Log write",   taskLogWrite,   3, 5000,        20000);
+  sched.add("Arb stream",  taskArbStream,  0, SCHED_EVERY, 3000);
+  sched.add("SD probe",    taskSDProbe,    3, 1000UL*SD_CHECK_MS, 5000);
+  sched.add("Usage",       taskUsage,      3, 1000000,     1000);
   }
 
 // =====================================  LOOP  ============================================
 void loop()
+  {
+  sched.run();
+
+#if DIAGNOSTICS
+  Serial.print("Proc = ");
+  Serial.print(AudioProcessorUsage());
+  Serial.print(" (");
+  Serial.print(AudioProcessorUsageMax());
+  Serial.print("),  Mem = ");
+  Serial.print(AudioMemoryUsage());
+  Serial.print(" (");
+  Serial.print(AudioMemoryUsageMax());
+  Serial.println(")");
+#endif
+  }
+
+/* The loop() tasks, added at the end of setup().  Measurements block for
+ * their own time, but the waits that were delay()'s are sched.sleep()'s,
+ * so commands, touch and the SD card are seen in between.
+ */
+
+// "Arb stream"  Refills a free half of the arb gen uSD stream.  Every pass,
+// as a half is only ARB_STREAM_N/sampleRate long.  New underruns are
+// reported, at most once a second.  A stream that has ended turns sig gen 5
+// off, so that the screens and SG show it off.
+void taskArbStream(void)
+  {
+  static uint32_t nReported = 0;
+  static uint32_t tReport = 0;
+  uint32_t n;
+
+  audioService();
+  if (arbWave.ended() && asg[4].ASGoutputOn)
+    {
+    asg[4].ASGoutputOn = false;
+    setArbGen();                // Closes the stream, mixer3 gain 0
+    Serial.println("Arb gen stream ended, sig gen 5 off");
+    }
+  n = arbWave.underruns();
+  if (n < nReported)          // A new stream
+    nReported = 0;
+  if (n > nReported && (millis() - tReport) >= 1000UL)
+    {
+    Serial.print("Warning: arb gen stream underruns=");
+    Serial.println(n);
+    nReported = n;
+    tReport = millis();
+    }
+  }
+
+/* audioService()  -  Audio work that cannot wait for a task that blocks
+ * up to its budget, the arb gen stream and the sliding VVM block sums.
+ * Called by "Arb stream" and from inside the
+ * measurement waits (getFullDataPt(), settleDelay()) and show_spectrum().
+ * Must not start anything that waits.
+ */
+void audioService(void)
+  {
+  arbWave.service();
+  if (VVMSumsRunning)        // Sliding VVM, keep the lockIn ring from filling
+    VVMDrain();
+  }
+
+/* workTake(user)  -  workArea[] for user, true if user now has it.  The
+ * ASA zoom and dual modes run in the background and give way to anyone,
+ * ASARestartAve, and doFFT() picks them up again when the area is free.
+ * The other users hold it until their results are read, and in the
+ * meantime a foreground take is an error.
+ */
+bool workTake(uint16_t user)
+  {
+  if(workUser == user || workUser == WORK_FREE)
+    {
+    workUser = user;
+    return true;
+    }
+  if(workUser == WORK_ZOOM || workUser == WORK_ASA_DUAL)
+    {
+    AudioNoInterrupts();
+    if(workUser == WORK_ZOOM)
+      zoomFFT.setZoom(0, 0.0f, 0.0f);
+    else
+      fft2.end();
+    AudioInterrupts();
+    ASARestartAve = true;
+    workUser = user;
+    return true;
+    }
+  if(user != WORK_ZOOM && user != WORK_ASA_DUAL)
+    {
+    Serial.print("Error: ");
+    Serial.print(workUserName(user));
+    Serial.print(" needs the work area, in use by ");
+    Serial.println(workUserName(workUser));
+    }
+  return false;
+  }
+
+void workGive(uint16_t user)
+  {
+  if(workUser == user)
+    workUser = WORK_FREE;
+  }
+
+const char* workUserName(uint16_t user)
+  {
+  static const char* names[] = {"nothing", "ASA zoom", "ASA dual",
+                                "TFNOISE", "ESS", "sig gen 5 stream", "BENCH"};
+  return user <= WORK_BENCH ? names[user] : "?";
+  }
+
+// "Usage"  Processor usage, the first 2 seconds after power on
+void taskUsage(void)
+  {
+  static int processPercentCount = 0;
+  if(++processPercentCount>1 && processPercentCount<4)   // 1 and 2 seconds
+    {
+    Serial.print ("Processor usage, percent = ");
+    Serial.println( AudioProcessorUsageMax() );
+    }
+  }
+
+// "Serial in"  Serial i/o can come from either the USB Serial or from UART HWSERIAL4
+// connected to a RS-232 serial.  It is the operator that needs to prevent data
+// coming from both, that is not difficult.  Characters are queued for "Command".
+void taskSerialIn(void)
   {
   char inChar;
-  uint16_t boxNum;
-  bool istouched;
-  bool changeSgSettings;
-  
-  
-  // TEMP  <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-  static int processPercentCount = 0;  // Let this wrap
-  if( (millis() - mmmm)>1000  &&  ++processPercentCount<3 ) {
-	  Serial.print ("Processor usage, percent = ");
-	  Serial.println( AudioProcessorUsageMax() );
-      mmmm=millis();
-      }
 
-  // Serial i/o can come from either the USB Serial or from UART HWSERIAL4 connected to a RS-232 serial.
-  // Check if either has data and send all that is available to try to build a command. It is the operator
-  // that needs to prevent data coming from both, that is not difficult.  comm
   while (Serial.available() > 0)
     {
     inChar = Serial.read();   // Read an available character, there may be more waiting
     serInBuffer.unshift(inChar);
     }
+  if((commandOpen && !serInBuffer.isEmpty()) || HWSERIAL4.available() > 0)
+    sched.signal(tidCommand);
+  }
+
+// "Command"  Event, run after "Serial in" has characters
+void taskCommand(void)
+  {
+  char inChar;
+
   if(commandOpen)
     {
     while( !serInBuffer.isEmpty() )
-      SCmd.processCh(serInBuffer.pop());
+      {
+      uint32_t tPerf = perfStart();
+      if(SCmd.processCh(serInBuffer.pop()) != 0)   // A command was run
+        perfStop(PERF_COMMAND, tPerf);
+      }
     }
 
   //The HWSERIAL needs similar treatment
@@ -1130,59 +1519,180 @@ void loop()
     // if(cmdResult == 1)  HWSERIAL4.println("What cmd?");
     // if(cmdResult == 2)  HWSERIAL4.println("OK");
     }
+  }
+
+// "Measure"  The ASA, VVM and the AVNA touch states that run once, plus the
+// serial sweeps and streams that do a point per run
+void taskMeasure(void)
+  {
+  // The 1024 FFT runs every frame only for the ASA
+  if (instrument == ASA)
+    fft1024p.setInterval(ASADual == ASA_DUAL_OFF ? 1 : 0);   // Dual uses fft2
+  else
+    fft1024p.setInterval(bgSpectrumOn ? bgSpectrumInterval : 0);
 
   if (instrument == ASA)
     doFFT();
 
   if(instrument == VVM)
     VVMMeasure();
+  else if(VVMSumsRunning)     // Left sliding VVM
+    VVMSlideStop();
 
-  if(instrument==AVNA)
+  if(instrument==AVNA && avnaState == WHATSIT)      //What Component
     {
-    // Following if's will execute each loop() and are for touch control
-    if(avnaState == 0)     // Idle
-      {
-      ;
-      }
-    else if(avnaState==ZSINGLE)
-      {
-      // This is for LCD control, not serial.  Always repetitive measurements until
-      // stopped by a touch entry.
-      setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
-      setSwitch(IMPEDANCE_38);           // Connect for Z measure
-      doZSingle(true);
-      delay(1000);
-      }
-   else if(avnaState == TSINGLE)         // T Meas 1 Freq
-      {
-      setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
-      setSwitch(TRANSMISSION_37);        // Connect for Z measure
-      doTSingle(true);
-      delay(1000);
-      }
-   else if(avnaState == ZSWEEP)
-     {
-     ;  // These are empty at this point.
-     }
-   else if(avnaState == TSWEEP)
-     {
-     ;
-     }
-   else if(avnaState == WHATSIT)      //What Component
+    doWhatPart();
+    avnaState = IDLE;               // Force only one run
+    }
+
+  // For mimicking the nanoVNA, need to gather data, a point at a time, and
+  // send data, a line at a time.  See "sweep f1 f2 n" and "data k" commands
+  if(streamSweep)
+    {
+    if(sweepCurrentPoint < sweepPoints)
+       {
+       getDataPt(sweepCurrentPoint);
+       sendStreamPoint(sweepCurrentPoint++);
+       }
+    else
+       {
+       streamSweep = false;
+       streamSweepText("END");
+       }
+    }
+  if(adaptSweep)
+    adaptSweepStep();
+  if(lockInOn)
+    lockInDrain();
+  if(tfState != TF_IDLE)
+    tfPoll();
+  if(essState != ESS_IDLE)
+    essPoll();
+
+  if(doingNano && nanoState == MEASURE_NANO)
+    {
+    if(sweepCurrentPoint < sweepPoints)
+       getDataPt(sweepCurrentPoint++);         // Both reflecton and transmission
+    else if(sweepCurrentPoint == sweepPoints)   // Done collecting data
+       {
+       //sendEOT();  Don't want "ch> " after sweep
+       sweepCurrentPoint++;   // Once is enough
+       nanoState = DATA_READY_NANO;
+       commandOpen = true;      // We held up commands.  Let them in
+       }
+    }
+
+  // And in about the same way, send data lines
+  if(doingNano && nanoState == DATA_READY_NANO)
      {
-     doWhatPart();
-     avnaState = IDLE;               // Force only one run
+     if(sendDataCount < totalDataPoints && binaryOut)
+        {
+        sendDataFrame();           // All points at once
+        sendDataCount = totalDataPoints;
+        }
+     else if(sendDataCount < totalDataPoints)
+        sendDataLine(sendDataCount++);
+     else if(sendDataCount == totalDataPoints)
+        {
+        sendEOT();            // Announce the end of data 0 or 1
+        sendDataCount++;      // So we don't do EOT again
+        nanoState = NO_NANO;   // End of serial data output
+        commandOpen = true;
+        }
      }
-   else if(avnaState == LCDHELP)
+  }
+
+// "LCD Z or T"  This is for LCD control, not serial.  Always repetitive
+// measurements, a second apart, until stopped by a touch entry.
+void taskLCDSingle(void)
+  {
+  if(instrument != AVNA)
+    return;
+  if(avnaState==ZSINGLE)
+    {
+    setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
+    setSwitch(IMPEDANCE_38);           // Connect for Z measure
+    doZSingle(true);
+    sched.sleep(1000000UL);
+    }
+  else if(avnaState == TSINGLE)        // T Meas 1 Freq
+    {
+    setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
+    setSwitch(TRANSMISSION_37);        // Connect for Z measure
+    doTSingle(true);
+    sched.sleep(1000000UL);
+    }
+  }
+
+// "RUN"  SERIAL CONTROL, the RUN command measurements
+void taskRun(void)
+  {
+  if(instrument==AVNA && doRun != RUNNOT && doRun != POWER_SWEEP)
+    {
+    if(teststate == 1)
+      ;
+    else     // Not test, response for serial control
+      {
+      if (nRun == 0)  // Counted down, time to stop   // REARRANGE
+        doRun = RUNNOT;
+      else if (doRun == COUNTDOWN)
+        nRun--;
+      // Sort out Sweep or Single;  Impedance or Transmission
+      if (doRun == COUNTDOWN || doRun == CONTINUOUS || doRun ==SINGLE_NC)
+        {
+        if (uSave.lastState.ZorT == IMPEDANCE)   // Measure Z
+           {
+           setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
+           setSwitch(IMPEDANCE_38);
+           if (uSave.lastState.SingleorSweep == SWEEP)
+              {
+              doZSweep(true, 1);     //  Do a impedance measurement with sweep
+              if(useLCD)
+                 LCDPrintSweepZ();
+              }
+          else
+              {
+              doZSingle(true);
+              }
+           }
+        else                      // TRANSMISSION
+           {
+           setRefR(uSave.lastState.iRefR);   // Set relay for Ref R
+           setSwitch(TRANSMISSION_37);
+           if (uSave.lastState.SingleorSweep == SWEEP)
+              doTSweep(true);     //  Do a transmission measurement with sweep
+           else
+              doTSingle(true);
+              if(doRun==SINGLE_NC) doRun = RUNNOT;
+           }
+        sched.sleep(1000UL*uSave.lastState.msDelay);   // Slow down, if desired
+        }      // End repetitive loop
+     }  // End not test
+  }  // End Serial Control
+  }
+
+// "Power sweep"  Every 10 ms
+void taskPowerSweep(void)
+  {
+  if(instrument == AVNA && doRun == POWER_SWEEP)
      {
-     ; // No processing required
+     dacSweep *= 1.04;
+     dacLevel = dacSweep;
+     if(dacLevel > 0.5)
+        {
+        doRun = RUNNOT;         // Pack up like we were never here
+        dacLevel = 0.4;
+        }
      }
-   }     // End if instrument==AVNA
+  }
 
-  // Check if SD card is present and mark in SDCardAvailable
-  SDCardAvailable = card.init(SPI_HALF_SPEED, chipSelect);
+// "Touch"  TOUCH SCREEN
+void taskTouch(void)
+  {
+  uint16_t boxNum;
+  bool istouched;
+  bool changeSgSettings;
 
-  // TOUCH SCREEN
   istouched = ts.touched();
   if (istouched  &&  (millis()-tms) > 250)  // Set repeat rate and de-bounce or T_REPEAT
     {
@@ -1206,7 +1716,9 @@ void loop()
       {
       drawScreenSaveBox(ILI9341_RED);
       bmpScreenSDCardRequest = true;
+      uint32_t tPerf = perfStart();
       dumpScreenToSD();
+      perfStop(PERF_SCREEN_DUMP, tPerf);
       drawScreenSaveBox(ILI9341_GREEN);
       }
     if(p.y > touchy(198))     //  3200)   // The bottom row of menu choices
@@ -1314,107 +1826,6 @@ void loop()
        }  // End, if currentMenu==17 (VVM)
     wastouched = istouched;
     }    // End, screen was touched
-
- //if( rms1.available() )
- //   { Serial.println(rms1.read(), 4); delay(500); }
-
-  if(instrument == AVNA && doRun == POWER_SWEEP)
-     {
-     dacSweep *= 1.04;
-     dacLevel = dacSweep;
-     if(dacLevel > 0.5)
-        {
-        doRun = RUNNOT;         // Pack up like we were never here
-        dacLevel = 0.4;
-        }
-     delay(10);
-     }
-
-  // SERIAL CONTROL
-  if(instrument==AVNA && doRun != RUNNOT && doRun != POWER_SWEEP)
-    {
-    if(teststate == 1)
-      ;
-    else     // Not test, response for serial control
-      {
-      if (nRun == 0)  // Counted down, time to stop   // REARRANGE
-        doRun = RUNNOT;
-      else if (doRun == COUNTDOWN)
-        nRun--;
-      // Sort out Sweep or Single;  Impedance or Transmission
-      if (doRun == COUNTDOWN || doRun == CONTINUOUS || doRun ==SINGLE_NC)
-        {
-        if (uSave.lastState.ZorT == IMPEDANCE)   // Measure Z
-           {
-           setRefR(uSave.lastState.iRefR);    // Select relay for reference resistor
-           setSwitch(IMPEDANCE_38);
-           if (uSave.lastState.SingleorSweep == SWEEP)
-              {
-              doZSweep(true, 1);     //  Do a impedance measurement with sweep
-              if(useLCD)
-                 LCDPrintSweepZ();
-              }
-          else
-              {
-              doZSingle(true);
-              }
-           }
-        else                      // TRANSMISSION
-           {
-           setRefR(uSave.lastState.iRefR);   // Set relay for Ref R
-           setSwitch(TRANSMISSION_37);
-           if (uSave.lastState.SingleorSweep == SWEEP)
-              doTSweep(true);     //  Do a transmission measurement with sweep
-           else
-              doTSingle(true);
-              if(doRun==SINGLE_NC) doRun = RUNNOT;
-           }
-        delay(uSave.lastState.msDelay);       // Slow down, if desired
-
-        }      // End repetitive loop
-     }  // End not test
-  }  // End Serial Control
-
-#if DIAGNOSTICS
-  Serial.print("Proc = ");
-  Serial.print(AudioProcessorUsage());
-  Serial.print(" (");
-  Serial.print(AudioProcessorUsageMax());
-  Serial.print("),  Mem = ");
-  Serial.print(AudioMemoryUsage());
-  Serial.print(" (");
-  Serial.print(AudioMemoryUsageMax());
-  Serial.println(")");
-#endif
-
-  // For mimicking the nanoVNA, need to gather data, a point at a time, and
-  // send data, a line at a time.  See "sweep f1 f2 n" and "data k" commands
-  if(doingNano && nanoState == MEASURE_NANO)
-    {
-    if(sweepCurrentPoint < sweepPoints)
-       getDataPt(sweepCurrentPoint++);         // Both reflecton and transmission
-    else if(sweepCurrentPoint == sweepPoints)   // Done collecting data
-       {
-       //sendEOT();  Don't want "ch> " after sweep
-       sweepCurrentPoint++;   // Once is enough
-       nanoState = DATA_READY_NANO;
-       commandOpen = true;      // We held up commands.  Let them in
-       }
-    }
-
-  // And in about the same way, send data lines
-  if(doingNano && nanoState == DATA_READY_NANO)
-     {
-     if(sendDataCount < totalDataPoints)
-        sendDataLine(sendDataCount++);
-     else if(sendDataCount == totalDataPoints)
-        {
-        sendEOT();            // Announce the end of data 0 or 1
-        sendDataCount++;      // So we don't do EOT again
-        nanoState = NO_NANO;   // End of serial data output
-        commandOpen = true;
-        }
-     }
   }
 //  =================  END LOOP()  ======================
 
@@ -1656,6 +2067,33 @@ Serial.println(FreqData[0].numTenths);
 // Output a line to Serial over USB.  Annotated or not, and corresponding
 // to frequency index iF.  Assumes that useUSB is in effect
 void serialPrintZ(uint16_t iF)
+  {
+  if(binaryOut)
+    sendZFrame(Serial, iF);
+  else
+    printZ(Serial, iF);
+  if(bgSpectrumOn)
+    printBgSpectrum(Serial, FreqData[iF].freqHz);
+  }
+
+// The serialPrintZ() values as a BF_Z frame.  Computes ReflCoeff as printZ().
+void sendZFrame(Print &p, uint16_t iF)
+  {
+  float v[7];
+  BinFrame bf(p);
+  Complex Zo(uSave.lastState.valueRRef[uSave.lastState.iRefR], 0.0);
+
+  ReflCoeff = (Z[iF] - Zo) / (Z[iF] + Zo);
+  v[0] = Z[iF].real();   v[1] = Z[iF].imag();
+  v[2] = Y[iF].real();   v[3] = Y[iF].imag();
+  v[4] = sLC[iF];        v[5] = pLC[iF];       v[6] = Q[iF];
+  bf.begin(BF_Z, 1, sizeof(v), FreqData[iF].freqHz, 0.0f);
+  bf.add(v, sizeof(v));
+  bf.end();
+  }
+
+// The serialPrintZ() line, to any Print
+void printZ(Print &p, uint16_t iF)
   {
   Complex Zo(uSave.lastState.valueRRef[uSave.lastState.iRefR], 0.0);
 
@@ -1666,36 +2104,36 @@ void serialPrintZ(uint16_t iF)
   ReflPhase = r2df(ReflCoeff.phase());
   if(uSave.lastState.rsData == 0)   // Print reflection coefficient in dB (Return Loss) and phase
     {
-    Serial.print(FreqData[iF].freqHz, 3);
+    p.print(FreqData[iF].freqHz, 3);
       // Reflection Coefficient.  Annotation is optional.
     if (annotate)
-         Serial.print(" Hz Return Loss = ");
+         p.print(" Hz Return Loss = ");
     else
-         Serial.print(",");
-    Serial.print(RetLoss, 3);
+         p.print(",");
+    p.print(RetLoss, 3);
 
     if (annotate)
-         Serial.print(" dB  Phase = ");
+         p.print(" dB  Phase = ");
     else
-         Serial.print(",");
-    Serial.println(r2df(ReflCoeff.phase()), 2);
+         p.print(",");
+    p.println(r2df(ReflCoeff.phase()), 2);
     }
   else if(uSave.lastState.rsData == 1)   // Print reflection coefficient in  magnitude and phase
     {
 
-    Serial.print(FreqData[iF].freqHz, 3);
+    p.print(FreqData[iF].freqHz, 3);
       // Reflection Coefficient.  Annotation is optional.
     if (annotate)
-         Serial.print(" Hz Reflection Coefficient = ");
+         p.print(" Hz Reflection Coefficient = ");
     else
-         Serial.print(",");
-    Serial.print((float)ReflCoeff.modulus(), 5);
+         p.print(",");
+    p.print((float)ReflCoeff.modulus(), 5);
 
     if (annotate)
-         Serial.print("  Phase = ");
+         p.print("  Phase = ");
     else
-         Serial.print(",");
-    Serial.println(ReflPhase, 2);
+         p.print(",");
+    p.println(ReflPhase, 2);
 
     }
   else             // uSave.lastState.tsData == 2  Print series/parallel R, X
@@ -1703,106 +2141,106 @@ void serialPrintZ(uint16_t iF)
     if(seriesRX)         // Series R and X values, plus L or C needed
       {
       // Always output freq
-      Serial.print(FreqData[iF].freqHz, 3);
+      p.print(FreqData[iF].freqHz, 3);
       // Output series Z,  L or C, and Q.  Annotation is optional.
       if (annotate)
-         Serial.print(" Hz Series RX: R=");
+         p.print(" Hz Series RX: R=");
       else
-         Serial.print(",");
-      Serial.print(Z[iF].real(), 3);
+         p.print(",");
+      p.print(Z[iF].real(), 3);
       if (annotate)
-         Serial.print(" X=");
+         p.print(" X=");
       else
-         Serial.print(",");
-      Serial.print(Z[iF].imag(), 3);
+         p.print(",");
+      p.print(Z[iF].imag(), 3);
       // Serial print C or L value
       if (Z[iF].imag() < 0.0)
         {
         if (annotate)
           {
-          Serial.print(" C=");
-          Serial.print(valueString(sLC[iF], cUnits));
-          Serial.print(" Q=");
+          p.print(" C=");
+          p.print(valueString(sLC[iF], cUnits));
+          p.print(" Q=");
           }
         else       // just CSV
           {
-          Serial.print(",");
-          Serial.print(sLC[iF], 12);
-          Serial.print(",");
+          p.print(",");
+          p.print(sLC[iF], 12);
+          p.print(",");
           }
-        Serial.println(Q[iF]);
+        p.println(Q[iF]);
         }
       else    // Looks like an inductor
         {
         if (annotate)
           {
-          Serial.print(" L= ");
-           Serial.print(valueString(sLC[iF], lUnits));
-          Serial.print(" Q=");
+          p.print(" L= ");
+           p.print(valueString(sLC[iF], lUnits));
+          p.print(" Q=");
           }
         else       // just CSV
           {
-          Serial.print(",");
-          Serial.print(sLC[iF], 9);
-          Serial.print(",");
+          p.print(",");
+          p.print(sLC[iF], 9);
+          p.print(",");
           }
-        Serial.println(Q[iF]);
+        p.println(Q[iF]);
         }
       }
     if(parallelRX)   // Not exclusive with series RX
       {
-      Serial.print(FreqData[iF].freqHz, 3);
+      p.print(FreqData[iF].freqHz, 3);
       // Output Y, L or C, and Q.  Annotation is optional.
       if (annotate)
-         Serial.print(" Hz Parallel GB: G=");
+         p.print(" Hz Parallel GB: G=");
       else
-         Serial.print(",");
-      Serial.print(Y[iF].real(), 9);
+         p.print(",");
+      p.print(Y[iF].real(), 9);
       if (annotate)
-         Serial.print(" B=");
+         p.print(" B=");
       else
-         Serial.print(",");
-      Serial.print(Y[iF].imag(), 9);
+         p.print(",");
+      p.print(Y[iF].imag(), 9);
       if (annotate)
-         Serial.print(" R= ");
+         p.print(" R= ");
       else
-         Serial.print(",");
-      Serial.print(1.0/Y[iF].real());
+         p.print(",");
+      p.print(1.0/Y[iF].real());
       if (Y[iF].imag() >= 0.0)
         {
         if (annotate)
           {
-          Serial.print(" C=");
-          Serial.print(valueString(pLC[iF], cUnits));
-          Serial.print(" Q=");
+          p.print(" C=");
+          p.print(valueString(pLC[iF], cUnits));
+          p.print(" Q=");
           }
         else       // just CSV
           {
-          Serial.print(",");
-          Serial.print(pLC[iF], 12);
-          Serial.print(",");
+          p.print(",");
+          p.print(pLC[iF], 12);
+          p.print(",");
           }
-        Serial.println(Q[iF]);
+        p.println(Q[iF]);
         }
       else    // Looks like an inductor
         {
         if (annotate)
           {
-          Serial.print(" L= ");
-          Serial.print(valueString(sLC[iF], lUnits));
-          Serial.print(" Q=");
+          p.print(" L= ");
+          p.print(valueString(sLC[iF], lUnits));
+          p.print(" Q=");
           }
         else       // just CSV
           {
-          Serial.print(",");
-          Serial.print(sLC[iF], 9);
-          Serial.print(",");
+          p.print(",");
+          p.print(sLC[iF], 9);
+          p.print(",");
           }
-        Serial.println(Q[iF]);
+        p.println(Q[iF]);
         }
       }
     }      // End if(uSave.lastState.tsData == 2)  R & X
-  }        // end serialPrintZ(uint16_t iF)
+  }        // end printZ(Print &p, uint16_t iF)
 
 // -------------------------------------------------------------------------
 /*  Not having filtering after the mixers improves the transient
@@ -1857,17 +2295,24 @@ float32_t modifyFreq(float32_t f)
 
 void setSample(uint16_t nS)
   {
+  float32_t newRate;
   // nS is one of the 8 or so possible rates, named S6K, ... ,S192K
-  sampleRateExact = (float32_t)setI2SFreq(nS);  // It returns a double
+  newRate = (float32_t)setI2SFreq(nS);  // It returns a double
+  // Same rate means factorFreq and the sig gens are already right
+  if(configCacheOn && newRate == sampleRateExact)
+    return;
+  sampleRateExact = newRate;
   //factorFreq is global that corrects any call involving absolute frequency, like waveform generation.
   factorFreq = FBASE / sampleRateExact;
 #if DIAGNOSTICS
   Serial.print(" S Rate=");  Serial.print(sampleRateExact); Serial.print( "ff=");
   Serial.println(factorFreq);
 #endif
-  // The 4 sig gens need to be reprogrammed for new factorFreq
+  // Sig gens 1 to 3 need the new factorFreq and 5, the arb gen, the new
+  // rate.  4 is noise, with no frequency.
   for (unsigned int ii = 0; ii<3; ii++)
     sgWaveform[ii].begin(uSave.lastState.sgCal*asg[ii].amplitude, factorFreq*asg[ii].freq, asg[ii].type);
+  arbWave.frequency(asg[4].freq, sampleRateExact);
  //  SET LPF ON NOISE GEN <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
   }
 
@@ -1877,6 +2322,9 @@ void setSample(uint16_t nS)
 */
 void setFilter(uint16_t firFilt)
   {
+  if(configCacheOn && (int16_t)firFilt == filterNow)
+    return;
+  filterNow = (int16_t)firFilt;
   if (firFilt == LPF2300)           // LPF with 0 to 2300 Hz passband and -20 dB above.
     { // 100 KHz sample rate only
     firIn1.begin(lp2300_100K, 100);
@@ -1895,7 +2343,6 @@ void setUpNewFreq(uint16_t nF)
   {
   // Converted to float ver .80
   float32_t fr = FreqData[nF].freqHz;
-  topLines();
   if (fr < 2300.0f)
     {
     setSample(S100K);
@@ -1957,11 +2404,21 @@ void setUpNewFreq(uint16_t nF)
     setFilter(FILT_NONE);
     }
   modifyFreq(fr);
+  if(configCacheOn)
+    topLinesIfChanged();  // After modifyFreq() so f is the actual one
+  else
+    topLines();
   AudioNoInterrupts();
   waveform1.frequency(factorFreq * FreqData[nFreq].freqHz);
-  waveform1.phase(0);
   waveform2.frequency(factorFreq * FreqData[nFreq].freqHz);
-  waveform2.phase(270);
+  // Both LO's step together, so 90 deg is kept without a reset.  The reset
+  // is a step in the DAC signal, and that is a transient to wait out.
+  if(!phaseContinuous || !loPhaseSet)
+    {
+    waveform1.phase(0);
+    waveform2.phase(270);
+    loPhaseSet = true;
+    }
   AudioInterrupts();
   }
 
@@ -2072,6 +2529,8 @@ double setI2SFreq(uint16_t iFreq)
   #define I2S_MDR_FRACT(n)  ((uint32_t)(n & 0xff)<<12)         // MCLK Fraction
   #define I2S_MDR_DIVIDE(n) ((uint32_t)(n & 0xfff))            // MCLK Divide
    */
+  if(configCacheOn && (int16_t)iFreq == i2sFreqIndexNow)
+    return i2sFreqExactNow;     // No register write, no wait on DUF
   while (I2S0_MCR & I2S_MCR_DUF) ;  // This is to make sure I2S controller is up to speed NEEDED??
 
   I2S0_MDR = I2S_MDR_FRACT((clkArr[iFreq].mult - 1)) | I2S_MDR_DIVIDE((clkArr[iFreq].div - 1));
@@ -2081,7 +2540,9 @@ double setI2SFreq(uint16_t iFreq)
      Serial.print("F_PLL=");  Serial.println(F_PLL);  */
 //rev.80
 #define DOUBLE_256 ((double) 256.0L)
-  return  ((double)F_PLL) * ((double)clkArr[iFreq].mult) / (DOUBLE_256 * ((double)clkArr[iFreq].div));
+  i2sFreqIndexNow = (int16_t)iFreq;
+  i2sFreqExactNow = ((double)F_PLL) * ((double)clkArr[iFreq].mult) / (DOUBLE_256 * ((double)clkArr[iFreq].div));
+  return i2sFreqExactNow;
 }
 
 // valueStringSign()
@@ -39,8 +39,9 @@ void doZSingle(bool out)
 
   DC1.amplitude(dacLevel);     // Turn on sine wave
   setUpNewFreq(nFreq);
-  delay(ZDELAY);   // Delay until level is constant
+  settleDelay(ZDELAY);   // Delay until level is constant
   measureZ(nFreq);
+  logZ(nFreq);
   // if (useUSB)
   serialPrintZ(nFreq);
   // if(useLCD)
@@ -69,7 +70,7 @@ void doZSweep(bool out, uint16_t iStart)
   for (nFreq = iStart; nFreq <= 13;  nFreq++) // Over all frequencies; nFreq is global freq index
     {
     setUpNewFreq(nFreq);
-    delay(ZDELAY);        // Delay until level is constant
+    settleDelay(ZDELAY);        // Delay until level is constant
     measureZ(nFreq);      // result is Z[nFreq]
     serialPrintZ(nFreq);
     }
@@ -96,9 +97,10 @@ void doTSingle(bool out)
   DC1.amplitude(dacLevel);     // Turn on sine wave
   setUpNewFreq(nFreq);
   // Delay until level is constant
-  delay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
+  settleDelay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
   measureT();      // result is Tmeas
   T[nFreq] = Tmeas;
+  logT(nFreq);
   //serialPrintT(nFreq);  // rev 0.84 Temp put into LCD Print
   LCDPrintSingleT(nFreq);  
   }
@@ -121,7 +123,7 @@ void doTSweep(bool out)
   for (nFreq = 1; nFreq <= 13;  nFreq++) // Over all frequencies; nFreq is global freq index
     {
     setUpNewFreq(nFreq);
-    delay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
+    settleDelay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
     measureT();      // result is Tmeas
     T[nFreq] = Tmeas;
     }
@@ -134,6 +136,18 @@ void doTSweep(bool out)
 // No delays for settling. No print.  Complements measureT.
 // Results are global Z[iF], Y[iF], sLC[iF], pLC[iF] and Q[iF]
 void measureZ(uint16_t iF)
+  {
+  uint32_t tPerf = perfStart();
+
+  getFullDataPt();    // Gets amplitudes and phases
+  checkOverload();
+  computeZ(iF);
+  perfStop(PERF_MEASUREZ, tPerf);
+  }
+
+// computeZ()  -  The arithmetic part of measureZ().  From the global
+// amplitudeV, phaseV, amplitudeR and phaseR, find Z, Y, L or C and Q at iF.
+void computeZ(uint16_t iF)
   {
   Complex Yin(0.0f, 0.0f);
   Complex Z22(0.0f, 0.0f);
@@ -146,8 +160,6 @@ void measureZ(uint16_t iF)
   float32_t w, ZM;
 
   w = 6.2831853f * FreqData[nFreq].freqHz;
-  getFullDataPt();    // Gets amplitudes and phases
-  checkOverload();
   // Do corrections for analog amplifier errors, vRatio and dPhase:
   Vm = polard2rect(amplitudeV * FreqData[nFreq].vRatio, phaseV + FreqData[nFreq].dPhase);
   Vr = polard2rect(amplitudeR, phaseR);
@@ -185,7 +197,7 @@ void measureZ(uint16_t iF)
   Ymeas = Cone / Zmeas;        // Include the correction back to Y
   // Indicate that a better refR may be available
   ZM = sqrt(Zmeas.real() * Zmeas.real() + Zmeas.imag() *Zmeas.imag());
-  if(avnaState != WHATSIT)
+  if(avnaState != WHATSIT && !lockInOn)      // No LCD time per LOCKIN output
      {
      if(uSave.lastState.iRefR == R50  &&  ZM > 500.0)
         LCDPrintError("Consider using refR=5K");
@@ -251,36 +263,12 @@ void measureZ(uint16_t iF)
 // adjusted for vRatio and dPhase.
 void measureT(void)
   {
-  float vGain, vPhase, vGainNorm, vPhaseNorm;
-  //Complex Vm(0.0, 0.0);
-  //Complex Vr(0.0, 0.0);
+  float vGainNorm, vPhaseNorm;
 
   getFullDataPt();
   checkOverload();
-  // .vRatio for transmission is the through cal voltage magnitude.
-  // .dPhase for transmission is the through cal voltage phase.
-  vGain = (amplitudeV / amplitudeR) * FreqData[nFreq].vRatio;
-  vPhase = phaseV - phaseR + FreqData[nFreq].dPhase;
-  // Now normalize these gains to the through path gain from CAL.
-  vGainNorm = vGain / FreqData[nFreq].thruRefAmpl;
-  vPhaseNorm = vPhase - FreqData[nFreq].thruRefPhase;
-
-if( verboseData && useUSB && !doingNano )    // rev 0.87
-  {
-  Serial.print("nFreq="); Serial.print(nFreq);  
-  Serial.print("  amplitudeV="); Serial.print(amplitudeV, 6);
-  Serial.print("  amplitudeR="); Serial.print(amplitudeR, 6);// <<<< PROBLEM
-  Serial.print("  vRatio="); Serial.print(FreqData[nFreq].vRatio, 6);
-  Serial.print("  thruRefAmpl="); Serial.print(FreqData[nFreq].thruRefAmpl  , 6);  
-  Serial.print("  vGain="); Serial.print(vGain, 6);
-  Serial.print("  vGainNorm="); Serial.println(vGainNorm, 6);
-  }
-  if (vPhaseNorm < (-180.0))
-     vPhaseNorm += 360.0;
-  else if (vPhaseNorm > 180.0)
-     vPhaseNorm -= 360.0;
-  Tmeas = polard2rect(vGainNorm, vPhaseNorm);
-  if ((instrument = AVNA) && !doingNano)
+  computeT(&vGainNorm, &vPhaseNorm);
+  if ((instrument == AVNA) && !doingNano && !streamSweep && !adaptSweep)
      {
      Serial.print(FreqData[nFreq].freqHz, 3);
      if(uSave.lastState.tsData == 0)   // Print dB and phase
@@ -294,7 +282,7 @@ if( verboseData && useUSB && !doingNano )    // rev 0.87
            Serial.print(" dB  Phase (deg) = ");
         else
            Serial.print(",");
-        Serial.println(vPhaseNorm, 3);
+        Serial.print(vPhaseNorm, 3);
         }
      else     // Serial print ratio of voltages
         {
@@ -307,11 +295,50 @@ if( verboseData && useUSB && !doingNano )    // rev 0.87
            Serial.print(" V/V  Phase (deg)= ");
         else
            Serial.print(",");
-        Serial.println(vPhaseNorm, 3);
+        Serial.print(vPhaseNorm, 3);
         }
+     if (measureHarmonics)
+        printHarmonics();
+     Serial.println("");
+     if (bgSpectrumOn)
+        printBgSpectrum(Serial, FreqData[nFreq].freqHz);
      }   // End if nanoState==DATA_NANO
   }
 
+// computeT()  -  The arithmetic part of measureT().  From the global
+// amplitudeV, phaseV, amplitudeR and phaseR find Tmeas, and the normalized
+// gain (V/V) and phase (deg) to *pGain and *pPhase.
+void computeT(float *pGain, float *pPhase)
+  {
+  float vGain, vPhase, vGainNorm, vPhaseNorm;
+
+  // .vRatio for transmission is the through cal voltage magnitude.
+  // .dPhase for transmission is the through cal voltage phase.
+  vGain = (amplitudeV / amplitudeR) * FreqData[nFreq].vRatio;
+  vPhase = phaseV - phaseR + FreqData[nFreq].dPhase;
+  // Now normalize these gains to the through path gain from CAL.
+  vGainNorm = vGain / FreqData[nFreq].thruRefAmpl;
+  vPhaseNorm = vPhase - FreqData[nFreq].thruRefPhase;
+
+if( verboseData && useUSB && !doingNano )    // rev 0.87
+  {
+  Serial.print("nFreq="); Serial.print(nFreq);  
+  Serial.print("  amplitudeV="); Serial.print(amplitudeV, 6);
+  Serial.print("  amplitudeR="); Serial.print(amplitudeR, 6);// <<<< PROBLEM
+  Serial.print("  vRatio="); Serial.print(FreqData[nFreq].vRatio, 6);
+  Serial.print("  thruRefAmpl="); Serial.print(FreqData[nFreq].thruRefAmpl  , 6);  
+  Serial.print("  vGain="); Serial.print(vGain, 6);
+  Serial.print("  vGainNorm="); Serial.println(vGainNorm, 6);
+  }
+  if (vPhaseNorm < (-180.0))
+     vPhaseNorm += 360.0;
+  else if (vPhaseNorm > 180.0)
+     vPhaseNorm -= 360.0;
+  Tmeas = polard2rect(vGainNorm, vPhaseNorm);
+  *pGain = vGainNorm;
+  *pPhase = vPhaseNorm;
+  }
+
   /* getFullDataPt()  -  Measure average amplitude and phase (rel to DSP generated
    wave).  This function does not return until printReady istrue, meaning that the
    measurement is complete.  The frequency and ZorT must be set before calling here.
@@ -339,29 +366,36 @@ boolean getFullDataPt(void)
 //      superAveNN[1] -= correctIsolationQ[  freq  ];
 //      }
 // That will do fine if the DUT is "matched".  Real Isolation with better 3125's is the answer, though.
-       amplitudeV = sqrtf( (float32_t) (superAveNN[1] * superAveNN[1] + superAveNN[0] * superAveNN[0]) );
-       amplitudeR = sqrtf( (float32_t) (superAveNN[3] * superAveNN[3] + superAveNN[2] * superAveNN[2]) );
+    phasorsFromAverages();
+    for (kk = 0; kk < 4; kk++)
+      NNReady[kk] = false;   // Only print these once
+    printReady = true;
+    return true;
+    }
+  return false;
+  }
+
+// phasorsFromAverages()  -  superAveNN[] to amplitudeV, phaseV, amplitudeR
+// and phaseR.  Used by getFullDataPt() and by the LOCKIN stream.
+void phasorsFromAverages(void)
+  {
+  amplitudeV = sqrtf( (float32_t) (superAveNN[1] * superAveNN[1] + superAveNN[0] * superAveNN[0]) );
+  amplitudeR = sqrtf( (float32_t) (superAveNN[3] * superAveNN[3] + superAveNN[2] * superAveNN[2]) );
 
 if(DIAGNOSTICS) {    
     Serial.print("superAveNN[3]="); Serial.print(superAveNN[3], 6);
     Serial.print("superAveNN[2]="); Serial.println(superAveNN[2], 6);
     }
     
-    // Minus signs reflect the hookup of the inputs to U1A and U1D:
-    phaseV = r2df(atan2f(-(float32_t)superAveNN[0], -(float32_t)superAveNN[1]));
-    phaseR = r2df(atan2f( (float32_t)superAveNN[2],  (float32_t)superAveNN[3]));
-    // Diagnostic printout
-    if(DIAGNOSTICS)
-      {
-      Serial.print("V values: "); Serial.print(amplitudeV); Serial.print("  ang in deg = "); Serial.println(phaseV);
-      Serial.print("R values: "); Serial.print(amplitudeR); Serial.print("  ang in deg = "); Serial.println(phaseR);
-      }
-    for (kk = 0; kk < 4; kk++)
-      NNReady[kk] = false;   // Only print these once
-    printReady = true;
-    return true;
+  // Minus signs reflect the hookup of the inputs to U1A and U1D:
+  phaseV = r2df(atan2f(-(float32_t)superAveNN[0], -(float32_t)superAveNN[1]));
+  phaseR = r2df(atan2f( (float32_t)superAveNN[2],  (float32_t)superAveNN[3]));
+  // Diagnostic printout
+  if(DIAGNOSTICS)
+    {
+    Serial.print("V values: "); Serial.print(amplitudeV); Serial.print("  ang in deg = "); Serial.println(phaseV);
+    Serial.print("R values: "); Serial.print(amplitudeR); Serial.print("  ang in deg = "); Serial.println(phaseR);
     }
-  return false;
   }
 
 /* getNmeasQI(Nmeas, zDelay)
@@ -373,13 +407,25 @@ if(DIAGNOSTICS) {
 void getNmeasQI(void)
   {
   uint16_t hh, jj, kk;
+  uint32_t tHarm, tPerf;
+  int64_t sum64[4];          // Exact sums, to double once at the end
 
+  if (lockInOn)              // Measurements change the frequency
+     lockInStop();
+  AudioNoInterrupts();       // All start on the same block
   for (jj = 0; jj < 4; jj++)
      {
      queueNN[jj].begin();    // Start loading the queueNN[]
      queueNN[jj].clear();    //  Clear everything
-     sumNN[jj] = 0.0f;        // 4 places for results
+     sum64[jj] = 0;          // 4 places for results
      }
+  // Harmonics from the same samples, but contiguous, so whole cycles of f
+  if (measureHarmonics)
+     harmDet.start(FreqData[nFreq].freqHz, sampleRateExact,
+          (uint32_t)FreqData[nFreq].numTenths*(256*(uint32_t)num256blocks + numCycles));
+  if (bgSpectrumOn)
+     bgSpecStart();
+  AudioInterrupts();
    countMeasurements = 0;  // Total number of measurements, like up to 4411 for 0.1 sec.
    for (hh = 0; hh < FreqData[nFreq].numTenths; hh++)  // All tenth seconds    <<<<<
      {
@@ -387,59 +433,756 @@ void getNmeasQI(void)
      for (kk = 0; kk < num256blocks; kk++)
         {
         // Get data, after all queues are loaded
+        tPerf = perfStart();
         while ((queueNN[0].available() < 2) || (queueNN[1].available() < 2) ||
-               (queueNN[2].available() < 2) || (queueNN[3].available() < 2));   // Just wait
+               (queueNN[2].available() < 2) || (queueNN[3].available() < 2))   // Just wait
+           {
+           if (bgSpectrumOn)
+              bgSpecPoll();
+           audioService();
+           }
+        perfStop(PERF_MEAS_WAIT, tPerf);
         // All are available;  Go get 'em
+        tPerf = perfStart();
         countMeasurements += 256;
         for (jj = 0; jj < 4; jj++)
            {
-           superAveNN[jj] += (double)get2blockAve(jj, 256);  // Righht side is float
+           sum64[jj] = get2blockSum(jj, 256, sum64[jj]);
            }
+        perfStop(PERF_MEAS_WORK, tPerf);
         }            // End, over all full blocks
     // In general a partial block of less than 256 is still needed
+    tPerf = perfStart();
     while ((queueNN[0].available() < 2) || (queueNN[1].available() < 2) ||
-           (queueNN[2].available() < 2) || (queueNN[3].available() < 2));   // Just wait
+           (queueNN[2].available() < 2) || (queueNN[3].available() < 2))   // Just wait
+       {
+       if (bgSpectrumOn)
+          bgSpecPoll();
+       audioService();
+       }
+    perfStop(PERF_MEAS_WAIT, tPerf);
     // numCycles of them are available;  Go get 'em
+    tPerf = perfStart();
     countMeasurements += numCycles;
     for (jj = 0; jj < 4; jj++)
        {
-       superAveNN[jj] += (double)get2blockAve(jj, numCycles);
+       sum64[jj] = get2blockSum(jj, numCycles, sum64[jj]);
        }
+    perfStop(PERF_MEAS_WORK, tPerf);
      }      // End, over all tenth seconds
 
   // Divide by countMeasurements to get average
   for (jj = 0; jj < 4; jj++)
      {
      queueNN[jj].end();     //  Stop queues
-     superAveNN[jj] = superAveNN[jj] / ((double)countMeasurements);
+     superAveNN[jj] = (double)sum64[jj] / ((double)countMeasurements);
      NNReady[jj] = true;     // Mark as ready to use and print
      }
+  VVMSlideRestart = true;    // Any sliding VVM window lost its queues
+
+  if (measureHarmonics)
+     {
+     tHarm = millis();       // Normally done within a block or two
+     while (!harmDet.available() && (millis() - tHarm) < 20)
+        audioService();
+     harmDet.stop();
+     getHarmonics();
+     }
+  if (bgSpectrumOn)
+     bgSpecFinish();
   }
 
-/* get2blocks(uint16_t nn)  The basic measurements are averaged here.
-   nn is the meauremnt 0 to 3 (Q, I, RQ, RI).
-   The average, a float, is returned in sumNN[nn]
-   Summing 8-bits worth of 16-bit numbers, to a 23-bit float.  Should work
+/* Background spectrum stats.  bgSpecStart() marks the FFT bins that are
+   neither the fundamental, H2 to H5, nor DC, +/-3 bins for the Hann window.
+   Harmonics above fs/2 are folded back to where they alias.  bgSpecPoll()
+   reduces each new fft1024p frame to fundamental, largest spur and noise
+   sum.  bgSpecFinish() converts to dBc.  Called with audio interrupts off.
 */
-float32_t get2blockAve(uint16_t nn, uint16_t npts)
+void bgSpecStart(void)
   {
-  uint16_t ii;
+  float32_t binHz, fh;
+  int16_t kc;
 
-  // Fetch 2 blocks from nn'th of 4 queues and copy
-  // into a 512 byte (256 16-bit word) buffer.
-  // The return is the sum of up to 256 and is left in global float sumNN[nn]
-  // memcpy() works on bytes, bufferNN[] works on 16-bit words
-  memcpy(&bufferNN[nn][0], queueNN[nn].readBuffer(), 256);
-  queueNN[nn].freeBuffer();
-  memcpy(&bufferNN[nn][128], queueNN[nn].readBuffer(), 256);
-  queueNN[nn].freeBuffer();
-  sumNN[nn] = 0.0f;
-  // Add npts samples (16-bit numbers) to sumNN[nn]
-  for (ii = 0; ii < npts; ii++)
+  binHz = sampleRateExact/1024.0f;
+  for (uint16_t ii = 0; ii < 512; ii++)
+     bgSpecMask[ii] = (ii > 2) ? 1 : 0;
+  for (uint16_t k = 1; k <= HARM_MAX; k++)
+     {
+     fh = fmodf((float32_t)k*FreqData[nFreq].freqHz, sampleRateExact);
+     if (fh > 0.5f*sampleRateExact)
+        fh = sampleRateExact - fh;
+     kc = (int16_t)(fh/binHz + 0.5f);
+     for (int16_t ii = kc - 3; ii <= kc + 3; ii++)
+        if (ii >= 0 && ii < 512)
+           bgSpecMask[ii] = 0;
+     }
+  bgSpecPwr1 = 0.0f;  bgSpecSpurMax = 0.0f;  bgSpecNoiseSum = 0.0f;
+  bgSpecSpurBin = 0;  bgSpecFrames = 0;
+  fft1024p.available();      // Drop any frame from before the start
+  fft1024p.readPeak();
+  }
+
+void bgSpecPoll(void)
+  {
+  float32_t p, p1, spur, noise;
+  uint16_t kc, nNoise, spurBin;
+
+  if (!fft1024p.available())
+     return;
+  kc = (uint16_t)(FreqData[nFreq].freqHz*1024.0f/sampleRateExact + 0.5f);
+  p1 = 0.0f;  spur = 0.0f;  noise = 0.0f;
+  nNoise = 0;  spurBin = 0;
+  for (uint16_t ii = 0; ii < 512; ii++)
+     {
+     p = fft1024p.read(ii);
+     if (ii + 1 >= kc && ii <= kc + 1)
+        p1 += p;
+     if (bgSpecMask[ii])
+        {
+        noise += p;
+        nNoise++;
+        if (p > spur)
+           {
+           spur = p;
+           spurBin = ii;
+           }
+        }
+     }
+  if (p1 <= 0.0f || nNoise == 0)
+     return;
+  // Ratios, as the fundamental can vary over the frames
+  if (spur/p1 > bgSpecSpurMax)
+     {
+     bgSpecSpurMax = spur/p1;
+     bgSpecSpurBin = spurBin;
+     }
+  bgSpecNoiseSum += noise/((float32_t)nNoise*p1);
+  bgSpecFrames++;
+  }
+
+void bgSpecFinish(void)
+  {
+  bgPeakPct = 100.0f*(float32_t)fft1024p.readPeak()/32768.0f;
+  if (bgSpecFrames == 0)
+     {
+     bgSpurDBc = -200.0f;  bgSpurHz = 0.0f;  bgNoiseDBc = -200.0f;
+     return;
+     }
+  bgSpurDBc = (bgSpecSpurMax > 1.0E-20f) ? 10.0f*log10f(bgSpecSpurMax) : -200.0f;
+  bgSpurHz = (float32_t)bgSpecSpurBin*sampleRateExact/1024.0f;
+  bgSpecNoiseSum /= (float32_t)bgSpecFrames;
+  bgNoiseDBc = (bgSpecNoiseSum > 1.0E-20f) ? 10.0f*log10f(bgSpecNoiseSum) : -200.0f;
+  }
+
+/* findResonance(f1, f2, type, nGrid)  -  Resonance search with a handful of
+   measurements.  Phase of Z is measured on a log grid of nGrid points, 0.1
+   sec each.  A pair of neighbors where the phase changes sign brackets the
+   resonance (the largest change if type is 0).  The Illinois form of the
+   secant method on phase vs. log f then closes in, usually in 4 to 6 steps.
+   With no sign change, the grid |Z| extremum is refined by golden section.
+   Two points either side of f0 give Q from the phase of an R-L-C,
+   tan(phase) = Q(f/f0 - f0/f), and a final 0.5 sec measurement gives R.
+   Results in resType, resF0, resQ, resR0 and resCount.
+*/
+void findResonance(float32_t f1, float32_t f2, uint16_t type, uint16_t nGrid)
+  {
+  float32_t lf[41], ph[41], mg[41];
+  float32_t xa, xb, pa, pb, x, px, xc, xd, mc, md, d, q, qSum, sgn;
+  float32_t f, phase0;
+  uint16_t ii, iBest, nQ, saveZT, savenFreq;
+  int16_t iExt;
+  Complex Zx(0.0, 0.0);
+
+  saveZT = uSave.lastState.ZorT;
+  savenFreq = nFreq;
+  nFreq = 0;                  // computeZ() uses FreqData[nFreq]
+  uSave.lastState.ZorT = IMPEDANCE;
+  setSwitch(IMPEDANCE_38);
+  DC1.amplitude(dacLevel);
+  resType = 0;  resCount = 0;
+
+  for (ii=0; ii<nGrid; ii++)
+     {
+     f = f1*powf(f2/f1, (float32_t)ii/(float32_t)(nGrid - 1));
+     Zx = measureZAt(f, 1, &lf[ii]);
+     ph[ii] = (float32_t)Zx.phase();
+     mg[ii] = (float32_t)Zx.modulus();
+     }
+
+  // Look for the phase zero crossing
+  iBest = nGrid;
+  d = 0.0f;
+  for (ii=0; ii<nGrid-1; ii++)
+     {
+     if (ph[ii]*ph[ii+1] > 0.0f)
+        continue;
+     if (type==RES_SERIES && ph[ii+1] < ph[ii])
+        continue;
+     if (type==RES_PARALLEL && ph[ii+1] > ph[ii])
+        continue;
+     if (fabsf(ph[ii+1] - ph[ii]) > d)
+        {
+        d = fabsf(ph[ii+1] - ph[ii]);
+        iBest = ii;
+        }
+     }
+
+  if (iBest < nGrid)       // Secant on phase, x is ln(f)
      {
-     sumNN[nn] += (float32_t)bufferNN[nn][ii];
+     resType = (ph[iBest+1] > ph[iBest]) ? RES_SERIES : RES_PARALLEL;
+     xa = logf(lf[iBest]);    pa = ph[iBest];
+     xb = logf(lf[iBest+1]);  pb = ph[iBest+1];
+     x = xa;  px = pa;
+     for (ii=0; ii<RES_MAX_ITER && pa != pb; ii++)
+        {
+        x = xb - pb*(xb - xa)/(pb - pa);
+        d = 0.05f*fabsf(xb - xa);    // Stay away from the ends
+        if (x < fminf(xa, xb) + d)  x = fminf(xa, xb) + d;
+        if (x > fmaxf(xa, xb) - d)  x = fmaxf(xa, xb) - d;
+        Zx = measureZAt(expf(x), 1, &f);
+        x = logf(f);
+        px = (float32_t)Zx.phase();
+        if (fabsf(px) < 0.0005f || fabsf(xb - xa) < 2.0E-6f)   // 0.03 deg, 2 ppm
+           break;
+        if (px*pb < 0.0f)
+           {
+           xa = xb;  pa = pb;
+           }
+        else
+           pa *= 0.5f;      // Illinois, keeps the old end from sticking
+        xb = x;  pb = px;
+        }
+     if (fabsf(px) >= 0.0005f && pa != pb)   // Last interpolation
+        x = xb - pb*(xb - xa)/(pb - pa);
+     resF0 = expf(x);
      }
-  return sumNN[nn];
+  else                     // Golden section on |Z|
+     {
+     iExt = -1;
+     for (ii=1; ii<nGrid-1; ii++)
+        {
+        if ((type!=RES_PARALLEL && mg[ii]<mg[ii-1] && mg[ii]<=mg[ii+1]) ||
+            (type!=RES_SERIES && mg[ii]>mg[ii-1] && mg[ii]>=mg[ii+1]))
+           {
+           iExt = ii;
+           break;
+           }
+        }
+     if (iExt < 0)
+        {
+        nFreq = savenFreq;
+        uSave.lastState.ZorT = saveZT;
+        return;                 // resType is 0
+        }
+     resType = (mg[iExt] < mg[iExt-1]) ? RES_SERIES : RES_PARALLEL;
+     sgn = (resType == RES_SERIES) ? 1.0f : -1.0f;   // Minimize sgn*|Z|
+     xa = logf(lf[iExt-1]);
+     xb = logf(lf[iExt+1]);
+     xc = xb - 0.618034f*(xb - xa);
+     xd = xa + 0.618034f*(xb - xa);
+     mc = sgn*(float32_t)measureZAt(expf(xc), 1, &f).modulus();
+     md = sgn*(float32_t)measureZAt(expf(xd), 1, &f).modulus();
+     for (ii=0; ii<RES_MAX_ITER-2 && (xb - xa) > 2.0E-5f; ii++)
+        {
+        if (mc < md)
+           {
+           xb = xd;  xd = xc;  md = mc;
+           xc = xb - 0.618034f*(xb - xa);
+           mc = sgn*(float32_t)measureZAt(expf(xc), 1, &f).modulus();
+           }
+        else
+           {
+           xa = xc;  xc = xd;  mc = md;
+           xd = xa + 0.618034f*(xb - xa);
+           md = sgn*(float32_t)measureZAt(expf(xd), 1, &f).modulus();
+           }
+        }
+     resF0 = expf(0.5f*(xa + xb));
+     }
+
+  // R, and the phase at f0 (not 0 for the |Z| extremum)
+  Zx = measureZAt(resF0, 5, &resF0);
+  resR0 = (float32_t)Zx.real();
+  phase0 = (float32_t)Zx.phase();
+
+  // Q from the phase either side.  Start with 1% off, then 0.25/Q.
+  d = 0.01f;
+  resQ = 0.0f;
+  for (uint16_t pass=0; pass<2; pass++)
+     {
+     qSum = 0.0f;  nQ = 0;
+     for (sgn=-1.0f; sgn<2.0f; sgn+=2.0f)
+        {
+        Zx = measureZAt(resF0*(1.0f + sgn*d), 1, &f);
+        x = fabsf(f/resF0 - resF0/f);
+        q = fabsf(tanf((float32_t)Zx.phase() - phase0));
+        if (x > 0.0f)
+           {
+           qSum += q/x;
+           nQ++;
+           }
+        }
+     if (nQ > 0)
+        resQ = qSum/(float32_t)nQ;
+     if (resQ <= 0.0f || d <= 0.25f/resQ)
+        break;                  // Close enough already, phase is near linear
+     d = fmaxf(0.25f/resQ, 1.0E-5f);
+     }
+  nFreq = savenFreq;
+  uSave.lastState.ZorT = saveZT;
+  }
+
+// Z at a frequency near f for the resonance search, tenths of 0.1 sec.
+// *fActual gets the frequency used, see modifyFreq()
+Complex measureZAt(float32_t f, uint16_t tenths, float32_t *fActual)
+  {
+  FreqData[0].freqHz = f;
+  prepMeasure(f);
+  FreqData[0].numTenths = tenths;
+  setUpNewFreq(0);
+  settleDelay(ZDELAY);
+  measureZ(0);
+  resCount++;
+  *fActual = FreqData[0].freqHzActual;
+  return Z[0];
+  }
+
+void printResonance(void)
+  {
+  float32_t w0 = 6.2831853f*resF0;
+
+  if (resType == 0)
+     {
+     Serial.println("No resonance found");
+     return;
+     }
+  if (annotate)
+     {
+     Serial.print(resType==RES_SERIES ? "Series" : "Parallel");
+     Serial.print(" resonance f0="); Serial.print(resF0, 3);
+     Serial.print(" Hz  Q="); Serial.print(resQ, 2);
+     Serial.print("  R="); Serial.print(resR0, 3);
+     Serial.print("  (");  Serial.print(resCount);
+     Serial.println(" measurements)");
+     if (resQ > 0.0f && resR0 > 0.0f)
+        {
+        Serial.print("  Series RLC: L=");
+        Serial.print(valueString(resQ*resR0/w0, lUnits));
+        Serial.print(" C=");
+        Serial.println(valueString(1.0f/(w0*resQ*resR0), cUnits));
+        Serial.print("  Parallel RLC: L=");
+        Serial.print(valueString(resR0/(w0*resQ), lUnits));
+        Serial.print(" C=");
+        Serial.println(valueString(resQ/(w0*resR0), cUnits));
+        }
+     return;
+     }
+  Serial.print(resType);                  Serial.print(",");
+  Serial.print(resF0, 3);                 Serial.print(",");
+  Serial.print(resQ, 2);                  Serial.print(",");
+  Serial.print(resR0, 3);                 Serial.print(",");
+  if (resQ > 0.0f && resR0 > 0.0f)
+     {
+     Serial.print(resQ*resR0/w0, 9);         Serial.print(",");
+     Serial.print(1.0f/(w0*resQ*resR0), 12); Serial.print(",");
+     Serial.print(resR0/(w0*resQ), 9);       Serial.print(",");
+     Serial.print(resQ/(w0*resR0), 12);      Serial.print(",");
+     }
+  else                                    // No R-L-C, keep the columns
+     Serial.print("0,0,0,0,");
+  Serial.println(resCount);
+  }
+
+/* fitData(model, src)  -  Equivalent circuit fit, result in fitLast.
+   src 0 uses Z[1] to Z[13] from the 13 frequency sweep, src 1 converts
+   S11 from the nanoVNA data arrays back to Z.  model FIT_N_MODELS picks
+   the best, see fitBest().
+*/
+bool fitData(uint16_t model, uint16_t src)
+  {
+  uint16_t n, ii;
+  float *fp;
+
+  if (src == 0)
+     {
+     for (ii = 1; ii <= 13; ii++)
+        {
+        fitF[ii-1] = FreqData[ii].freqHz;
+        fitRe[ii-1] = (float)Z[ii].real();
+        fitIm[ii-1] = (float)Z[ii].imag();
+        }
+     n = 13;
+     fp = fitF;
+     }
+  else
+     {
+     Complex Zo(uSave.lastState.valueRRef[uSave.lastState.iRefR], 0.0);
+     for (ii = 0; ii < totalDataPoints; ii++)
+        {
+        Complex g(dataReReflec[ii], dataImReflec[ii]);
+        Complex zz = Zo*(Cone + g)/(Cone - g);
+        fitRe[ii] = (float)zz.real();
+        fitIm[ii] = (float)zz.imag();
+        }
+     n = totalDataPoints;
+     fp = dataFreq;
+     }
+  if (model >= FIT_N_MODELS)
+     return fitBest(fp, fitRe, fitIm, n, &fitLast);
+  return fitZ(model, fp, fitRe, fitIm, n, &fitLast);
+  }
+
+// Resonance of the fitLast circuit, and its Q.  Speaker is fs and Qts.
+void fitResonance(float *f0, float *q)
+  {
+  float *p = fitLast.p;
+  float w0, qm, qe;
+
+  if (fitLast.model == FIT_SPEAKER)
+     {
+     w0 = 1.0f/sqrtf(p[3]*p[4]);
+     qm = w0*p[2]*p[4];
+     qe = w0*p[0]*p[4];
+     *q = qm*qe/(qm + qe);
+     }
+  else
+     {
+     w0 = 1.0f/sqrtf(p[1]*p[2]);
+     if (fitLast.model == FIT_PARALLEL_RLC)
+        *q = p[0]/(w0*p[1]);
+     else
+        *q = w0*p[1]/p[0];
+     }
+  *f0 = w0/6.2831853f;
+  }
+
+// Serial output of fitLast, annotated or CSV
+void printFit(void)
+  {
+  float f0, q;
+  uint16_t k;
+  char *pName;
+
+  fitResonance(&f0, &q);
+  if (!annotate)
+     {
+     Serial.print("FIT,");  Serial.print(fitLast.model);
+     for (k = 0; k < fitLast.nParams; k++)
+        {
+        Serial.print(",");
+        Serial.print(fitLast.p[k], 12);
+        }
+     Serial.print(",");  Serial.print(f0, 3);
+     Serial.print(",");  Serial.print(q, 3);
+     Serial.print(",");  Serial.println(fitLast.rmsPct, 3);
+     return;
+     }
+  Serial.print("Fit ");  Serial.print(fitModelName(fitLast.model));  Serial.print(":");
+  for (k = 0; k < fitLast.nParams; k++)
+     {
+     pName = (char*)fitParamName(fitLast.model, k);
+     Serial.print(" ");  Serial.print(pName);  Serial.print("=");
+     if (pName[0] == 'R')
+        Serial.print(valueString(fitLast.p[k], rUnits));
+     else if (pName[0] == 'L')
+        Serial.print(valueString(fitLast.p[k], lUnits));
+     else
+        Serial.print(valueString(fitLast.p[k], cUnits));
+     }
+  Serial.println("");
+  Serial.print("  f0="); Serial.print(f0, 3);
+  Serial.print(fitLast.model==FIT_SPEAKER ? " Hz  Qts=" : " Hz  Q=");
+  Serial.print(q, 3);
+  if (fitLast.model == FIT_CRYSTAL)
+     {
+     Serial.print("  fp=");
+     Serial.print(f0*sqrtf(1.0f + fitLast.p[2]/fitLast.p[3]), 3);
+     }
+  Serial.print("  rms error "); Serial.print(fitLast.rmsPct, 3);
+  Serial.print("%, "); Serial.print(fitLast.nPoints);
+  Serial.print(" points, "); Serial.print(fitLast.iterations);
+  Serial.println(" iterations");
+  }
+
+// ==========================  LOCKIN STREAM  ==========================
+
+/* lockInStart(f, rate)  -  Set up the measurement at f Hz, Z or T as
+   uSave.lastState.ZorT, and start the lockIn object at about rate outputs
+   per second.  lockInDrain() sends them from loop().  The rate is
+   sampleRateExact/lockInR, exactly, so the time stamps have no drift
+   relative to the sample clock.
+*/
+void lockInStart(float32_t f, float32_t rate)
+  {
+  float32_t r;
+
+  doRun = RUNNOT;                // Nothing else may change the frequency
+  FreqData[0].freqHz = f;
+  prepMeasure(f);
+  nFreq = 0;
+  setUpNewFreq(0);
+  setRefR(uSave.lastState.iRefR);
+  if (uSave.lastState.ZorT == IMPEDANCE)
+     setSwitch(IMPEDANCE_38);
+  else
+     setSwitch(TRANSMISSION_37);
+  DC1.amplitude(dacLevel);
+  settleDelay(ZDELAY);
+  r = floorf(0.5f + sampleRateExact/rate);
+  if (r < 2.0f)
+     r = 2.0f;
+  else if (r > (float32_t)LOCKIN_R_MAX)
+     r = (float32_t)LOCKIN_R_MAX;
+  lockInR = (uint16_t)r;
+  lockInRate = sampleRateExact/r;
+  lockInLost = 0;
+  AudioNoInterrupts();
+  lockIn.begin(lockInR);
+  AudioInterrupts();
+  lockInOn = true;
+  if (annotate)
+     {
+     Serial.print("LOCKIN "); Serial.print(FreqData[0].freqHzActual, 3);
+     Serial.print(" Hz, "); Serial.print(lockInRate, 4);
+     Serial.print(" per sec,  t(s),");
+     if (uSave.lastState.ZorT == IMPEDANCE)
+        Serial.println(" R, X");
+     else if (uSave.lastState.tsData == 0)
+        Serial.println(" Gain dB, Phase deg");
+     else
+        Serial.println(" Av V/V, Phase deg");
+     }
+  }
+
+void lockInStop(void)
+  {
+  lockIn.end();
+  lockInOn = false;
+  Serial.print("LOCKIN end, lost ");
+  Serial.println(lockIn.lost());
+  }
+
+/* lockInDrain()  -  Called from loop() while lockInOn.  Each output of the
+   lockIn object goes through the same arithmetic as measureZ() or measureT()
+   and is sent as a line "LI,t,R,X" or "LI,t,gain,phase".  t in seconds is
+   exact, from the output number.  Gaps from a full ring are reported.
+*/
+void lockInDrain(void)
+  {
+  struct lockInSample ls;
+  char line[80];
+  char num[12];
+  uint64_t t4;
+  uint32_t frac;
+  float a, b;
+  uint16_t kk;
+
+  while (lockIn.read(&ls))
+     {
+     for (kk = 0; kk < 4; kk++)
+        superAveNN[kk] = (double)ls.v[kk];
+     phasorsFromAverages();
+     if (uSave.lastState.ZorT == IMPEDANCE)
+        {
+        computeZ(0);
+        a = Z[0].real();
+        b = Z[0].imag();
+        }
+     else
+        {
+        computeT(&a, &b);
+        if (uSave.lastState.tsData == 0)
+           a = 20.0f*log10f(a);
+        }
+     // Time of the end of the averaging, in units of 0.1 ms
+     t4 = (uint64_t)(0.5 + 10000.0*(double)(ls.n + 1)*(double)lockInR/(double)sampleRateExact);
+     FormatBuffer fb(Serial, line, sizeof(line));
+     fb.addStr("LI,");
+     ultoa((uint32_t)(t4/10000), num, 10);
+     fb.addStr(num);
+     fb.addChar('.');
+     frac = (uint32_t)(t4 % 10000);
+     for (uint32_t d = 1000; d > 0; d /= 10)
+        fb.addChar('0' + (frac/d) % 10);
+     fb.addChar(',');
+     fb.addFloat(a, 6);
+     fb.addChar(',');
+     fb.addFloat(b, (uSave.lastState.ZorT == IMPEDANCE) ? 6 : 3);
+     fb.addStr("\r\n");
+     fb.flush();
+     logLockIn(a, b, (float)t4*0.0001f);
+     }
+  if (lockIn.lost() != lockInLost)
+     {
+     lockInLost = lockIn.lost();
+     Serial.print("LOCKIN lost ");
+     Serial.println(lockInLost);
+     }
+  }
+
+// The SPEC line that follows a measurement
+void printBgSpectrum(Print &p, float32_t freq)
+  {
+  p.print("SPEC,");
+  p.print(freq, 3);
+  p.print(",");
+  p.print(bgSpurDBc, 2);
+  p.print(",");
+  p.print(bgSpurHz, 1);
+  p.print(",");
+  p.print(bgNoiseDBc, 2);
+  p.print(",");
+  p.print(bgPeakPct, 1);
+  p.print(",");
+  p.println(bgSpecFrames);
+  }
+
+/* getHarmonics()  -  harmDet results to harmonicDB[k], dB relative to the
+   fundamental.  -200 dB marks a harmonic above fs/2 or no data.
+*/
+void getHarmonics(void)
+  {
+  float32_t a1, ak;
+
+  a1 = harmDet.amplitude(1);
+  harmonicDB[0] = -200.0f;
+  harmonicDB[1] = 0.0f;
+  for (uint16_t k = 2; k <= HARM_MAX; k++)
+     {
+     ak = harmDet.amplitude(k);
+     if (!harmDet.available() || a1 <= 0.0f || ak <= 0.0f ||
+              (float32_t)k*FreqData[nFreq].freqHz >= 0.5f*sampleRateExact)
+        harmonicDB[k] = -200.0f;
+     else
+        harmonicDB[k] = 20.0f*log10f(ak/a1);
+     }
+  }
+
+// Appends H2 to H5 to a line of T data
+void printHarmonics(void)
+  {
+  if (annotate)
+     Serial.print("  H2-H5 (dBc) = ");
+  for (uint16_t k = 2; k <= HARM_MAX; k++)
+     {
+     if (!annotate || k > 2)
+        Serial.print(",");
+     if (harmonicDB[k] <= -199.0f)
+        Serial.print("---");
+     else
+        Serial.print(harmonicDB[k], 2);
+     }
+  }
+
+/* settleDelay(maxMs)  -  Replaces the fixed delay after setUpNewFreq().
+   With settleMode==SETTLE_FIXED this is a wait of maxMs.  Otherwise the I/Q
+   of both channels are summed over chunks that are a whole number of
+   periods of f, so the 2f mixer product cancels.  Chunk ends are split
+   fractionally between samples.  The first SETTLE_SKIP_BLOCKS blocks are
+   dropped, as they started before the new frequency got through the codec.
+   Returns when V and R each change by less than settleTolerance between
+   two chunks, or after maxMs, the old fixed delay, whichever is first.
+   Every point is timed, in settleCount[] and settleSumUs[] by mode, for
+   the SETTLE command.
+*/
+void settleDelay(uint32_t maxMs)
+  {
+  uint32_t t0, nBlocks;
+  uint16_t ii, jj, nChunks;
+  int16_t *pd[4];
+  float32_t spp, chunkLen, pos, frac, x;
+  float32_t acc[4], last[4], dV, dR, mV, mR;
+  bool settled = false;
+
+  if(settleMode == SETTLE_FIXED || FreqData[nFreq].freqHzActual <= 0.0f)
+    {
+    t0 = micros();
+    while ((micros() - t0) < 1000UL*maxMs)
+       audioService();
+    settleCount[SETTLE_FIXED]++;
+    settleSumUs[SETTLE_FIXED] += micros() - t0;
+    return;
+    }
+  t0 = micros();
+  spp = sampleRateExact/FreqData[nFreq].freqHzActual;   // Samples per period
+  chunkLen = spp*ceilf(128.0f/spp);                       // At least one block
+  for (jj = 0; jj < 4; jj++)
+     {
+     queueNN[jj].begin();
+     queueNN[jj].clear();
+     acc[jj] = 0.0f;
+     last[jj] = 0.0f;
+     }
+  nBlocks = 0;  nChunks = 0;  pos = 0.0f;
+  while (!settled && (micros() - t0) < 1000UL*maxMs)
+     {
+     if ((queueNN[0].available() < 1) || (queueNN[1].available() < 1) ||
+         (queueNN[2].available() < 1) || (queueNN[3].available() < 1))
+        {
+        audioService();
+        continue;
+        }
+     for (jj = 0; jj < 4; jj++)
+        pd[jj] = queueNN[jj].readBuffer();
+     if (++nBlocks > SETTLE_SKIP_BLOCKS)
+        {
+        for (ii = 0; ii < 128 && !settled; ii++)
+           {
+           if (pos + 1.0f <= chunkLen)
+              {
+              for (jj = 0; jj < 4; jj++)
+                 acc[jj] += (float32_t)pd[jj][ii];
+              pos += 1.0f;
+              continue;
+              }
+           // Chunk ends inside this sample
+           frac = chunkLen - pos;
+           for (jj = 0; jj < 4; jj++)
+              acc[jj] += frac*(float32_t)pd[jj][ii];
+           // V is NN 0 and 1, R is NN 2 and 3
+           mV = sqrtf(acc[0]*acc[0] + acc[1]*acc[1]);
+           mR = sqrtf(acc[2]*acc[2] + acc[3]*acc[3]);
+           dV = sqrtf((acc[0]-last[0])*(acc[0]-last[0]) + (acc[1]-last[1])*(acc[1]-last[1]));
+           dR = sqrtf((acc[2]-last[2])*(acc[2]-last[2]) + (acc[3]-last[3])*(acc[3]-last[3]));
+           if (nChunks > 0 && dV <= settleTolerance*mV && dR <= settleTolerance*mR)
+              settled = true;
+           nChunks++;
+           for (jj = 0; jj < 4; jj++)
+              {
+              x = (float32_t)pd[jj][ii];
+              last[jj] = acc[jj];
+              acc[jj] = (1.0f - frac)*x;
+              }
+           pos = 1.0f - frac;
+           }
+        }
+     for (jj = 0; jj < 4; jj++)
+        queueNN[jj].freeBuffer();
+     }
+  for (jj = 0; jj < 4; jj++)
+     queueNN[jj].end();
+  settleCount[SETTLE_DETECT]++;
+  settleSumUs[SETTLE_DETECT] += micros() - t0;
+  settleFixedUs += 1000UL*maxMs;
+  if (!settled)
+     settleTimeouts++;
+  }
+
+/* get2blockSum(nn, npts, acc)  The basic measurements are summed here.
+   nn is the measurement 0 to 3 (Q, I, RQ, RI).  Two 128 sample blocks
+   are taken from the nn'th of 4 queues and the first npts samples are
+   added, right from the queue buffers, to the exact int64 acc.  Returns
+   the new acc.  See sumR2.h
+*/
+int64_t get2blockSum(uint16_t nn, uint16_t npts, int64_t acc)
+  {
+  uint16_t n1 = (npts < 128) ? npts : 128;
+
+  acc = sumInt16(queueNN[nn].readBuffer(), n1, acc);
+  queueNN[nn].freeBuffer();
+  acc = sumInt16(queueNN[nn].readBuffer(), npts - n1, acc);
+  queueNN[nn].freeBuffer();
+  return acc;
   }
 
 // Someday:  Provide a field in non-annotated output for warnings and errors  <<<<<<<
@@ -0,0 +1,256 @@
+//  AVNA8tf.ino
+// TFNOISE command, a one-shot transfer function measured with noise
+// excitation and the two channel FFT, for the AVNA audio vector analyzer.
+/*  RSL_VNA8 Arduino sketch for audio VNA measurements.
+ *  Copyright (c) 2016-2020 Robert Larkin  W7PUA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* The noise generator, noise1, replaces the AVNA sine source at the output
+ * and the switches are set as for a T measurement.  The reference channel
+ * is x and the measure channel is y of fft2, see src/analyze_fft2_p, so H1
+ * is the V/R ratio that measureT() starts from, but for all 512 bins at
+ * once.  After TF_SETTLE_MS for the DUT and the codec, tfNAve frames are
+ * averaged.  The result is sent and the AVNA source is put back.  It all
+ * runs from taskMeasure() by tfPoll(), so loop() is never held up.
+ *
+ * The through cal is per bin, in RAM, for one sample rate.  Without it the
+ * result is corrected as computeT() does: V inverted, as phaseV, then the
+ * CAL vRatio, dPhase and through reference, interpolated between the 13
+ * CAL frequencies.  With it, the result is H1 over the through H1, and
+ * those corrections cancel.
+ */
+
+/* TfNoiseCommand()  -  "TFNOISE n lvl sr c"  Transfer function of the DUT
+ * in the transmission fixture, noise excited, Welch averaged.
+ *    n   = frames to average, 1 to 4096 (default 64).  "TFNOISE 0" aborts.
+ *    lvl = noise standard deviation, fraction of full scale, 0.001 to 0.33
+ *          (default 0.1)
+ *    sr  = sample rate index as SPECTRUM, 0 to 4 (default 3, 48 kHz)
+ *    c   = 0  Measure (default), with the through cal if it is for this sr
+ *          1  Measure the through connection and keep it as the cal
+ *          2  Clear the through cal
+ * It takes about (n+1)*512/sampleRate, 0.7 sec for n=64 at 48 kHz.  Bin
+ * spacing is sampleRate/1024.  Output is a line per bin, 1 to 511,
+ *      TF,freq Hz,gain dB,phase deg,coherence
+ * and then "TF,END,n".  With BINARY 1 the lines are replaced by a BF_TF
+ * frame of 512 (re, im, coherence) float triples.
+ */
+void TfNoiseCommand(void)
+  {
+  char *arg;
+  int n = 64, sr = 3, c = 0;
+  float lvl = 0.1f;
+
+  arg = SCmd.next();
+  if (arg != NULL)
+    n = atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    lvl = atof(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    sr = atoi(arg);
+  arg = SCmd.next();
+  if (arg != NULL)
+    c = atoi(arg);
+
+  if (n == 0)
+    {
+    if (tfState != TF_IDLE)
+      {
+      tfStop();
+      workGive(WORK_TFNOISE);
+      Serial.println("TF,ABORT");
+      }
+    return;
+    }
+  if (n<1 || n>FFT2_MAX_AVE || lvl<0.001f || lvl>0.33f || sr<0 || sr>4 || c<0 || c>2)
+    {
+    Serial.println("Error: TFNOISE needs n 1 to 4096, lvl 0.001 to 0.33, sr 0 to 4, c 0 to 2");
+    return;
+    }
+  if (c == 2)
+    {
+    tfThruRateIndex = -1;
+    if (verboseData)  Serial.println("TFNOISE through cal cleared");
+    return;
+    }
+  if (essState != ESS_IDLE)
+    {
+    Serial.println("Error: ESS is running, \"ESS 0\" aborts it");
+    return;
+    }
+  if (instrument != AVNA)
+    {
+    Serial.println("Error: TFNOISE needs \"INSTRUMENT 0\" first");
+    return;
+    }
+  if (!workTake(WORK_TFNOISE))
+    return;
+  tfStart((uint16_t)n, lvl, (uint16_t)sr, c == 1);
+  }
+
+void tfStart(uint16_t nAve, float32_t lvl, uint16_t rateIndex, bool thru)
+  {
+  if (lockInOn)
+     lockInStop();
+  doRun = RUNNOT;                // Nothing else may use the output
+  tfNAve = nAve;
+  tfRateIndex = rateIndex;
+  tfThruMeas = thru;
+  setSample(freqASA[rateIndex].rateIndex);
+  setRefR(uSave.lastState.iRefR);
+  setSwitch(TRANSMISSION_37);
+  noise1.amplitude(lvl);
+  for (uint16_t ii = 0; ii < 3; ii++)
+     mixer1.gain(ii, 0.0f);
+  mixer1.gain(3, 1.0f);
+  mixer2.gain(0, 1.0f);          // Noise on
+  mixer2.gain(1, 0.0f);          // AVNA source off
+  tfTime0 = millis();
+  tfState = TF_SETTLE;
+  }
+
+// Back to the AVNA source, and noise1 and mixer1 as the sig gens had them
+void tfStop(void)
+  {
+  fft2.stop();
+  tfState = TF_IDLE;
+  noise1.amplitude(2.06f*uSave.lastState.sgCal*asg[3].amplitude);
+  for (uint16_t ii = 0; ii < 4; ii++)
+     mixer1.gain(ii, asg[ii].ASGoutputOn ? 1.0f : 0.0f);
+  mixer2.gain(0, 0.0f);
+  mixer2.gain(1, 1.0f);
+  }
+
+// Called from taskMeasure() while tfState is not TF_IDLE
+void tfPoll(void)
+  {
+  if (tfState == TF_SETTLE)
+     {
+     if (millis() - tfTime0 < TF_SETTLE_MS)
+        return;
+     AudioNoInterrupts();
+     fft2.start(tfNAve, workArea);
+     AudioInterrupts();
+     tfState = TF_RUN;
+     }
+  else if (tfState == TF_RUN && fft2.available())
+     {
+     tfStop();
+     if (tfThruMeas)
+        {
+        for (uint16_t k = 0; k < 512; k++)
+           fft2.h1(k, &tfThruRe[k], &tfThruIm[k]);
+        tfThruRateIndex = tfRateIndex;
+        }
+     tfSend();
+     workGive(WORK_TFNOISE);
+     }
+  }
+
+// H1 of bin k, divided by the through cal when there is one for this rate,
+// or else with the CAL corrections of tfChannelCal()
+void tfResult(uint16_t k, float32_t *re, float32_t *im)
+  {
+  float32_t hr, hi, d, g, ph, c, s;
+
+  fft2.h1(k, &hr, &hi);
+  if (!tfThruMeas && tfThruRateIndex == (int16_t)tfRateIndex)
+     {
+     d = tfThruRe[k]*tfThruRe[k] + tfThruIm[k]*tfThruIm[k];
+     if (d > 0.0f)
+        {
+        *re = (hr*tfThruRe[k] + hi*tfThruIm[k])/d;
+        *im = (hi*tfThruRe[k] - hr*tfThruIm[k])/d;
+        return;
+        }
+     }
+  tfChannelCal(sampleRateExact*(float32_t)k/1024.0f, &g, &ph);
+  c = g*cosf(d2rf(ph));
+  s = g*sinf(d2rf(ph));
+  *re = -(hr*c - hi*s);          // V is inverted, see phaseV
+  *im = -(hr*s + hi*c);
+  }
+
+// Gain and phase (deg) corrections of computeT() at f Hz, vRatio/thruRefAmpl
+// and dPhase - thruRefPhase, linear between the CAL frequencies 1 to 13
+void tfChannelCal(float32_t f, float32_t *pGain, float32_t *pPhase)
+  {
+  uint16_t kk = 2;
+  float32_t a, g0, g1, p0, p1;
+
+  while (kk < 13 && f > FreqData[kk].freqHz)
+     kk++;
+  a = (f - FreqData[kk-1].freqHz)/(FreqData[kk].freqHz - FreqData[kk-1].freqHz);
+  if (a < 0.0f)  a = 0.0f;       // Held at the ends
+  if (a > 1.0f)  a = 1.0f;
+  g0 = FreqData[kk-1].vRatio/FreqData[kk-1].thruRefAmpl;
+  g1 = FreqData[kk].vRatio/FreqData[kk].thruRefAmpl;
+  p0 = FreqData[kk-1].dPhase - FreqData[kk-1].thruRefPhase;
+  p1 = FreqData[kk].dPhase - FreqData[kk].thruRefPhase;
+  *pGain = g0 + a*(g1 - g0);
+  *pPhase = p0 + a*(p1 - p0);
+  }
+
+void tfSend(void)
+  {
+  float32_t re, im, mag2, binHz;
+  float32_t v[3];
+  char line[80];
+
+  binHz = sampleRateExact/1024.0f;
+  if (binaryOut)
+     {
+     BinFrame bf(Serial);
+     bf.begin(BF_TF, 512, sizeof(v), 0.0f, binHz);
+     for (uint16_t k = 0; k < 512; k++)
+        {
+        tfResult(k, &v[0], &v[1]);
+        v[2] = fft2.coherence(k);
+        bf.add(v, sizeof(v));
+        }
+     bf.end();
+     }
+  else
+     {
+     FormatBuffer fb(Serial, line, sizeof(line));
+     if (annotate)
+        fb.addStr("TF, Hz, gain dB, phase deg, coherence\r\n");
+     for (uint16_t k = 1; k < 512; k++)
+        {
+        tfResult(k, &re, &im);
+        mag2 = re*re + im*im;
+        fb.addStr("TF,");
+        fb.addFloat(binHz*(float32_t)k, 2);
+        fb.addChar(',');
+        fb.addFloat(mag2 > 1.0E-20f ? 10.0f*log10f(mag2) : -200.0f, 3);
+        fb.addChar(',');
+        fb.addFloat(57.29578f*atan2f(im, re), 2);
+        fb.addChar(',');
+        fb.addFloat(fft2.coherence(k), 4);
+        fb.addStr("\r\n");
+        }
+     fb.flush();
+     }
+  Serial.print("TF,END,");
+  Serial.println(fft2.frames());
+  }
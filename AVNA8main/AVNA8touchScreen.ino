@@ -28,6 +28,8 @@ void tToInstrumentHome(void)
   tft.fillRect(0, 0, 320, 200, ILI9341_BLACK);
   topLine1();  topLine2();
   instrument = ALL_IDLE;
+  ASAZoomOff();              // Not needed outside of ASA
+  ASADualOff();
   mixer2.gain(0, 0.0);       // Turn off signal generatrs
   mixer2.gain(1, 0.0);       // Turn off AVNA source signal 
   avnaState = 0;
@@ -217,6 +219,7 @@ void tVInCal(void)
     // Now do a cal of the spectrum analyzer
     // Get started
     pwr10DB = -1000.0f;
+    fft1024p.setInterval(1);    // Not yet set by loop()
     pwr10=0.0f; doFFT(); delay(600);
     pwr10=0.0f; doFFT(); delay(600);
     countAve = 0;  // Global number of doFFT()
@@ -285,6 +288,7 @@ void tVOutCal(void)
   asg[0].amplitude = 0.14142136f;  //  0.05V RMS, a known value, well below overload
   asg[0].ASGoutputOn = true;
   asg[1].ASGoutputOn = false; asg[2].ASGoutputOn = false; asg[3].ASGoutputOn = false;
+  asg[4].ASGoutputOn = false;
   setSigGens();
 
   // For VVM the AVNA freq source is set to same freq as Sig Gen1
@@ -358,6 +362,8 @@ void tVOutCal(void)
 void tToAVNAHome(void)
   {
   instrument = AVNA;
+  ASAZoomOff();
+  ASADualOff();
   mixer2.gain(0, 0.0);   // Turn off signal generatrs
   mixer2.gain(1, 1.0);   // Turn on AVNA source signal
   topLines();
@@ -383,6 +389,7 @@ void tToASGHome(void)
   setSigGens();
 
   tft.fillRect(0, 0, tft.width(), 200, ILI9341_BLACK);
+  topLinesValid = false;
   tft.setTextColor(ILI9341_YELLOW);
   tft.setFont(Arial_12);
   tft.setCursor(0, 38);
@@ -446,8 +453,32 @@ void tToASGHome(void)
       tft.setCursor(255, 82 + 66);
       tft.print("GWN");
 
+    // Arb gen, a uSD stream has no frequency of its own
+    tft.setCursor(10, 82 + 88);
+    tft.print("5");
+    tft.setCursor(30, 82 + 88);
+    if(asg[4].type == ARB_STREAM)
+      tft.print("  -");
+    else
+      tft.print((uint16_t)asg[4].freq);
+    tft.setCursor(85, 82 + 88);
+    tft.print(asg[4].amplitude, 3);
+    tft.setCursor(135, 82 + 88);
+    tft.print("V p-p");
+    tft.setCursor(210, 82 + 88);
+    if(asg[4].ASGoutputOn)
+      tft.print("ON");
+    else
+      {
+      tft.setTextColor(ILI9341_PINK);
+      tft.print("OFF");
+      }
+    tft.setTextColor(ILI9341_YELLOW);
+    tft.setCursor(255, 82 + 88);
+    tft.print(asg[4].type == ARB_STREAM ? "uSD" : "Table");
+
   tft.setFont(Arial_9);
-  tft.setCursor(10, 170);
+  tft.setCursor(10, 190);
   tft.print("Voltages are with a 50-Ohm termination.");
 
   if(SDCardAvailable)
@@ -467,23 +498,41 @@ void tToASGn(void)
       case 1: asg[currentSigGen].ASGoutputOn = true;  break;
       case 2: asg[currentSigGen].ASGoutputOn = false;  break;
       case 3:
-        if(currentSigGen != 3)  // 3 is a noise gen
+        if(currentSigGen < 3)   // 3 is a noise gen, 4 the arb gen
           asg[currentSigGen].type = WAVEFORM_SINE;
         break;
       case 4:
-        if(currentSigGen != 3)
+        if(currentSigGen < 3)
           asg[currentSigGen].type = WAVEFORM_SQUARE;
         break;
+      case 5:                   // Next waveform, or arb table/uSD file
+        if(currentSigGen == 4)
+          asg[4].type = (asg[4].type == ARB_STREAM) ? WAVEFORM_ARBITRARY : ARB_STREAM;
+        else if(currentSigGen < 3)
+          {
+          switch (asg[currentSigGen].type)
+            {
+            case WAVEFORM_SINE:      asg[currentSigGen].type = WAVEFORM_SAWTOOTH; break;
+            case WAVEFORM_SAWTOOTH:  asg[currentSigGen].type = WAVEFORM_SQUARE; break;
+            case WAVEFORM_SQUARE:    asg[currentSigGen].type = WAVEFORM_TRIANGLE; break;
+            case WAVEFORM_TRIANGLE:  asg[currentSigGen].type = WAVEFORM_SAWTOOTH_REVERSE; break;
+            default:                 asg[currentSigGen].type = WAVEFORM_SINE; break;
+            }
+          }
+        break;
       }
     }
 
   // Redraw the SG modify screen
   tft.fillRect(0, 0, tft.width(), 200, ILI9341_BLACK);
+  topLinesValid = false;
   tft.setTextColor(ILI9341_YELLOW);
   tft.setFont(Arial_12);
   tft.setCursor(65, 5);
   if(currentSigGen==3)
     tft.print("     NOISE GENERATOR");
+  else if(currentSigGen==4)
+    tft.print("ARBITRARY GENERATOR");
   else
     {
     tft.print("SIGNAL GENERATOR");
@@ -566,9 +615,20 @@ void tToASGn(void)
     case WAVEFORM_TRIANGLE: tft.print("Triangle"); break;
     case WAVEFORM_SAWTOOTH_REVERSE: tft.print("Saw Rev"); break;
     case NOISE:  tft.print("GWN"); break;
+    case WAVEFORM_ARBITRARY: tft.print("Table"); break;
+    case ARB_STREAM: tft.print("uSD file"); break;
+    }
+  if(currentSigGen==4 && asg[4].type==ARB_STREAM)
+    {
+    tft.setFont(Arial_9);       // Between the freq and level boxes
+    tft.setCursor(75, 104);
+    tft.print("File ");
+    tft.print(arbStreamName);
+    tft.print(arbStreamLoop ? ", loop" : ", once");
     }
 
  if(currentSigGen==3) tft.fillRect(0, 25, tft.width(), 75, ILI9341_BLACK); // TEMP for no LPF
+ topLinesValid = false;
   checkSGoverload();
   setSigGens();
   }
@@ -576,7 +636,7 @@ void tToASGn(void)
 void checkSGoverload(void)
   {
   float32_t sumVolts = 0.0f;
-  for (int jj=0; jj<4; jj++)
+  for (int jj=0; jj<5; jj++)
     {
     if(asg[jj].ASGoutputOn)
       sumVolts += asg[jj].amplitude;
@@ -618,6 +678,31 @@ void setSigGens(void)
   // 2.06 seems close, but needs analysis!!
   noise1.amplitude(2.06f*uSave.lastState.sgCal*asg[3].amplitude);
   noise1.setLowPass(factorFreq*asg[3].freq);
+  setArbGen();
+  }
+
+// Sig gen 5.  The arb gen plays its table, or with type ARB_STREAM the
+// file arbStreamName, started when turned on and stopped when turned off.
+void setArbGen(void)
+  {
+  arbWave.frequency(asg[4].freq, sampleRateExact);
+  arbWave.amplitude(uSave.lastState.sgCal*asg[4].amplitude);
+  if (asg[4].ASGoutputOn && asg[4].type == ARB_STREAM)
+    {
+    if (!arbWave.streaming() &&
+        (!SDCardAvailable || !workTake(WORK_ARB) ||
+         !arbWave.openStream(arbStreamName, arbStreamLoop, workArea)))
+      {
+      asg[4].ASGoutputOn = false;
+      workGive(WORK_ARB);
+      }
+    }
+  else
+    {
+    arbWave.closeStream();
+    workGive(WORK_ARB);
+    }
+  mixer3.gain(1, asg[4].ASGoutputOn ? 1.0f : 0.0f);
   }
 
 void tToAVNA(void)
@@ -636,6 +721,8 @@ void tToAVNA(void)
 // Vector Voltmeter
 void tToVVM(void)
   {
+  ASAZoomOff();
+  ASADualOff();
 
   if(currentMenu==17)    // Coming from VVM modify
     {
@@ -652,6 +739,7 @@ void tToVVM(void)
   // VVM uses the VNA routines and oscillator
   setUpNewFreq(0);
 
+  VVMSlideRestart = true;   // New freq, new window
   // Resync the phase of the three sources
   AudioNoInterrupts();
   //waveform1.begin(WAVEFORM_SINE);
@@ -678,6 +766,7 @@ void tToVVM(void)
   mixer2.gain(0, 1.0f);   // Turn on 4x signal generatrs
   mixer2.gain(1, 0.0f);   // Turn off AVNA source signal
   tft.fillRect(0, 0, tft.width(), 200, ILI9341_BLACK);
+  topLinesValid = false;
   tft.setTextColor(ILI9341_YELLOW);
   tft.setFont(Arial_14);
   tft.setCursor(65, 3);
@@ -744,8 +833,15 @@ void tToVVM(void)
 
 void VVMMeasure(void)
   {
-  float32_t MT, PT, MTdB;
+  float32_t MT, PT, MTdB, pkPct = 0.0f;
 
+  if(VVMWindowMs > 0)
+    {
+    VVMSlideMeasure();
+    return;
+    }
+  if(VVMSumsRunning)
+    VVMSlideStop();
   getFullDataPt();
   checkOverload();
   MT = uSave.lastState.VVMCalConstant*(float32_t)amplitudeV; // V rms at terminals
@@ -775,7 +871,9 @@ void VVMMeasure(void)
     tft.print("ADC %p-p=");
     tft.setCursor(265, 100);
     tft.print(50.0f*pk, 1);
+    pkPct = 50.0f*pk;
     }
+  logVVM(MT, PT, pkPct, false);
 
   // TFT Print volts and phase
   tft.setFont(Arial_24);
@@ -792,6 +890,7 @@ void VVMMeasure(void)
   tft.setFont(Arial_9);
   tft.setCursor(270, 28);
   tft.print(countMeasurements);
+  topLinesValid = false;        // Over top line 2
 
   // The nRun and doRun for VVM only refer to sending data over serial
   // The on-screen VVM continues
@@ -803,6 +902,8 @@ void VVMMeasure(void)
       Serial.print(MTdB, 3);
     Serial.print(" ");
     Serial.println(PT, 2);
+    if(bgSpectrumOn)
+      printBgSpectrum(Serial, FreqData[nFreq].freqHz);
     if(nRun>0 && --nRun==0)
       {
       nRun = -1;
@@ -811,6 +912,229 @@ void VVMMeasure(void)
     }
   }
 
+/* Sliding window VVM.  lockIn, in its block sum mode, reduces each 128
+ * sample block of the four mixer outputs to its sum as the block goes by,
+ * so no audio blocks wait on loop().  A ring of the last VVMnWin block
+ * sums gives the I/Q averages over the window, updated with every block,
+ * so there is no dead time.  A reading is published VVMPublishHz times a
+ * second and only the characters that changed are redrawn.
+ */
+void VVMSlideMeasure(void)
+  {
+  static uint32_t tPublish = 0;
+  float32_t fn, Q, I, RQ, RI, MT, MTdB, PT, pkPct = 0.0f;
+  char strMag[16], strPh[16];
+
+  if(VVMSlideRestart)
+    {
+    VVMSlideRestart = false;
+    VVMnWin = VVMWindowBlocks();
+    if (lockInOn)                      // Shares lockIn with LOCKIN
+      lockInStop();
+    for(int jj=0; jj<4; jj++)
+      VVMRunSum[jj] = 0;
+    AudioNoInterrupts();
+    lockIn.beginBlockSums();
+    AudioInterrupts();
+    VVMSumsRunning = true;
+    VVMNextBlock = 0;
+    VVMiRing = 0;  VVMnFilled = 0;
+    VVMLastMag[0] = 0;  VVMLastPh[0] = 0;
+    tft.fillRect(0, 70, tft.width(), 45, ILI9341_BLACK);
+    tft.setTextColor(ILI9341_WHITE);
+    tft.setFont(Arial_8);
+    tft.setCursor(5, 100);
+    if (VVMFormat == VVM_VOLTS)
+      tft.print("   V RMS at fundamental freq");
+    else
+      tft.print("   Power at fundamental freq");
+    tft.setCursor(200,100);
+    tft.print("ADC %p-p=");
+    tft.fillRect(270, 28, 50, 15, ILI9341_BLACK);
+    tft.setFont(Arial_9);
+    tft.setCursor(270, 28);
+    tft.print(128*(uint32_t)VVMnWin);    // Samples in window
+    topLinesValid = false;
+    }
+
+  VVMDrain();
+  if(VVMnFilled < VVMnWin || (millis() - tPublish) < 1000UL/VVMPublishHz)
+    return;
+  tPublish = millis();
+
+  // Same as getFullDataPt(), but from the window sums
+  fn = 1.0f/(128.0f*(float32_t)VVMnWin);
+  Q  = fn*(float32_t)VVMRunSum[0];
+  I  = fn*(float32_t)VVMRunSum[1];
+  RQ = fn*(float32_t)VVMRunSum[2];
+  RI = fn*(float32_t)VVMRunSum[3];
+  amplitudeV = sqrtf(I*I + Q*Q);
+  amplitudeR = sqrtf(RI*RI + RQ*RQ);
+  phaseV = r2df(atan2f(-Q, -I));
+  phaseR = r2df(atan2f(RQ, RI));
+
+  MT = uSave.lastState.VVMCalConstant*(float32_t)amplitudeV; // V rms at terminals
+  MTdB = 13.01056f + 20.0f * log10f(MT);  // 50 Ohm, Vrms to dBm
+  PT = phaseOffset + (float32_t)phaseV;
+  if (PT>180.0f)
+    PT -= 360.0f;
+  else if (PT<-180.0f)
+    PT += 360.0f;
+
+  if (VVMFormat == VVM_VOLTS)
+    dtostrf(MT, 1, 6, strMag);
+  else
+    dtostrf(MTdB, 1, 2, strMag);
+  dtostrf(PT, 1, 2, strPh);
+  tft.setTextColor(ILI9341_WHITE);
+  VVMDrawChanged(strMag, VVMLastMag, 25, 160);
+  VVMDrain();                          // Keep audio blocks moving
+  VVMDrawChanged(strPh, VVMLastPh, 190, 130);
+
+  if (pkDet.available())
+    {
+    float32_t pk = pkDet.readPeakToPeak();
+    tft.fillRect(265, 100, 55, 10, ILI9341_BLACK);
+    tft.setTextColor(pk > 1.95 ? ILI9341_RED : ILI9341_WHITE);
+    tft.setFont(Arial_8);
+    tft.setCursor(265, 100);
+    tft.print(50.0f*pk, 1);
+    pkPct = 50.0f*pk;
+    }
+  logVVM(MT, PT, pkPct, true);
+
+  if(nRun>=0 && doRun!=RUNNOT)
+    {
+    if (VVMFormat == VVM_VOLTS)
+      Serial.print(MT, 8);
+    else
+      Serial.print(MTdB, 3);
+    Serial.print(" ");
+    Serial.println(PT, 2);
+    if(nRun>0 && --nRun==0)
+      {
+      nRun = -1;
+      doRun = RUNNOT;;  // Don't go continuous
+      }
+    }
+  }
+
+// Move all block sums from lockIn into the window ring
+void VVMDrain(void)
+  {
+  struct lockInSample ls;
+  int32_t sum;
+
+  while (lockIn.read(&ls))
+    {
+    // The lockIn ring was full and blocks are missing.  Start the window
+    // over, rather than have a time gap inside it.
+    if(ls.n != VVMNextBlock)
+      {
+      for(int jj=0; jj<4; jj++)
+        VVMRunSum[jj] = 0;
+      VVMiRing = 0;  VVMnFilled = 0;
+      VVMGaps++;
+      }
+    VVMNextBlock = ls.n + 1;
+    for(int jj=0; jj<4; jj++)
+      {
+      sum = (int32_t)ls.v[jj];         // Exact, see beginBlockSums()
+      if(VVMnFilled >= VVMnWin)
+        VVMRunSum[jj] -= VVMBlockSum[VVMiRing][jj];   // Oldest out
+      VVMBlockSum[VVMiRing][jj] = sum;
+      VVMRunSum[jj] += sum;
+      }
+    if(++VVMiRing >= VVMnWin)
+      VVMiRing = 0;
+    if(VVMnFilled < VVMnWin)
+      VVMnFilled++;
+    }
+  }
+
+void VVMSlideStop(void)
+  {
+  if (!lockInOn)
+    lockIn.end();
+  VVMSumsRunning = false;
+  VVMSlideRestart = true;
+  }
+
+/* Number of blocks in the window.  Within 20% of VVMWindowMs, pick the
+ * one closest to a whole number of periods of f, so the 2f mixer product
+ * mostly cancels out of the window sums.
+ */
+uint16_t VVMWindowBlocks(void)
+  {
+  float32_t wt, spp, cyc, err, bestErr;
+  uint16_t w, wLo, wHi, best;
+
+  wt = 0.001f*(float32_t)VVMWindowMs*sampleRateExact/128.0f;
+  spp = sampleRateExact/FreqData[0].freqHz;      // Samples per period
+  wLo = (uint16_t)(0.8f*wt);
+  wHi = (uint16_t)(1.2f*wt + 1.0f);
+  if(wLo < 1)  wLo = 1;
+  if(wHi > VVM_MAX_BLOCKS)  wHi = VVM_MAX_BLOCKS;
+  if(wLo > wHi)  wLo = wHi;
+  best = wLo;  bestErr = 1.0E9f;
+  for(w=wLo; w<=wHi; w++)
+    {
+    cyc = 128.0f*(float32_t)w/spp;
+    err = fabsf(cyc - roundf(cyc))*spp/(float32_t)w;   // Samples off, per block
+    if(err < bestErr)
+      {
+      bestErr = err;
+      best = w;
+      }
+    }
+  return best;
+  }
+
+/* Redraw a field of Arial_24 text.  If only digits changed, and no
+ * character moved, only those digits are redrawn.  Digits are all the same
+ * width in Arial, so positions don't move.  Otherwise the whole field.
+ */
+void VVMDrawChanged(char *str, char *last, int16_t x0, int16_t fieldW)
+  {
+  char prefix[16], one[2];
+  uint16_t n, ii, x, w;
+  bool sameLayout;
+
+  tft.setFont(Arial_24);
+  n = strlen(str);
+  sameLayout = (n == strlen(last));
+  for(ii=0; ii<n && sameLayout; ii++)
+    {
+    if( (isdigit(str[ii])==0) != (isdigit(last[ii])==0) )
+      sameLayout = false;
+    else if(!isdigit(str[ii]) && str[ii]!=last[ii])
+      sameLayout = false;
+    }
+  if(!sameLayout)
+    {
+    tft.fillRect(x0, 70, fieldW, 28, ILI9341_BLACK);
+    tft.setCursor(x0, 70);
+    tft.print(str);
+    strcpy(last, str);
+    return;
+    }
+  one[1] = 0;
+  for(ii=0; ii<n; ii++)
+    {
+    if(str[ii] == last[ii])
+      continue;
+    strncpy(prefix, str, ii);
+    prefix[ii] = 0;
+    x = x0 + tft.strPixelLen(prefix);
+    one[0] = str[ii];
+    w = tft.strPixelLen(one);
+    tft.fillRect(x, 70, w, 28, ILI9341_BLACK);
+    tft.setCursor(x, 70);
+    tft.print(str[ii]);
+    }
+  strcpy(last, str);
+  }
+
 void tToASA(void)
   {
   static bool beenHere = false;
@@ -833,6 +1157,7 @@ void tToASA(void)
   setSwitch(TRANSMISSION_37);
   DC1.amplitude(0.0);   // (dacLevel);
   tft.fillScreen(ILI9341_BLACK);
+  topLinesValid = false;
 //  if(SDCardAvailable)
 //    drawScreenSaveBox(ILI9341_GREEN);
 //  else
@@ -856,10 +1181,18 @@ void tToASAFreq(void)
         freqASA[ASAI2SFreqIndex].SAnAve *= 2;
   if( (currentMenu == 13 ) && (menuItem == 4) && (freqASA[ASAI2SFreqIndex].SAnAve >= 4) )
         freqASA[ASAI2SFreqIndex].SAnAve /= 2;
+  if((currentMenu == 13 ) && (menuItem == 5))   // Step through the 8 averaging modes
+    {
+    if(ASALogAve)
+      ASAAveMode = (ASAAveMode + 1) & 3;
+    ASALogAve = !ASALogAve;
+    ASARestartAve = true;
+    }
 
   setSample(freqASA[ASAI2SFreqIndex].rateIndex);
   countMax = freqASA[ASAI2SFreqIndex].SAnAve;
   tft.fillRect(0, 15, 301, 223, ILI9341_BLACK);
+  topLinesValid = false;
   tft.fillRect(0, 0, 25, 15, ILI9341_BLACK);  // Catch the "0"
   tft.setTextColor(ILI9341_YELLOW);
   tft.setFont(Arial_12);
@@ -883,6 +1216,10 @@ void tToASAFreq(void)
     tft.print("Samples per Update");
   tft.setCursor(220, 164);
   tft.print(freqASA[ASAI2SFreqIndex].SAnAve);
+  tft.setCursor(20, 186);
+  tft.print("Averaging");
+  tft.setCursor(140, 186);
+  tft.print(ASAAveName());
   }
 
 void tToASAAmplitude(void)
@@ -908,6 +1245,7 @@ void tToASAAmplitude(void)
     ASAdbOffset -= 5.0f;
 
   tft.fillRect(0, 15, 301, 223, ILI9341_BLACK);
+  topLinesValid = false;
   tft.fillRect(0, 0, 25, 15, ILI9341_BLACK);  // Catch the "0"
   tft.setTextColor(ILI9341_YELLOW);
   tft.setFont(Arial_12);
@@ -945,6 +1283,17 @@ void tToASASinad(void) {
     }
 }
 
+// Cycles the dual channel modes, off, meas and ref, gain, phase.  See doDualFFT()
+void tToASADual(void) {
+  if(++ASADual > ASA_DUAL_PHASE)
+    ASADual = ASA_DUAL_OFF;
+  if(ASADual == ASA_DUAL_OFF)
+    ASADualOff();
+  ASARestartAve = true;
+  prepSpectralDisplay();
+  show_spectrum();
+}
+
 // This may be extreme, but does the job.  Clears reference to data
 // that may be out of date.
 void clearStatus(void)
@@ -1035,7 +1384,7 @@ void tDoSweepZ(void)                        // Impedance Sweep
      for (nFreq = 1; nFreq <= 13;  nFreq++) // Over all frequencies; nFreq is global freq index
         {
         setUpNewFreq(nFreq);
-        delay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
+        settleDelay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
         measureZ(nFreq);   // result is Z[nFreq], Y[nFreq], sLC[nFreq], pLC[nFreq] and Q[nFreq]
         serialPrintZ(nFreq);    // Rev 0.6.0
         }
@@ -1081,7 +1430,7 @@ void tDoSweepT(void)
      for (nFreq = 1; nFreq <= 13;  nFreq++) // Over all frequencies; nFreq is global freq index
         {
         setUpNewFreq(nFreq);
-        delay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
+        settleDelay(ZDELAY + (unsigned long)(1000.0 / FreqData[nFreq].freqHz));
         measureT();      // result is Tmeas
         T[nFreq] = Tmeas;
         }
@@ -1237,6 +1586,14 @@ void doWhatPart(void)
 	    }      
        
        
+  // Keep the 50 Ohm Z's, for the circuit fit
+  for(i=baseIndex; i<=13; i++)
+     {
+     fitF[i-baseIndex] = FreqData[i].freqHz;
+     fitRe[i-baseIndex] = (float)Z[i].real();
+     fitIm[i-baseIndex] = (float)Z[i].imag();
+     }
+
   // This is mostly duplicate stuff of 50 Ohm---make separate function <<<<<<<<<<<
   tft.setFont(Arial_12);
   tft.setCursor(10, 140);
@@ -1331,6 +1688,22 @@ void doWhatPart(void)
         tft.print(valueStringSign(-XX, rUnits));
 	    }      
        
+  // Circuit fit over all frequencies, each Z from the Ref R closer to it
+  for(i=baseIndex; i<=13; i++)
+     {
+     ZM = sqrt(Z[i].real()*Z[i].real() + Z[i].imag()*Z[i].imag());
+     if(fabs(log(ZM/5000.0)) < fabs(log(sqrt(fitRe[i-baseIndex]*fitRe[i-baseIndex] +
+              fitIm[i-baseIndex]*fitIm[i-baseIndex])/50.0)))
+        {
+        fitRe[i-baseIndex] = (float)Z[i].real();
+        fitIm[i-baseIndex] = (float)Z[i].imag();
+        }
+     }
+  if(fitBest(fitF, fitRe, fitIm, 14-baseIndex, &fitLast))
+     {
+     lcdPrintFit(104);
+     printFit();
+     }
 
   // Leave this function with the sate restored
   uSave.lastState.SingleorSweep = saveSS;
@@ -1340,6 +1713,42 @@ void doWhatPart(void)
   setRefR(uSave.lastState.iRefR);
   }
 
+// One line on the WHATSIT screen for the fitLast circuit
+void lcdPrintFit(uint16_t y)
+  {
+  float f0, q;
+  float *p = fitLast.p;
+
+  fitResonance(&f0, &q);
+  tft.fillRect(0, y-1, tft.width(), 14, ILI9341_BLACK);
+  tft.setTextColor(ILI9341_YELLOW);
+  tft.setFont(Arial_9);
+  tft.setCursor(10, y);
+  tft.print("Fit ");
+  tft.print(fitModelName(fitLast.model));
+  if(fitLast.model == FIT_SPEAKER)
+     {
+     tft.print(": Re=");   tft.print(valueString(p[0], rUnits));
+     tft.print(" fs=");    tft.print(f0, 1);
+     tft.print(" Qts=");   tft.print(q, 2);
+     }
+  else if(fitLast.model == FIT_CRYSTAL)
+     {
+     tft.print(": fs=");   tft.print(f0, 1);
+     tft.print(" Q=");     tft.print(q, 0);
+     tft.print(" C0=");    tft.print(valueString(p[3], cUnits));
+     }
+  else
+     {
+     tft.print(": R=");    tft.print(valueString(p[0], rUnits));
+     tft.print(" L=");     tft.print(valueString(p[1], lUnits));
+     tft.print(" C=");     tft.print(valueString(p[2], cUnits));
+     }
+  tft.print("  ");
+  tft.print(fitLast.rmsPct, 1);
+  tft.print("%");
+  }
+
 // Simple measurement quality estimate. Ratio is impedance/refR.
 void printQuality(float32_t ratio)
   {
@@ -1696,11 +2105,11 @@ void writeMenus(uint16_t nMenu)
     " Back", " ", " ", " Meas ", "  Cal", "",                    // Set 9 Single T meas
     " Back", "Disp Frq", "Disp Frq", " ", "  Cal", " Single",    // Set 10
     " Back", "Disp Frq", "Disp Frq", " ", "  Cal", " Single",    // Set 11
-    "Instrmnt", " Freq", "Amplitde", " SINAD ", " ", " ",        // Set 12 ASA Home
-    " Back", "Max Freq", "Max Freq", "Samples", "Samples ", " ", // Set 13 ASA Freq
+    "Instrmnt", " Freq", "Amplitde", " SINAD ", " Dual", " ",    // Set 12 ASA Home
+    " Back", "Max Freq", "Max Freq", "Samples", "Samples ", "Average",// Set 13 ASA Freq
     " Back", " dB/div", " dB/div", " Offset ", " Offset ", " ",  // Set 14 ASA Amplitude
-    "Instrmnt", " SigGen", " SigGen", " SigGen", "NoiseGen", " ",// Set 15 ASG Home
-    " Back", "Sig Gen", "Sig Gen", "  Sine ", " Square ", " ",   // Set 16 ASG 1 to 4
+    "Instrmnt", " SigGen", " SigGen", " SigGen", "NoiseGen", " Arb Gen",// Set 15 ASG Home
+    " Back", "Sig Gen", "Sig Gen", "  Sine ", " Square ", "  Wave",   // Set 16 ASG 1 to 5
     " Back", " Reset", " Volts", "  dBm   ", "   ", " ",         // Set 17 VVM
     "Instrmnt", " Touch", "V Input", "V Output", " ", " ",       // Set 18 Service
     "   Cal", " ", " ", " ", "  ", " ",                          // Set 19 Touch Cal
@@ -1720,8 +2129,8 @@ void writeMenus(uint16_t nMenu)
     " ", " ", " ", "    T ", " ", "",
     " ", "  Down", "   Up", " ", " ", "T Sweep",
     " ", "  Down", "   Up", " ", " ", "Z Sweep",
-    " Home", " ", " ", " Toggle ", " ", " ",
-    " ", "   Up ", "  Down ", "   Up", "  Down ", " ",
+    " Home", " ", " ", " Toggle ", "  Mode", " ",
+    " ", "   Up ", "  Down ", "   Up", "  Down ", "  Mode",
     " ", "   Up ", "  Down ", "    Up ", "  Down ", " ",
     " Home", "    1", "    2", "    3", "    4", " ",
     " ", "  ON", "  OFF", " Wave ", " Wave ", " ",
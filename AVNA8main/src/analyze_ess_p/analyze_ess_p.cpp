@@ -0,0 +1,241 @@
+/*
+ *  analyze_ess_p.cpp
+ *  Exponential sine sweep capture and deconvolution.  See analyze_ess_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_ess_p.h"
+
+void AudioAnalyzeESS_p::update(void)
+{
+    audio_block_t *blockX, *blockY;
+
+    blockX = receiveReadOnly(0);
+    blockY = receiveReadOnly(1);
+    if (!blockX || !blockY || !running) {
+        if (blockX) release(blockX);
+        if (blockY) release(blockY);
+        return;
+    }
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+        bufX[nCap + i] = 3.0517578E-5f*(float32_t)blockX->data[i];
+        bufY[nCap + i] = 3.0517578E-5f*(float32_t)blockY->data[i];
+    }
+    release(blockX);
+    release(blockY);
+    nCap += AUDIO_BLOCK_SAMPLES;
+    if (nCap >= ESS_N) {
+        running = false;
+        done = true;
+    }
+}
+
+// Real FFT in place.  Packed as CMSIS arm_rfft_fast_f32, buf[0] is the DC
+// term, buf[1] the ESS_N/2 term and then re, im for bins 1 to ESS_N/2-1.
+void AudioAnalyzeESS_p::rfft(float32_t *buf)
+{
+    const uint32_t m = ESS_N/2;
+    float32_t a, b, er, ei, orr, oi, c, s, tr, ti;
+    uint32_t km;
+
+    arm_cfft_radix2_f32(&cfftF, buf);      // Even samples real, odd imaginary
+    a = buf[0];
+    b = buf[1];
+    buf[0] = a + b;
+    buf[1] = a - b;
+    for (uint32_t k=1; k<=m/2; k++) {
+        km = m - k;
+        // E = (Z(k) + Z*(m-k))/2,  O = (Z(k) - Z*(m-k))/2j
+        er = 0.5f*(buf[2*k] + buf[2*km]);
+        ei = 0.5f*(buf[2*k+1] - buf[2*km+1]);
+        orr = 0.5f*(buf[2*k+1] + buf[2*km+1]);
+        oi = -0.5f*(buf[2*k] - buf[2*km]);
+        c = cosf(2.0f*PI*(float32_t)k/(float32_t)ESS_N);
+        s = sinf(2.0f*PI*(float32_t)k/(float32_t)ESS_N);
+        // W(k)*O, W = exp(-j 2 pi k/ESS_N).  X(k) = E + WO, X(m-k) = (E - WO)*
+        tr = c*orr + s*oi;
+        ti = c*oi - s*orr;
+        buf[2*k] = er + tr;
+        buf[2*k+1] = ei + ti;
+        buf[2*km] = er - tr;
+        buf[2*km+1] = -(ei - ti);
+    }
+}
+
+// Inverse of rfft(), scaled by 1/ESS_N so irfft(rfft(x)) is x
+void AudioAnalyzeESS_p::irfft(float32_t *buf)
+{
+    const uint32_t m = ESS_N/2;
+    float32_t a, b, er, ei, dr, di, orr, oi, c, s;
+    uint32_t km;
+
+    a = buf[0];
+    b = buf[1];
+    buf[0] = 0.5f*(a + b);
+    buf[1] = 0.5f*(a - b);
+    for (uint32_t k=1; k<=m/2; k++) {
+        km = m - k;
+        // E = (X(k) + X*(m-k))/2,  O = exp(+j 2 pi k/ESS_N)(X(k) - X*(m-k))/2
+        er = 0.5f*(buf[2*k] + buf[2*km]);
+        ei = 0.5f*(buf[2*k+1] - buf[2*km+1]);
+        dr = 0.5f*(buf[2*k] - buf[2*km]);
+        di = 0.5f*(buf[2*k+1] + buf[2*km+1]);
+        c = cosf(2.0f*PI*(float32_t)k/(float32_t)ESS_N);
+        s = sinf(2.0f*PI*(float32_t)k/(float32_t)ESS_N);
+        orr = c*dr - s*di;
+        oi = c*di + s*dr;
+        // Z(k) = E + jO,  Z(m-k) = E* + jO*
+        buf[2*k] = er - oi;
+        buf[2*k+1] = ei + orr;
+        buf[2*km] = er + oi;
+        buf[2*km+1] = -ei + orr;
+    }
+    arm_cfft_radix2_f32(&cfftI, buf);      // Includes the 1/(ESS_N/2)
+}
+
+void AudioAnalyzeESS_p::deconvolve(float32_t reg)
+{
+    float32_t xr, xi, yr, yi, d, maxX2 = 0.0f;
+
+    rfft(bufX);
+    rfft(bufY);
+    for (int i=0; i<ESS_N; i++) {
+        d = bufX[i]*bufX[i];
+        if (i > 1)                         // Bins past DC and ESS_N/2 are pairs
+            d += bufX[i ^ 1]*bufX[i ^ 1];
+        if (d > maxX2)
+            maxX2 = d;
+    }
+    reg *= maxX2;
+    if (reg <= 0.0f)
+        reg = 1.0E-30f;
+    bufY[0] = bufY[0]*bufX[0]/(bufX[0]*bufX[0] + reg);
+    bufY[1] = bufY[1]*bufX[1]/(bufX[1]*bufX[1] + reg);
+    for (int k=1; k<ESS_N/2; k++) {
+        xr = bufX[2*k];   xi = bufX[2*k+1];
+        yr = bufY[2*k];   yi = bufY[2*k+1];
+        d = xr*xr + xi*xi + reg;
+        bufY[2*k] = (yr*xr + yi*xi)/d;
+        bufY[2*k+1] = (yi*xr - yr*xi)/d;
+    }
+    irfft(bufY);
+    nHarm = 0;
+}
+
+uint16_t AudioAnalyzeESS_p::setHarmonics(uint16_t _nHarm, float32_t nSweep, float32_t f2OverF1)
+{
+    float32_t dt[ESS_MAX_HARM+2];           // Time ahead of linear, samples
+    float32_t t;
+    int32_t n;
+
+    if (_nHarm < 1)
+        _nHarm = 1;
+    if (_nHarm > ESS_MAX_HARM)
+        _nHarm = ESS_MAX_HARM;
+    dt[0] = 0.0f;                          // Not used, keeps k-1 simple
+    for (int k=1; k<=_nHarm+1; k++)
+        dt[k] = nSweep*logf((float32_t)k)/logf(f2OverF1);
+    while (_nHarm > 1 && 0.5f*(dt[_nHarm] + dt[_nHarm+1]) > (float32_t)(ESS_N/4))
+        _nHarm--;
+    nHarm = _nHarm;
+
+    segCenter[1] = 0;
+    segStart[1] = -(int32_t)(0.5f*dt[2] + 0.5f);
+    segEnd[1] = ESS_N - (int32_t)(0.5f*(dt[nHarm] + dt[nHarm+1]) + 0.5f);
+    for (int k=2; k<=nHarm; k++) {
+        segCenter[k] = -(int32_t)(dt[k] + 0.5f);
+        segStart[k] = -(int32_t)(0.5f*(dt[k] + dt[k+1]) + 0.5f);
+        segEnd[k] = -(int32_t)(0.5f*(dt[k-1] + dt[k]) + 0.5f);
+    }
+
+    // Linear response, windowed from h(n) into bufX and transformed
+    for (int i=0; i<ESS_N; i++)
+        bufX[i] = 0.0f;
+    for (n=segStart[1]; n<segEnd[1]; n++) {
+        t = taper(n, 1);
+        bufX[n & (ESS_N-1)] = t*bufY[n & (ESS_N-1)];
+    }
+    rfft(bufX);
+    return nHarm;
+}
+
+// Raised cosine over ESS_TAPER samples at each end of window k
+float32_t AudioAnalyzeESS_p::taper(int32_t n, uint16_t k)
+{
+    int32_t d, nt;
+
+    d = n - segStart[k];
+    if (segEnd[k] - 1 - n < d)
+        d = segEnd[k] - 1 - n;
+    nt = (segEnd[k] - segStart[k])/2;
+    if (nt > ESS_TAPER)
+        nt = ESS_TAPER;
+    if (d >= nt)
+        return 1.0f;
+    return 0.5f - 0.5f*cosf(PI*((float32_t)d + 0.5f)/(float32_t)nt);
+}
+
+bool AudioAnalyzeESS_p::response(uint16_t k, uint16_t j, float32_t *re, float32_t *im)
+{
+    uint32_t b = (uint32_t)k*(uint32_t)j;
+    float32_t v, wr, wi, sr, si, t, accR, accI;
+    int32_t n;
+
+    *re = 0.0f;
+    *im = 0.0f;
+    if (k < 1 || k > nHarm || b > ESS_N/2)
+        return false;
+    if (k == 1) {
+        if (j == 0)
+            *re = bufX[0];
+        else if (j == ESS_N/2)
+            *re = bufX[1];
+        else {
+            *re = bufX[2*j];
+            *im = bufX[2*j+1];
+        }
+        return true;
+    }
+    // Harmonics are short, so one DFT bin of the window, about the arrival
+    // time.  The phasor rotates by exp(-j 2 pi b/ESS_N) each sample.
+    t = -2.0f*PI*(float32_t)b/(float32_t)ESS_N;
+    sr = cosf(t);
+    si = sinf(t);
+    // Start phase from the exact product, mod ESS_N, not a large float angle
+    n = (int32_t)(((int64_t)b*(int64_t)(segStart[k] - segCenter[k])) & (ESS_N-1));
+    t = -2.0f*PI*(float32_t)n/(float32_t)ESS_N;
+    wr = cosf(t);
+    wi = sinf(t);
+    accR = 0.0f;
+    accI = 0.0f;
+    for (n=segStart[k]; n<segEnd[k]; n++) {
+        v = taper(n, k)*bufY[n & (ESS_N-1)];
+        accR += v*wr;
+        accI += v*wi;
+        t = wr*sr - wi*si;
+        wi = wr*si + wi*sr;
+        wr = t;
+    }
+    *re = accR;
+    *im = accI;
+    return true;
+}
@@ -0,0 +1,129 @@
+/*
+ *  analyze_ess_p.h
+ *  Two channel capture and deconvolution of an exponential sine sweep
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Input 0 is x, the sweep as seen by the reference channel, and input 1 is
+ * y, the response.  start(), with audio interrupts off and on the same
+ * update cycle as the sweep, captures the next ESS_N samples of both as
+ * float.  The sweep and the response tail must fit in the capture, so the
+ * sweep is made about 3/4 of ESS_N long.
+ *
+ * deconvolve() then finds, in the loop and not the interrupt,
+ *       H(k) = Y(k) X*(k)/(|X(k)|^2 + reg*max|X|^2)
+ *       h(n) = IFFT(H)
+ * Dividing by the captured x removes the codec delay, the input channel
+ * difference and the sweep amplitude shape.  reg keeps the bins outside
+ * f1 to f2, where x has no power, from blowing up.  The FFTs are real,
+ * ESS_N points, done as an ESS_N/2 complex FFT and a split step.
+ *
+ * With an exponential sweep, the response to harmonic k of any distortion
+ * comes before the linear response by
+ *       dt(k) = nSweep*ln(k)/ln(f2/f1)  samples
+ * and so shows up at the end of the circular h(n).  setHarmonics() places a
+ * window, with ESS_TAPER sample cosine edges, half way between each of
+ * these, and FFT's the linear part.  response(k, j) is then the response of
+ * harmonic k, at k times the frequency of bin j, to an excitation at bin j.
+ * k=1 is the linear transfer function y/x.  The linear part is the whole
+ * circle less the harmonic windows, so the IR tail must die out before the
+ * windows start.  Harmonics that would need more than ESS_N/4 are dropped.
+ *
+ * start(work) is given ESS_WORK_BYTES, 8*ESS_N bytes or 32 kBytes, of RAM
+ * for x and y, 4-byte aligned.  It holds the results, so it stays with the
+ * object until they are read.  8192 gives 2x the resolution, if the rest
+ * of the sketch leaves room for 64 kBytes.
+ */
+
+#ifndef analyze_ess_p_h_
+#define analyze_ess_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+#define ESS_N 4096              // Power of 2, 256 to 8192
+#define ESS_MAX_HARM 5
+#define ESS_TAPER 16
+#define ESS_WORK_BYTES (8*ESS_N)
+
+class AudioAnalyzeESS_p : public AudioStream
+{
+public:
+    AudioAnalyzeESS_p() : AudioStream(2, inputQueueArray) {
+        running = false;
+        done = false;
+        nHarm = 0;
+        bufX = NULL;
+        bufY = NULL;
+        arm_cfft_radix2_init_f32(&cfftF, ESS_N/2, 0, 1);
+        arm_cfft_radix2_init_f32(&cfftI, ESS_N/2, 1, 1);
+    }
+
+    void start(void *work) {
+        bufX = (float32_t *)work;
+        bufY = bufX + ESS_N;
+        nCap = 0;
+        nHarm = 0;
+        done = false;
+        running = true;
+    }
+
+    void stop(void) {
+        running = false;
+    }
+
+    bool available(void) {
+        return done;
+    }
+
+    // After available(), the captured x and y become h(n)
+    void deconvolve(float32_t reg);
+
+    // h(n) for n = -ESS_N/2 to ESS_N/2-1, and the circle beyond
+    float32_t impulse(int32_t n) {
+        return bufY[n & (ESS_N-1)];
+    }
+
+    // Returns the number of harmonics, 1 to _nHarm, that fit
+    uint16_t setHarmonics(uint16_t _nHarm, float32_t nSweep, float32_t f2OverF1);
+
+    // False if k*j is past ESS_N/2 or k is not set up
+    bool response(uint16_t k, uint16_t j, float32_t *re, float32_t *im);
+
+    virtual void update(void);
+
+private:
+    void rfft(float32_t *buf);
+    void irfft(float32_t *buf);
+    float32_t taper(int32_t n, uint16_t k);
+    volatile bool running;
+    volatile bool done;
+    uint16_t nCap;
+    uint16_t nHarm;
+    // Windows of h(n), [segStart, segEnd), and the arrival time of each
+    int32_t segStart[ESS_MAX_HARM+1], segEnd[ESS_MAX_HARM+1], segCenter[ESS_MAX_HARM+1];
+    float32_t *bufX, *bufY;           // ESS_N each, in the work RAM
+    audio_block_t *inputQueueArray[2];
+    arm_cfft_radix2_instance_f32 cfftF, cfftI;
+};
+#endif
@@ -29,6 +29,7 @@
 #include <Arduino.h>
 #include "analyze_fft1024_p.h"
 #include "utility/dspinst.h"
+#include "../perfR2/perfR2.h"
 
 
 // 140312 - PAH - slightly faster copy
@@ -59,11 +60,27 @@ static void apply_window_to_fft_buffer(void *buffer, const void *window)
 void AudioAnalyzeFFT1024_p::update(void)
 {
 	audio_block_t *block;
+	uint32_t tPerf = perfStart();
 
 	block = receiveReadOnly();
 	if (!block) return;
 
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {     // rev _p, peak
+		int16_t a = block->data[i];
+		if (a < 0) a = (a == -32768) ? 32767 : -a;
+		if (a > peak) peak = a;
+	}
+	if (interval == 0) {             // rev _p, FFT off
+		for (int i=0; i < state; i++)
+			release(blocklist[i]);
+		state = 0;
+		frameCount = 0;
+		release(block);
+		return;
+	}
+
 #if defined(__ARM_ARCH_7EM__)
+	float32_t *output;            // rev _p, snap buffer being written
 	switch (state) {
 	case 0:
 		blocklist[0] = block;
@@ -95,6 +112,19 @@ void AudioAnalyzeFFT1024_p::update(void)
 		break;
 	case 7:
 		blocklist[7] = block;
+		if (++frameCount < interval) {   // rev _p, skip this frame
+			release(blocklist[0]);
+			release(blocklist[1]);
+			release(blocklist[2]);
+			release(blocklist[3]);
+			blocklist[0] = blocklist[4];
+			blocklist[1] = blocklist[5];
+			blocklist[2] = blocklist[6];
+			blocklist[3] = blocklist[7];
+			state = 4;
+			break;
+		}
+		frameCount = 0;
 		// TODO: perhaps distribute the work over multiple update() ??
 		//       github pull requsts welcome......
 		copy_to_fft_buffer(buffer+0x000, blocklist[0]->data);
@@ -108,13 +138,14 @@ void AudioAnalyzeFFT1024_p::update(void)
 		if (window) apply_window_to_fft_buffer(buffer, window);
 		arm_cfft_radix4_q15(&fft_inst, buffer);
 
+		output = snap.writeBuffer();
 		for (int i=0; i < 512; i++) {
 			uint32_t tmp = *((uint32_t *)buffer + i); // real & imag
 			uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
 			output[i] = 3.72529E-9*(float32_t)magsq;  // _p version  (1/16384)^2
 			// If input is full scale (-32768, 32767) the output is 0.1174 ??
 		}
-		outputflag = true;
+		snap.publish();
 		release(blocklist[0]);
 		release(blocklist[1]);
 		release(blocklist[2]);
@@ -129,6 +160,7 @@ void AudioAnalyzeFFT1024_p::update(void)
 #else
 	release(block);
 #endif
+	perfStop(PERF_FFT_UPDATE, tPerf);
 }
 
 
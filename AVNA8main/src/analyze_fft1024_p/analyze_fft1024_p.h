@@ -7,6 +7,8 @@
  *   3- read(first, last) removed
  *   4- checks on bin range removed
  *   5- output[] array made float to streamline
+ *   6- output triple buffered, see snapR2.h.  available() takes the newest
+ *      spectrum and read() is from it until the next available().
  * for AVNA Spectrum analyzer.  Bob Larkin August 2020
  *
  * Development of this audio library was funded by PJRC.COM, LLC by sales of
@@ -38,6 +40,7 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 #include "arm_math.h"
+#include "../snapR2/snapR2.h"
 
 // windows.c
 extern "C" {
@@ -58,33 +61,58 @@ class AudioAnalyzeFFT1024_p : public AudioStream
 {
 public:
 	AudioAnalyzeFFT1024_p() : AudioStream(1, inputQueueArray),
-	  window(AudioWindowBlackmanHarris1024), state(0), outputflag(false) {
+	  window(AudioWindowBlackmanHarris1024), state(0),
+	  interval(1), frameCount(0), peak(0) {
 		arm_cfft_radix4_init_q15(&fft_inst, 1024, 0, 1);
 	}
+	// Do the FFT for only 1 of every n frames (of 512 new samples), to
+	// limit the interrupt time.  n=0 stops the FFT, and update() only
+	// releases the blocks.  Default is 1, every frame.
+	void setInterval(uint16_t n) {
+		interval = n;
+	}
+	// Largest |sample| since the last call, 32767 is full scale
+	int16_t readPeak(void) {
+		int16_t p = peak;
+		peak = 0;
+		return p;
+	}
 	bool available() {
-		if (outputflag == true) {
-			outputflag = false;
-			return true;
-		}
-		return false;
+		return snap.take();
 	}
 	float read(unsigned int binNumber) {
 		if (binNumber > 511) return 0.0;
-		return output[binNumber];
+		return snap.readBuffer()[binNumber];
+	}
+	// All 512 bins of the spectrum from the last available()
+	const float32_t *getOutput(void) {
+		return snap.readBuffer();
+	}
+	// Spectra read, and those replaced by a newer one before available()
+	uint32_t frames(void) {
+		return snap.frames();
+	}
+	uint32_t lost(void) {
+		return snap.lost();
+	}
+	void clearCounts(void) {
+		snap.clearCounts();
 	}
 
 	void windowFunction(const int16_t *w) {
 		window = w;
 	}
 	virtual void update(void);
-	float32_t output[512];   // rev _p
 private:
 	void init(void);
 	const int16_t *window;
 	audio_block_t *blocklist[8];
 	int16_t buffer[2048] __attribute__ ((aligned (4)));
 	uint8_t state;
-	volatile bool outputflag;
+	SpecSnap snap;           // rev _p, was output[512]
+	volatile uint16_t interval;
+	uint16_t frameCount;
+	volatile int16_t peak;
 	audio_block_t *inputQueueArray[1];
 	arm_cfft_radix4_instance_q15 fft_inst;
 };
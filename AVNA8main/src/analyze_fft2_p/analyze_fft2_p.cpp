@@ -0,0 +1,154 @@
+/*
+ *  analyze_fft2_p.cpp
+ *  Two channel FFT for the AVNA.  See analyze_fft2_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_fft2_p.h"
+#include "../perfR2/perfR2.h"
+
+void AudioAnalyzeFFT2_p::start(uint16_t _nAve, void *work)
+{
+    if (_nAve < 1)
+        _nAve = 1;
+    if (_nAve > FFT2_MAX_AVE)
+        _nAve = FFT2_MAX_AVE;
+    wk = (struct fft2Work *)work;
+    for (int k=0; k<512; k++) {
+        wk->sxx[k] = 0.0f;    wk->syy[k] = 0.0f;
+        wk->sxyRe[k] = 0.0f;  wk->sxyIm[k] = 0.0f;
+    }
+    nTarget = _nAve;
+    nFrames = 0;
+    nTime = 0;
+    done = false;
+    running = true;
+}
+
+void AudioAnalyzeFFT2_p::cross(uint16_t k, float32_t *re, float32_t *im)
+{
+    float32_t s;
+
+    if (k > 511 || nFrames == 0) {
+        *re = 0.0f;  *im = 0.0f;
+        return;
+    }
+    s = frameScale/(float32_t)nFrames;
+    *re = s*wk->sxyRe[k];
+    *im = s*wk->sxyIm[k];
+}
+
+bool AudioAnalyzeFFT2_p::h1(uint16_t k, float32_t *re, float32_t *im)
+{
+    if (k > 511 || nFrames == 0 || wk->sxx[k] <= 0.0f) {
+        *re = 0.0f;  *im = 0.0f;
+        return false;
+    }
+    *re = wk->sxyRe[k]/wk->sxx[k];
+    *im = wk->sxyIm[k]/wk->sxx[k];
+    return true;
+}
+
+float32_t AudioAnalyzeFFT2_p::phase(uint16_t k)
+{
+    if (k > 511 || nFrames == 0)
+        return 0.0f;
+    return 57.29578f*atan2f(wk->sxyIm[k], wk->sxyRe[k]);
+}
+
+float32_t AudioAnalyzeFFT2_p::coherence(uint16_t k)
+{
+    float32_t d;
+
+    if (k > 511 || nFrames == 0)
+        return 0.0f;
+    d = wk->sxx[k]*wk->syy[k];
+    if (d <= 0.0f)
+        return 0.0f;
+    return (wk->sxyRe[k]*wk->sxyRe[k] + wk->sxyIm[k]*wk->sxyIm[k])/d;
+}
+
+void AudioAnalyzeFFT2_p::update(void)
+{
+    audio_block_t *blockX, *blockY;
+    uint32_t tPerf = perfStart();
+
+    blockX = receiveReadOnly(0);
+    blockY = receiveReadOnly(1);
+    if (!blockX || !blockY || !running) {
+        if (blockX) release(blockX);
+        if (blockY) release(blockY);
+        return;
+    }
+    memcpy(wk->timeX + nTime, blockX->data, AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+    memcpy(wk->timeY + nTime, blockY->data, AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+    release(blockX);
+    release(blockY);
+    nTime += AUDIO_BLOCK_SAMPLES;
+    if (nTime < 1024)
+        return;
+
+    doFFT2();
+    // 50% overlap, keep the newest 512 samples
+    memcpy(wk->timeX, wk->timeX + 512, 512*sizeof(int16_t));
+    memcpy(wk->timeY, wk->timeY + 512, 512*sizeof(int16_t));
+    nTime = 512;
+    if (++nFrames >= nTarget) {
+        running = false;
+        done = true;
+    }
+    perfStop(PERF_FFT2_UPDATE, tPerf);
+}
+
+void AudioAnalyzeFFT2_p::doFFT2(void)
+{
+    float32_t w, zr, zi, zrn, zin, xr, xi, yr, yi;
+
+    // Window to +/-1.0 full scale, x real and y imaginary
+    for (int i=0; i<1024; i++) {
+        w = 9.3132257E-10f*(float32_t)AudioWindowHanning1024[i];   // 1/32768^2
+        wk->fftBuffer[2*i] = w*(float32_t)wk->timeX[i];
+        wk->fftBuffer[2*i + 1] = w*(float32_t)wk->timeY[i];
+    }
+    arm_cfft_radix4_f32(&fft_inst, wk->fftBuffer);
+
+    // DC, both real
+    xr = wk->fftBuffer[0];
+    yr = wk->fftBuffer[1];
+    wk->sxx[0] += xr*xr;
+    wk->syy[0] += yr*yr;
+    wk->sxyRe[0] += xr*yr;
+    for (int k=1; k<512; k++) {
+        zr = wk->fftBuffer[2*k];
+        zi = wk->fftBuffer[2*k + 1];
+        zrn = wk->fftBuffer[2*(1024 - k)];
+        zin = wk->fftBuffer[2*(1024 - k) + 1];
+        xr = 0.5f*(zr + zrn);
+        xi = 0.5f*(zi - zin);
+        yr = 0.5f*(zi + zin);
+        yi = 0.5f*(zrn - zr);
+        wk->sxx[k] += xr*xr + xi*xi;
+        wk->syy[k] += yr*yr + yi*yi;
+        wk->sxyRe[k] += xr*yr + xi*yi;      // X* Y
+        wk->sxyIm[k] += xr*yi - xi*yr;
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ *  analyze_fft2_p.h
+ *  Two channel FFT, auto and cross spectra with Welch averaging, for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Input 0 is x, the excitation as seen by the reference channel, and input 1
+ * is y, the response.  Each frame is 1024 samples of both, Hann window, 50%
+ * overlap.  The two real frames go through one 1024 point complex float FFT
+ * as x + jy and are separated with
+ *       X(k) = (Z(k) + Z*(N-k))/2      Y(k) = (Z(k) - Z*(N-k))/2j
+ * so both channels cost about one FFT.  For each of the 512 bins the auto
+ * spectra Gxx and Gyy and the cross spectrum Gxy = X* Y are summed over the
+ * frames (Welch averaging).  From these,
+ *       H1(k) = Gxy(k)/Gxx(k)                 Transfer function y/x
+ *       coh(k) = |Gxy(k)|^2/(Gxx(k)*Gyy(k))   Coherence, 0 to 1
+ * H1 is unbiased by noise on y.  Coherence below 1 shows noise, distortion
+ * or too short a window, and its random error in H1 is about
+ * sqrt((1 - coh)/(2*coh*nAve)).
+ *
+ * start(nAve, work), with audio interrupts off, clears the sums and
+ * averages the next nAve frames.  work is FFT2_WORK_BYTES of RAM,
+ * 4-byte aligned, for the time data, the FFT and the sums.  available() is
+ * then true and the results hold until the next start(), as long as work
+ * is not used for anything else.  end() gives it up, and then there are no
+ * results.  The auto spectra are per frame and scaled as
+ * AudioAnalyzeFFT1024_p, so the same cal constants apply.
+ *
+ * TFNOISE uses this for H1.  The ASA dual channel modes use the auto spectra,
+ * the cross spectrum phase and the coherence, in place of fft1024p.
+ *
+ * Not started, update() only releases the blocks.  Running, mostly the FFT
+ * every 512 samples, roughly 10% of a Teensy 3.6 at 96 kHz sample rate (see
+ * PERF).  RAM is FFT2_WORK_BYTES, 20 kBytes, of work and under 1 kByte.
+ */
+
+#ifndef analyze_fft2_p_h_
+#define analyze_fft2_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+#define FFT2_MAX_AVE 4096
+
+// Newest input samples, 1024 when full, the older 512 are kept for overlap
+struct fft2Work {
+    int16_t timeX[1024], timeY[1024];
+    float32_t fftBuffer[2048];
+    float32_t sxx[512], syy[512], sxyRe[512], sxyIm[512];
+};
+#define FFT2_WORK_BYTES sizeof(struct fft2Work)
+
+extern "C" {
+extern const int16_t AudioWindowHanning1024[];
+}
+
+class AudioAnalyzeFFT2_p : public AudioStream
+{
+public:
+    AudioAnalyzeFFT2_p() : AudioStream(2, inputQueueArray) {
+        running = false;
+        done = false;
+        nFrames = 0;
+        wk = NULL;
+        arm_cfft_radix4_init_f32(&fft_inst, 1024, 0, 1);
+    }
+
+    void start(uint16_t _nAve, void *work);
+
+    void stop(void) {
+        running = false;
+    }
+
+    // Stop, and the results are gone with the work RAM
+    void end(void) {
+        running = false;
+        done = false;
+        nFrames = 0;
+    }
+
+    bool available(void) {
+        return done;
+    }
+
+    // Started and not yet done
+    bool busy(void) {
+        return running;
+    }
+
+    // Frames summed so far
+    uint16_t frames(void) {
+        return nFrames;
+    }
+
+    // Average power of bin k of x and y, 0 to 511
+    float32_t autoX(uint16_t k) {
+        return (k > 511 || nFrames == 0) ? 0.0f : wk->sxx[k]*frameScale/(float32_t)nFrames;
+    }
+    float32_t autoY(uint16_t k) {
+        return (k > 511 || nFrames == 0) ? 0.0f : wk->syy[k]*frameScale/(float32_t)nFrames;
+    }
+
+    // Average cross spectrum, X* Y, same scale as the auto spectra
+    void cross(uint16_t k, float32_t *re, float32_t *im);
+
+    // Transfer function y/x of bin k.  False, and 0, with no x power.
+    bool h1(uint16_t k, float32_t *re, float32_t *im);
+
+    // Phase of y relative to x, of the cross spectrum, degrees -180 to 180
+    float32_t phase(uint16_t k);
+
+    float32_t coherence(uint16_t k);
+
+    virtual void update(void);
+
+private:
+    void doFFT2(void);
+    volatile bool running;
+    volatile bool done;
+    uint16_t nTarget;
+    volatile uint16_t nFrames;
+    struct fft2Work *wk;          // The work RAM
+    uint16_t nTime;
+    // |X|^2 to the fft1024p power scale, inputs +/-1.0 full scale
+    const float32_t frameScale = 1.0f/262144.0f;
+    audio_block_t *inputQueueArray[2];
+    arm_cfft_radix4_instance_f32 fft_inst;
+};
+#endif
@@ -0,0 +1,69 @@
+/*
+ *  analyze_harmonics_p.cpp
+ *  Harmonic amplitude measurement for the AVNA.  See analyze_harmonics_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_harmonics_p.h"
+#include "../perfR2/perfR2.h"
+
+// Interpolated sine of a 32-bit phase, q15 result
+static inline int32_t sineQ15(uint32_t ph)
+{
+    uint32_t idx = ph >> 24;
+    uint32_t scale = (ph >> 8) & 0xFFFF;
+    int32_t v1 = AudioWaveformSine[idx] * (0x10000 - scale);
+    int32_t v2 = AudioWaveformSine[idx+1] * scale;
+    return (v1 + v2) >> 16;
+}
+
+void AudioAnalyzeHarmonics_p::update(void)
+{
+    audio_block_t *block;
+    uint32_t ph;
+    int32_t x;
+    uint32_t tPerf = perfStart();
+
+    block = receiveReadOnly();
+    if (!block) return;
+    if (!running) {
+        release(block);
+        return;
+    }
+
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES && nCount<nTarget; i++) {
+        x = block->data[i];
+        for (int k=1; k<=HARM_MAX; k++) {
+            ph = (uint32_t)k * phaseAcc;     // Wraps, exact k*f
+            sumI[k] += (int64_t)(x * sineQ15(ph + 0x40000000));
+            sumQ[k] += (int64_t)(x * sineQ15(ph));
+        }
+        phaseAcc += phaseInc;
+        nCount++;
+    }
+    if (nCount >= nTarget) {
+        running = false;
+        done = true;
+    }
+    release(block);
+    perfStop(PERF_HARM_UPDATE, tPerf);
+}
@@ -0,0 +1,106 @@
+/*
+ *  analyze_harmonics_p.h
+ *  Harmonic amplitude measurement for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Lock-in detector for the fundamental and harmonics 2 to HARM_MAX of a known
+ * frequency.  One phase accumulator runs at f and the k'th LO phase is k times
+ * it, so all LO's are exactly coherent.  Each sample is multiplied by cos and
+ * sin of each LO (interpolated sine table, as AudioSynthWaveformSine) and summed
+ * in int64, so the sums are exact.
+ *
+ * start(f, sampleRate, nSamples) arms the detector; it begins with the next
+ * audio block and stops after exactly nSamples.  If nSamples is a whole number
+ * of periods of f (as modifyFreq() arranges for the AVNA) the 2kf mixer products
+ * cancel.  Call start() with audio interrupts off, at the same time as the
+ * record queues begin, and the same samples are used as for the fundamental.
+ *
+ * available() is true when nSamples have been summed.  amplitude(k) is the
+ * peak amplitude of harmonic k, 1.0 for full scale, and k=1 is the fundamental.
+ *
+ * When not started update() only releases the block.  While running, about
+ * 4% of a Teensy 3.6 at 100 kHz sample rate.
+ */
+
+#ifndef analyze_harmonics_p_h_
+#define analyze_harmonics_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+#define HARM_MAX 5
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+class AudioAnalyzeHarmonics_p : public AudioStream
+{
+public:
+    AudioAnalyzeHarmonics_p() : AudioStream(1, inputQueueArray) {
+        running = false;
+        done = false;
+    }
+
+    void start(float32_t _freq, float32_t _sampleRate, uint32_t _nSamples) {
+        phaseInc = (uint32_t)(4294967296.0*(double)_freq/(double)_sampleRate);
+        phaseAcc = 0;
+        nTarget = _nSamples;
+        nCount = 0;
+        for (int k=0; k<=HARM_MAX; k++) {
+            sumI[k] = 0;
+            sumQ[k] = 0;
+        }
+        done = false;
+        running = (nTarget > 0);
+    }
+
+    void stop(void) {
+        running = false;
+    }
+
+    bool available(void) {
+        return done;
+    }
+
+    float32_t amplitude(uint16_t k) {
+        float32_t fi, fq;
+        if (k<1 || k>HARM_MAX || nCount==0) return 0.0f;
+        // Sample (1/32768) times sine table (1/32768), times 2 for peak
+        fi = (float32_t)sumI[k];
+        fq = (float32_t)sumQ[k];
+        return 2.0f*sqrtf(fi*fi + fq*fq)/(1073741824.0f*(float32_t)nCount);
+    }
+
+    virtual void update(void);
+
+private:
+    volatile bool running;
+    volatile bool done;
+    uint32_t phaseAcc, phaseInc;
+    uint32_t nTarget, nCount;
+    int64_t sumI[HARM_MAX+1], sumQ[HARM_MAX+1];   // Index is harmonic number
+    audio_block_t *inputQueueArray[1];
+};
+#endif
@@ -0,0 +1,134 @@
+/*
+ *  analyze_lockin_p.cpp
+ *  Continuous decimated lock-in for the AVNA.  See analyze_lockin_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_lockin_p.h"
+#include "../perfR2/perfR2.h"
+#include "../sumR2/sumR2.h"
+
+void AudioAnalyzeLockIn_p::begin(uint16_t _rCIC)
+{
+    if (_rCIC < 2)
+        _rCIC = 2;
+    else if (_rCIC > LOCKIN_R_MAX)
+        _rCIC = LOCKIN_R_MAX;
+    rCIC = _rCIC;
+    // CIC gain is R^3
+    cicScale = 1.0f/((float32_t)rCIC*(float32_t)rCIC*(float32_t)rCIC);
+    for (int k=0; k<4; k++) {
+        for (int i=0; i<3; i++) {
+            integ[k][i] = 0;
+            comb[k][i] = 0;
+        }
+    }
+    cicCount = 0;
+    nOut = 0;
+    nLost = 0;
+    head = 0;
+    tail = 0;
+    blockSums = false;
+    running = true;
+}
+
+void AudioAnalyzeLockIn_p::beginBlockSums(void)
+{
+    rCIC = AUDIO_BLOCK_SAMPLES;
+    nOut = 0;
+    nLost = 0;
+    head = 0;
+    tail = 0;
+    blockSums = true;
+    running = true;
+}
+
+// Output nOut to the ring, or count it lost if the ring is full
+void AudioAnalyzeLockIn_p::put(float32_t *out)
+{
+    uint16_t next = (head + 1) % LOCKIN_RING;
+
+    if (next == tail) {
+        nLost++;
+        return;
+    }
+    ring[head].n = nOut;
+    for (int k=0; k<4; k++)
+        ring[head].v[k] = out[k];
+    head = next;
+}
+
+void AudioAnalyzeLockIn_p::update(void)
+{
+    audio_block_t *block[4];
+    bool ok = true;
+    uint64_t y, t1, t2;
+    float32_t out[4];
+    uint32_t tPerf = perfStart();
+
+    for (int k=0; k<4; k++) {
+        block[k] = receiveReadOnly(k);
+        if (!block[k]) ok = false;
+    }
+    if (!running || !ok) {
+        for (int k=0; k<4; k++)
+            if (block[k]) release(block[k]);
+        return;
+    }
+
+    if (blockSums) {
+        // |sum| <= 2^22, so the float is exact
+        for (int k=0; k<4; k++) {
+            out[k] = (float32_t)sumInt16(block[k]->data, AUDIO_BLOCK_SAMPLES, 0);
+            release(block[k]);
+        }
+        put(out);
+        nOut++;
+        perfStop(PERF_LOCKIN_UPDATE, tPerf);
+        return;
+    }
+
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+        for (int k=0; k<4; k++) {
+            integ[k][0] += (uint64_t)(int64_t)block[k]->data[i];
+            integ[k][1] += integ[k][0];
+            integ[k][2] += integ[k][1];
+        }
+        if (++cicCount < rCIC)
+            continue;
+        cicCount = 0;
+
+        for (int k=0; k<4; k++) {
+            y = integ[k][2];
+            t1 = y - comb[k][0];   comb[k][0] = y;
+            t2 = t1 - comb[k][1];  comb[k][1] = t1;
+            out[k] = cicScale*(float32_t)(int64_t)(t2 - comb[k][2]);
+            comb[k][2] = t2;
+        }
+        if (nOut >= 2)               // Combs are full
+            put(out);
+        nOut++;
+    }
+    for (int k=0; k<4; k++)
+        release(block[k]);
+    perfStop(PERF_LOCKIN_UPDATE, tPerf);
+}
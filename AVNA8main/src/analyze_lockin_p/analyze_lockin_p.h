@@ -0,0 +1,115 @@
+/*
+ *  analyze_lockin_p.h
+ *  Continuous decimated lock-in output for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Continuous lock-in output.  The four inputs are the mixer outputs that
+ * also go to queueNN[0] to [3], Q, I, RQ and RI.  Each is decimated by R
+ * in a 3rd order CIC, so an output is a weighted average of the last 3R
+ * products and is in the same units as superAveNN[].  The CIC has zeros
+ * at multiples of sampleRate/R, and the 2f mixer product is down by at
+ * least 3*20*log10(2f*R/(pi*sampleRate)) dB, so the output rate should be
+ * well below f.  Integrators are uint64_t so that wrap-around is exact.
+ *
+ * begin(R) starts with the next audio block, with audio interrupts off.
+ * The first 2 outputs, while the combs fill, are dropped.  Outputs go to
+ * a ring of LOCKIN_RING lockInSample's, each with its output number n,
+ * so the time of the end of its averaging window is (n+1)*R/sampleRate
+ * after begin().  loop() takes them with read().  If the ring is full
+ * the new output is counted by lost() and dropped, and n shows the gap.
+ *
+ * beginBlockSums() is the sliding VVM mode.  There is no CIC, each output
+ * is the plain sum of one audio block, exact as an integer in the float,
+ * and n is the block number.  No audio blocks are held in either mode, so
+ * the ring, not AudioMemory(), takes up a late loop().
+ *
+ * R is 2 to LOCKIN_R_MAX.  Not running, update() only releases the blocks.
+ * Running, about 2% of a Teensy 3.6 at 100 kHz sample rate.  RAM is
+ * about 5 kBytes.
+ */
+
+#ifndef analyze_lockin_p_h_
+#define analyze_lockin_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+#define LOCKIN_RING 256
+#define LOCKIN_R_MAX 20000
+
+struct lockInSample {
+    uint32_t n;              // Output number since begin()
+    float32_t v[4];          // Q, I, RQ, RI, as superAveNN[]
+};
+
+class AudioAnalyzeLockIn_p : public AudioStream
+{
+public:
+    AudioAnalyzeLockIn_p() : AudioStream(4, inputQueueArray) {
+        running = false;
+        blockSums = false;
+        head = 0;
+        tail = 0;
+    }
+
+    void begin(uint16_t _rCIC);
+
+    void beginBlockSums(void);
+
+    void end(void) {
+        running = false;
+    }
+
+    uint16_t available(void) {
+        return (head - tail + LOCKIN_RING) % LOCKIN_RING;
+    }
+
+    bool read(struct lockInSample *s) {
+        uint16_t t = tail;
+        if (t == head) return false;
+        *s = ring[t];
+        tail = (t + 1) % LOCKIN_RING;
+        return true;
+    }
+
+    uint32_t lost(void) {
+        return nLost;
+    }
+
+    virtual void update(void);
+
+private:
+    volatile bool running;
+    bool blockSums;
+    volatile uint16_t head, tail;    // update() moves head, read() moves tail
+    volatile uint32_t nLost;
+    uint16_t rCIC, cicCount;
+    uint32_t nOut;
+    float32_t cicScale;
+    uint64_t integ[4][3], comb[4][3];
+    struct lockInSample ring[LOCKIN_RING];
+    audio_block_t *inputQueueArray[4];
+    void put(float32_t *out);
+};
+#endif
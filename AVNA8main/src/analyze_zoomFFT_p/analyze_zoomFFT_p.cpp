@@ -0,0 +1,200 @@
+/*
+ *  analyze_zoomFFT_p.cpp
+ *  Zoom FFT for the AVNA Spectrum Analyzer.  See analyze_zoomFFT_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_zoomFFT_p.h"
+#include "../perfR2/perfR2.h"
+
+void AudioAnalyzeZoomFFT_p::setZoom(uint16_t _zoom, float32_t _fCenter, float32_t _sampleRate,
+                                    void *work)
+{
+    float32_t fc, m, wb, sum, f, x, hc, fn, re, im;
+
+    snap.take();                  // Drop any spectrum from the old setting
+    if (_zoom < 2 || work == NULL) {
+        zoom = 0;
+        return;
+    }
+    timeData = (float32_t *)work;
+    fftBuffer = timeData + 2048;
+    correction = fftBuffer + 2048;
+    if (_zoom > ZOOM_MAX)
+        _zoom = ZOOM_MAX;
+    zoom = _zoom & 0XFFFE;        // Even only
+    rCIC = zoom/2;
+    fCenter = _fCenter;
+    binHz = _sampleRate/(1024.0f*(float32_t)zoom);
+    fStart = fCenter - 256.0f*binHz;
+    phaseInc = (uint32_t)(4294967296.0*(double)fCenter/(double)_sampleRate);
+    phaseAcc = 0;
+
+    for (int i=0; i<3; i++) {
+        intI[i] = 0;  intQ[i] = 0;
+        combI[i] = 0; combQ[i] = 0;
+    }
+    cicCount = 0;
+    // CIC gain is R^3.  Mixer output is 2*x in q15, so this also normalizes to 1.0
+    cicScale = 1.0f/((float32_t)rCIC*(float32_t)rCIC*(float32_t)rCIC*32768.0f);
+
+    // Windowed sinc, cutoff at 1/4 of CIC output rate, Blackman window.
+    // Passband +/-1/8 is all that is used, and aliases come from beyond 3/8.
+    fc = 0.25f;
+    sum = 0.0f;
+    for (int n=0; n<ZOOM_FIR_TAPS; n++) {
+        m = (float32_t)n - 0.5f*(float32_t)(ZOOM_FIR_TAPS - 1);
+        wb = 0.42f - 0.5f*cosf(2.0f*PI*(float32_t)n/(float32_t)(ZOOM_FIR_TAPS - 1))
+                   + 0.08f*cosf(4.0f*PI*(float32_t)n/(float32_t)(ZOOM_FIR_TAPS - 1));
+        firCoeff[n] = wb*sinf(2.0f*PI*fc*m)/(PI*m);
+        sum += firCoeff[n];
+    }
+    for (int n=0; n<ZOOM_FIR_TAPS; n++)
+        firCoeff[n] /= sum;             // Unity gain at DC
+    for (int n=0; n<2*ZOOM_FIR_TAPS; n++) {
+        firI[n] = 0.0f;  firQ[n] = 0.0f;
+    }
+    firIndex = 0;
+    firPhase = false;
+    nTime = 0;
+
+    // Power correction for each output bin.  Removes the CIC and FIR droop and
+    // includes the 1/1024^2 that makes the scale match AudioAnalyzeFFT1024_p.
+    for (int j=0; j<512; j++) {
+        f = (float32_t)(j - 256)*binHz;          // Offset from fCenter
+        x = PI*f/_sampleRate;
+        if (j == 256 || rCIC == 1)
+            hc = 1.0f;
+        else
+            hc = sinf((float32_t)rCIC*x)/((float32_t)rCIC*sinf(x));
+        hc = hc*hc*hc;
+        fn = 2.0f*PI*f*(float32_t)rCIC/_sampleRate;   // Radians per CIC output sample
+        re = 0.0f;  im = 0.0f;
+        for (int n=0; n<ZOOM_FIR_TAPS; n++) {
+            re += firCoeff[n]*cosf(fn*(float32_t)n);
+            im += firCoeff[n]*sinf(fn*(float32_t)n);
+        }
+        correction[j] = 1.0f/(1048576.0f*hc*hc*(re*re + im*im));
+    }
+}
+
+void AudioAnalyzeZoomFFT_p::update(void)
+{
+    audio_block_t *block;
+    uint32_t idx, scale, ph;
+    int32_t x, s, c, v1, v2;
+    uint64_t y, t1, t2;
+    float32_t fi, fq, accI, accQ;
+    uint32_t tPerf = perfStart();
+
+    block = receiveReadOnly();
+    if (!block) return;
+    if (zoom == 0) {
+        release(block);
+        return;
+    }
+
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+        x = block->data[i];
+        // Interpolated sine table, as in AudioSynthWaveformSine
+        ph = phaseAcc;
+        idx = ph >> 24;
+        scale = (ph >> 8) & 0xFFFF;
+        v1 = AudioWaveformSine[idx] * (0x10000 - scale);
+        v2 = AudioWaveformSine[idx+1] * scale;
+        s = (v1 + v2) >> 16;
+        ph += 0x40000000;
+        idx = ph >> 24;
+        scale = (ph >> 8) & 0xFFFF;
+        v1 = AudioWaveformSine[idx] * (0x10000 - scale);
+        v2 = AudioWaveformSine[idx+1] * scale;
+        c = (v1 + v2) >> 16;
+        phaseAcc += phaseInc;
+
+        // Mix down by fCenter, times 2 to keep the amplitude of the one sideband.
+        // CIC integrators are unsigned so that wrap-around is defined.
+        intI[0] += (uint64_t)(int64_t)((x*c) >> 14);
+        intI[1] += intI[0];
+        intI[2] += intI[1];
+        intQ[0] += (uint64_t)(int64_t)(-(x*s) >> 14);
+        intQ[1] += intQ[0];
+        intQ[2] += intQ[1];
+        if (++cicCount < rCIC)
+            continue;
+        cicCount = 0;
+
+        y = intI[2];
+        t1 = y - combI[0];   combI[0] = y;
+        t2 = t1 - combI[1];  combI[1] = t1;
+        fi = cicScale*(float32_t)(int64_t)(t2 - combI[2]);  combI[2] = t2;
+        y = intQ[2];
+        t1 = y - combQ[0];   combQ[0] = y;
+        t2 = t1 - combQ[1];  combQ[1] = t1;
+        fq = cicScale*(float32_t)(int64_t)(t2 - combQ[2]);  combQ[2] = t2;
+
+        // FIR, decimate by 2.  Coefficients are symmetric, so no reversal.
+        firI[firIndex] = fi;  firI[firIndex + ZOOM_FIR_TAPS] = fi;
+        firQ[firIndex] = fq;  firQ[firIndex + ZOOM_FIR_TAPS] = fq;
+        if (++firIndex >= ZOOM_FIR_TAPS)
+            firIndex = 0;
+        firPhase = !firPhase;
+        if (!firPhase)
+            continue;
+        accI = 0.0f;  accQ = 0.0f;
+        for (int n=0; n<ZOOM_FIR_TAPS; n++) {
+            accI += firCoeff[n]*firI[firIndex + n];
+            accQ += firCoeff[n]*firQ[firIndex + n];
+        }
+        timeData[2*nTime] = accI;
+        timeData[2*nTime + 1] = accQ;
+        if (++nTime >= 1024) {
+            doZoomFFT();
+            // 50% overlap, keep the newest 512 complex points
+            memcpy(timeData, timeData + 1024, 1024*sizeof(float32_t));
+            nTime = 512;
+        }
+    }
+    release(block);
+    perfStop(PERF_ZOOM_UPDATE, tPerf);
+}
+
+void AudioAnalyzeZoomFFT_p::doZoomFFT(void)
+{
+    float32_t w, re, im;
+    float32_t *output = snap.writeBuffer();
+    int k;
+
+    for (int i=0; i<1024; i++) {
+        w = 3.0517578E-5f*(float32_t)AudioWindowHanning1024[i];
+        fftBuffer[2*i] = w*timeData[2*i];
+        fftBuffer[2*i + 1] = w*timeData[2*i + 1];
+    }
+    arm_cfft_radix4_f32(&fft_inst, fftBuffer);
+    // Center 512 bins, negative frequencies first
+    for (int j=0; j<512; j++) {
+        k = (j + 768) & 1023;
+        re = fftBuffer[2*k];
+        im = fftBuffer[2*k + 1];
+        output[j] = (re*re + im*im)*correction[j];
+    }
+    snap.publish();
+}
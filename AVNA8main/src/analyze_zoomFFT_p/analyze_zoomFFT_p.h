@@ -0,0 +1,128 @@
+/*
+ *  analyze_zoomFFT_p.h
+ *  Zoom FFT for the AVNA Spectrum Analyzer
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* This is a narrow-span companion to AudioAnalyzeFFT1024_p.  The input is
+ * mixed to zero frequency by a quadrature NCO centered on fCenter, decimated
+ * by R in a 3rd order CIC, then by 2 more in a 32 tap FIR.  The complex
+ * result goes to a 1024 point float FFT, Hann window, 50% overlap.
+ * The center 512 bins (the flat part of the decimation filters) are the
+ * output, with bin 0 at fCenter - span/2.  Bin spacing is
+ *       sampleRate/(1024*zoom)   where zoom = 2*R,
+ * so the span is 512 of these.  The output is power, corrected for
+ * the CIC and FIR droop, and scaled the same as AudioAnalyzeFFT1024_p
+ * so that the same cal constants apply.
+ *
+ * Use setZoom(zoom, fCenter, sampleRate, work) with audio interrupts off.
+ * zoom is even, 2 to 256.  zoom=0 turns the object off, and update() then
+ * only releases the input block.  The sample rate is needed since
+ * the AVNA changes it on the fly.  work is ZOOM_WORK_BYTES of RAM for the
+ * time data, FFT and droop correction, 4-byte aligned, that the object
+ * uses until the next setZoom(0, ...).
+ *
+ * The FFT is done in update(), as in AudioAnalyzeFFT1024_p, but only
+ * every 512 decimated samples, i.e., every zoom/2 input blocks at most.
+ *
+ * The output is triple buffered as in AudioAnalyzeFFT1024_p, see snapR2.h.
+ *
+ * RAM is ZOOM_WORK_BYTES, 18 kBytes, of work plus about 7 kBytes.
+ */
+
+#ifndef analyze_zoomFFT_p_h_
+#define analyze_zoomFFT_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+#include "../snapR2/snapR2.h"
+
+#define ZOOM_FIR_TAPS 32
+#define ZOOM_MAX 256
+#define ZOOM_WORK_BYTES (4*(2048 + 2048 + 512))
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+extern const int16_t AudioWindowHanning1024[];
+}
+
+class AudioAnalyzeZoomFFT_p : public AudioStream
+{
+public:
+    AudioAnalyzeZoomFFT_p() : AudioStream(1, inputQueueArray) {
+        zoom = 0;
+        arm_cfft_radix4_init_f32(&fft_inst, 1024, 0, 1);
+    }
+
+    void setZoom(uint16_t _zoom, float32_t _fCenter, float32_t _sampleRate,
+                 void *work = NULL);
+
+    bool available() {
+        return snap.take();
+    }
+
+    float read(unsigned int binNumber) {
+        if (binNumber > 511) return 0.0;
+        return snap.readBuffer()[binNumber];
+    }
+
+    // All 512 bins of the spectrum from the last available()
+    const float32_t *getOutput(void) { return snap.readBuffer(); }
+    uint32_t frames(void)             { return snap.frames(); }
+    uint32_t lost(void)               { return snap.lost(); }
+    void clearCounts(void)            { snap.clearCounts(); }
+
+    // Frequency of output bin 0, and the bin spacing, both Hz
+    float32_t getStartFreq(void)  { return fStart; }
+    float32_t getBinHz(void)      { return binHz; }
+    uint16_t getZoom(void)        { return zoom; }
+
+    virtual void update(void);
+
+private:
+    uint16_t zoom;            // 0 is off
+    uint16_t rCIC;            // zoom/2
+    float32_t fCenter, fStart, binHz;
+    uint32_t phaseAcc, phaseInc;
+    // CIC state, order 3, differential delay 1.  Unsigned so that the
+    // integrator wrap-around is defined, signed again after the combs.
+    uint64_t intI[3], intQ[3], combI[3], combQ[3];
+    uint16_t cicCount;
+    float32_t cicScale;
+    // FIR decimate by 2, delay line doubled to avoid wrap in the MAC
+    float32_t firCoeff[ZOOM_FIR_TAPS];
+    float32_t firI[2*ZOOM_FIR_TAPS], firQ[2*ZOOM_FIR_TAPS];
+    uint16_t firIndex;
+    bool firPhase;
+    // In the work RAM.  Decimated complex time data, interleaved re, im,
+    // 2048, then fftBuffer 2048 and correction 512.
+    float32_t *timeData;
+    uint16_t nTime;
+    float32_t *fftBuffer;
+    float32_t *correction;
+    SpecSnap snap;
+    audio_block_t *inputQueueArray[1];
+    arm_cfft_radix4_instance_f32 fft_inst;
+    void doZoomFFT(void);
+};
+#endif
@@ -0,0 +1,180 @@
+/*
+ *  benchR2.cpp
+ *  Fixed data timing of the DSP kernels and the float formatting
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "benchR2.h"
+#include "../sumR2/sumR2.h"
+#include "../formatR2/formatR2.h"
+#include "utility/dspinst.h"
+
+extern "C" {
+extern const int16_t AudioWindowHanning1024[];
+}
+
+#define BENCH_SEED 1357246891UL
+
+uint32_t benchInputs(struct benchWork *bw)
+{
+    uint32_t seed = BENCH_SEED;
+
+    for (int i=0; i<1024; i++) {
+        seed = 1664525UL*seed + 1013904223UL;     // Same LCG as the noise generator
+        bw->fftIn[i] = (int16_t)(seed >> 18) - 8192;
+    }
+    for (int i=0; i<512; i++) {
+        seed = 1664525UL*seed + 1013904223UL;
+        bw->power[i] = 1.0E-12f + (float32_t)(seed >> 8)*5.96E-8f*1.0E-3f;
+    }
+    return seed;
+}
+
+void benchHeader(Print &p, uint16_t n)
+{
+    p.print("Benchmark, n=");
+    p.print(n);
+    p.print(", F_CPU=");
+    p.println(F_CPU);
+    p.println("Kernel, count, min us, ave us, max us");
+}
+
+void benchDSP(Print &p, struct benchWork *bw, uint16_t n, AudioSynthNoiseGaussian &noise)
+{
+    struct perfStage ps;
+    arm_cfft_radix4_instance_q15 fftInst;
+    uint32_t t0;
+    float32_t sum = 0.0f;
+    int64_t sum64 = 0;
+    double sumD = 0.0;
+
+    arm_cfft_radix4_init_q15(&fftInst, 1024, 0, 1);
+
+    // AudioAnalyzeFFT1024_p::update(), in its three parts
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        for (int j=0; j<1024; j++) {
+            bw->fftBuf[2*j] = (int16_t)(((int32_t)bw->fftIn[j]*(int32_t)AudioWindowHanning1024[j]) >> 15);
+            bw->fftBuf[2*j+1] = 0;
+        }
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "FFT1024 window", &ps, false);
+
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        for (int j=0; j<1024; j++) {    // In place, so fresh data each time
+            bw->fftBuf[2*j] = bw->fftIn[j];
+            bw->fftBuf[2*j+1] = 0;
+        }
+        t0 = perfStart();
+        arm_cfft_radix4_q15(&fftInst, bw->fftBuf);
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "FFT1024 cfft q15", &ps, false);
+
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        for (int j=0; j<512; j++) {
+            uint32_t tmp = *((uint32_t *)bw->fftBuf + j);
+            uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
+            bw->fftMag[j] = 3.72529E-9*(float32_t)magsq;
+        }
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "FFT1024 power", &ps, false);
+
+    // Gaussian noise, one audio block
+    noise.amplitude(0.1f);
+    noise.setSeed(BENCH_SEED);
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        noise.fillBlock(bw->noiseOut);
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "Noise block", &ps, false);
+
+    // I/Q accumulation, one of the 4 channels, 256 samples.  The float sum
+    // and double add per block, as before sumInt16(), and the int64 sum.
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        sum = sumSamples(&bw->fftIn[256*(i & 3)], 256);
+        sumD += (double)sum;
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "I/Q sum 256 float", &ps, false);
+
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        sum64 = sumInt16(&bw->fftIn[256*(i & 3)], 256, sum64);
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "I/Q sum 256 SMLALD", &ps, false);
+    if ((double)sum64 != sumD)
+        p.println("Error: I/Q sums do not agree");
+
+    // Keep the results "used" so none of the work is optimized away
+    if (sum == 1.2345f || bw->fftMag[1] < 0.0f || bw->noiseOut[0] == 12345)
+        p.println("");
+}
+
+// The float formatting alone, Print against formatR2, 512 values
+void benchFormat(Print &p, struct benchWork *bw, uint16_t n)
+{
+    struct perfStage ps;
+    PerfNullPrint nullOut;
+    uint32_t t0;
+    char fbuf[24];
+
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        for (int j=0; j<512; j++)
+            nullOut.print(bw->power[j], 8);
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "Print float x512", &ps, false);
+
+    perfStageClear(&ps);
+    for (uint16_t i=0; i<n; i++) {
+        t0 = perfStart();
+        for (int j=0; j<512; j++)
+            if (formatFloat(fbuf, bw->power[j], 8) == 0)
+                nullOut.print(bw->power[j], 8);
+        perfStageAdd(&ps, t0);
+    }
+    perfPrintStage(p, "formatFloat x512", &ps, false);
+}
+
+float32_t sumSamples(const int16_t *pd, uint16_t npts)
+{
+    float32_t sum = 0.0f;
+
+    for (uint16_t i = 0; i < npts; i++)
+        sum += (float32_t)pd[i];
+    return sum;
+}
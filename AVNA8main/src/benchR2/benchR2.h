@@ -0,0 +1,68 @@
+/*
+ *  benchR2.h
+ *  Fixed data timing of the DSP kernels and the float formatting
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* The BENCH command kernels that need nothing from the sketch, so that
+ * tools/benchHost.cpp can run the same code on the same data on a PC.
+ * benchInputs() fills the work with fixed seed random numbers, the same
+ * every run and every release.  benchDSP() times the FFT1024 window, the
+ * q15 FFT and the power, a noise block and the two I/Q sums, and
+ * benchFormat() the float formatting, Print against formatFloat().  Each
+ * prints one CSV line per kernel, as perfPrintStage(),
+ *     name, count, min us, ave us, max us
+ *
+ * The caller supplies BENCH_WORK_BYTES of RAM, 4-byte aligned, only needed
+ * while BENCH runs.  On the Teensy this is the sketch work area.
+ */
+
+#ifndef benchR2_h_
+#define benchR2_h_
+
+#include "Arduino.h"
+#include "arm_math.h"
+#include "../perfR2/perfR2.h"
+#include "../synth_GaussianWhiteNoiseR2/synth_GaussianWhiteNoiseR2.h"
+
+struct benchWork {
+    int16_t fftBuf[2048];          // Complex q15, as in AudioAnalyzeFFT1024_p
+    int16_t fftIn[1024];           // About -18 dBFS
+    int16_t noiseOut[128];
+    float32_t fftMag[512];
+    float32_t power[512];          // A made up ASA spectrum
+};
+#define BENCH_WORK_BYTES sizeof(struct benchWork)
+
+// Returns the seed, to go on with for the kernels of the sketch
+uint32_t benchInputs(struct benchWork *bw);
+
+void benchHeader(Print &p, uint16_t n);
+
+void benchDSP(Print &p, struct benchWork *bw, uint16_t n, AudioSynthNoiseGaussian &noise);
+
+void benchFormat(Print &p, struct benchWork *bw, uint16_t n);
+
+// The float I/Q accumulation that get2blockSum() replaced.  Exact, as 256
+// samples sum to less than 2^24, but slower.
+float32_t sumSamples(const int16_t *pd, uint16_t npts);
+#endif
@@ -0,0 +1,61 @@
+/*
+ *  binFrameR2.cpp
+ *  Binary data frames for the AVNA serial output.  See binFrameR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "binFrameR2.h"
+
+// CRC-32, polynomial 0xEDB88320 reflected, a nibble at a time
+static const uint32_t crcNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+
+uint32_t crc32R2(uint32_t crc, const uint8_t *data, uint32_t n)
+{
+    crc = ~crc;
+    while (n-- > 0) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+void BinFrame::begin(uint8_t type, uint16_t count, uint16_t itemBytes,
+                     float axis0, float axis1)
+{
+    uint8_t h[16];
+
+    h[0] = 'A';
+    h[1] = 'V';
+    h[2] = BF_VERSION;
+    h[3] = type;
+    memcpy(h + 4, &count, 2);
+    memcpy(h + 6, &itemBytes, 2);
+    memcpy(h + 8, &axis0, 4);
+    memcpy(h + 12, &axis1, 4);
+    crc = 0;
+    add(h, 16);
+}
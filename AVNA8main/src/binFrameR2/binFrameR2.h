@@ -0,0 +1,107 @@
+/*
+ *  binFrameR2.h
+ *  Binary data frames for the AVNA serial output
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* A binary alternative to the text output, selected by the BINARY command.
+ * Each frame is, all little-endian:
+ *     offset  size
+ *        0     2    Sync, 'A' 'V'
+ *        2     1    Version, BF_VERSION
+ *        3     1    Type, BF_xxx below
+ *        4     2    count, number of items in the payload
+ *        6     2    bytes per item
+ *        8     4    float32 axis0, see type
+ *       12     4    float32 axis1, see type
+ *       16     n    payload, count items
+ *     16+n     4    CRC-32 (as zlib crc32()) of bytes 0 to 16+n-1
+ * The types are:
+ *   BF_SPECTRUM_F32  float32 power per bin. axis0 = freq of bin 0, axis1 = Hz/bin
+ *   BF_SPECTRUM_CDB  int16 power per bin, 0.01 dB.  Axes as above
+ *   BF_S11           float32 re, im pairs.  Axes 0, see BF_FREQ for freqs
+ *   BF_S21           float32 re, im pairs.  Axes 0
+ *   BF_FREQ          float32 Hz per point.  Axes 0
+ *   BF_Z             One point of float32 R, X, G, B, L or C series,
+ *                    L or C parallel, Q.  axis0 = freq Hz
+ *   BF_SWEEP_PT      One STREAMSWEEP point, float32 re S11, im S11, re S21,
+ *                    im S21.  axis0 = freq Hz, axis1 = point index
+ *   BF_TF            float32 re, im, coherence of the TFNOISE transfer
+ *                    function per bin.  axis0 = freq of bin 0, axis1 = Hz/bin
+ *   BF_XSPEC         float32 Gxx, Gyy, re Gxy, im Gxy, coherence per bin of the
+ *                    ASA dual channel mode, x reference and y measure.  Powers
+ *                    are scaled as BF_SPECTRUM_F32.  Axes as BF_SPECTRUM_F32
+ * Text, like "ch> " or the DIST line, may be between frames.  A reader
+ * looks for the sync, checks the CRC and otherwise skips a byte.
+ * tools/avnaBinDecode.py in the repository decodes these.
+ *
+ * Usage:
+ *     BinFrame bf(Serial);
+ *     bf.begin(BF_FREQ, n, sizeof(float), 0.0f, 0.0f);
+ *     bf.add(dataFreq, n*sizeof(float));    // Any number of add()'s
+ *     bf.end();
+ */
+
+#ifndef binFrameR2_h_
+#define binFrameR2_h_
+
+#include "Arduino.h"
+
+#define BF_VERSION        1
+#define BF_SPECTRUM_F32   1
+#define BF_SPECTRUM_CDB   2
+#define BF_S11            3
+#define BF_S21            4
+#define BF_FREQ           5
+#define BF_Z              6
+#define BF_SWEEP_PT       7
+#define BF_TF             8
+#define BF_XSPEC          9
+
+// Update a zlib style CRC-32.  Start with crc=0.
+uint32_t crc32R2(uint32_t crc, const uint8_t *data, uint32_t n);
+
+class BinFrame
+{
+public:
+    BinFrame(Print &_p) {
+        p = &_p;
+        crc = 0;
+    }
+
+    void begin(uint8_t type, uint16_t count, uint16_t itemBytes,
+               float axis0, float axis1);
+
+    void add(const void *data, uint32_t n) {
+        crc = crc32R2(crc, (const uint8_t *)data, n);
+        p->write((const uint8_t *)data, n);
+    }
+
+    void end(void) {
+        p->write((const uint8_t *)&crc, 4);   // Little-endian ARM
+    }
+
+private:
+    Print *p;
+    uint32_t crc;
+};
+#endif
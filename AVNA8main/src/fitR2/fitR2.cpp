@@ -0,0 +1,400 @@
+/*
+ *  fitR2.cpp
+ *  Equivalent circuit fitting for the AVNA.  See fitR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "fitR2.h"
+#include <math.h>
+
+#define FIT_H     1.0E-5f       // Relative step of p for the Jacobian
+#define FIT_TINY  1.0E-30f
+
+static const uint16_t nParams[FIT_N_MODELS] = {3, 3, 3, 5, 4};
+static const char *modelNames[FIT_N_MODELS] = {
+    "Series RLC", "Parallel RLC", "R+L||C", "Speaker", "Crystal"};
+static const char *paramNames[FIT_N_MODELS][FIT_MAX_PARAMS] = {
+    {"R", "L", "C", "", ""},
+    {"R", "L", "C", "", ""},
+    {"R", "L", "C", "", ""},
+    {"Re", "Le", "Res", "Lces", "Cmes"},
+    {"R1", "L1", "C1", "C0", ""}};
+
+uint16_t fitNParams(uint16_t model)
+{
+    return (model < FIT_N_MODELS) ? nParams[model] : 0;
+}
+
+const char *fitModelName(uint16_t model)
+{
+    return (model < FIT_N_MODELS) ? modelNames[model] : "";
+}
+
+const char *fitParamName(uint16_t model, uint16_t k)
+{
+    return (model < FIT_N_MODELS && k < FIT_MAX_PARAMS) ? paramNames[model][k] : "";
+}
+
+// 1/(a + jb)
+static inline void cInv(float a, float b, float *re, float *im)
+{
+    float d = a*a + b*b;
+    if (d < FIT_TINY) d = FIT_TINY;
+    *re = a/d;
+    *im = -b/d;
+}
+
+/* Inside the fit the C of each resonance is replaced by w0 = 1/sqrt(LC).
+ * Then w0 is a parameter of its own, not a product of L and C that must
+ * be right to a small part of the bandwidth, and the reactance is found as
+ * L(w - w0)(w + w0)/w, without the loss of digits of wL - 1/(wC).
+ * Index of the C, the L that goes with it, and the slot holding w0:
+ */
+static const int8_t resC[FIT_N_MODELS] = {2, 2, 2, 4, 2};
+static const int8_t resL[FIT_N_MODELS] = {1, 1, 1, 3, 1};
+
+static void toInternal(uint16_t model, const float *p, float *pi)
+{
+    for (uint16_t k = 0; k < nParams[model]; k++)
+        pi[k] = p[k];
+    pi[resC[model]] = 1.0f/sqrtf(p[resL[model]]*p[resC[model]]);
+}
+
+static void toPhysical(uint16_t model, const float *pi, float *p)
+{
+    float w0 = pi[resC[model]];
+    for (uint16_t k = 0; k < nParams[model]; k++)
+        p[k] = pi[k];
+    p[resC[model]] = 1.0f/(w0*w0*pi[resL[model]]);
+}
+
+// Z from the internal parameters.  pi[resC[model]] is w0.
+static void modelZi(uint16_t model, const float *pi, float f, float *re, float *im)
+{
+    float w = 6.2831853f*f;
+    float yr, yi, zr, zi, w0 = pi[resC[model]];
+    float dw = (w - w0)*(w + w0)/w;        // w - w0^2/w
+
+    switch (model) {
+    case FIT_SERIES_RLC:                   // R, L, w0
+        *re = pi[0];
+        *im = pi[1]*dw;
+        break;
+    case FIT_PARALLEL_RLC:                 // B = wC - 1/(wL) = dw/(w0^2 L)
+        cInv(1.0f/pi[0], dw/(w0*w0*pi[1]), re, im);
+        break;
+    case FIT_RL_PAR_C:
+        cInv(pi[0], w*pi[1], &yr, &yi);
+        cInv(yr, yi + w/(w0*w0*pi[1]), re, im);
+        break;
+    case FIT_SPEAKER:                      // Re, Le, Res, Lces, w0
+        cInv(1.0f/pi[2], dw/(w0*w0*pi[3]), &zr, &zi);
+        *re = pi[0] + zr;
+        *im = w*pi[1] + zi;
+        break;
+    case FIT_CRYSTAL:                      // R1, L1, w0, C0
+        cInv(pi[0], pi[1]*dw, &yr, &yi);
+        cInv(yr, yi + w*pi[3], re, im);
+        break;
+    default:
+        *re = 0.0f;
+        *im = 0.0f;
+    }
+}
+
+void fitModelZ(uint16_t model, const float *p, float f, float *re, float *im)
+{
+    float pi[FIT_MAX_PARAMS];
+
+    if (model >= FIT_N_MODELS) {
+        *re = 0.0f;
+        *im = 0.0f;
+        return;
+    }
+    toInternal(model, p, pi);
+    modelZi(model, pi, f, re, im);
+}
+
+// Starting values from the data, as L and C.  Series and parallel RLC are
+// linear in R, L and 1/C (or G, C and 1/L), so a least squares line gives
+// them.  The others use the ends of the data and the |Z| maximum or minimum.
+static void fitStart(uint16_t model, const float *f, const float *zRe,
+                     const float *zIm, uint16_t n, float *p)
+{
+    float w, s11 = 0.0f, s22 = 0.0f, s1x = 0.0f, s2x = 0.0f, sr = 0.0f;
+    float yr, yi, m, det, a, b, wLo, wHi, wMax, wMin;
+    uint16_t i, iLo = 0, iHi = 0, iMax = 0, iMin = 0;
+
+    for (i = 0; i < n; i++) {
+        if (f[i] < f[iLo]) iLo = i;
+        if (f[i] > f[iHi]) iHi = i;
+        m = zRe[i]*zRe[i] + zIm[i]*zIm[i];
+        if (m > zRe[iMax]*zRe[iMax] + zIm[iMax]*zIm[iMax]) iMax = i;
+        if (m < zRe[iMin]*zRe[iMin] + zIm[iMin]*zIm[iMin]) iMin = i;
+    }
+    wLo = 6.2831853f*f[iLo];
+    wHi = 6.2831853f*f[iHi];
+    wMax = 6.2831853f*f[iMax];
+    wMin = 6.2831853f*f[iMin];
+
+    if (model == FIT_SERIES_RLC || model == FIT_PARALLEL_RLC) {
+        // x = a*w - b/w, with x = X, or B of the admittance
+        for (i = 0; i < n; i++) {
+            w = 6.2831853f*f[i];
+            if (model == FIT_SERIES_RLC) {
+                yr = zRe[i];
+                yi = zIm[i];
+            } else {
+                cInv(zRe[i], zIm[i], &yr, &yi);
+            }
+            sr += yr;
+            s11 += w*w;
+            s22 += 1.0f/(w*w);
+            s1x += w*yi;
+            s2x -= yi/w;
+        }
+        sr /= (float)n;
+        det = s11*s22 - (float)n*(float)n;       // Cross term is -n
+        a = (s1x*s22 + (float)n*s2x)/det;
+        b = (s2x*s11 + (float)n*s1x)/det;
+        // A mean R (or G) that is small or negative from noise starts at
+        // 0.001 of the smallest |Z| (or |Y|), not at 0
+        if (model == FIT_SERIES_RLC) {
+            m = sqrtf(zRe[iMin]*zRe[iMin] + zIm[iMin]*zIm[iMin]) + FIT_TINY;
+            p[0] = fmaxf(sr, 1.0E-3f*m);
+            p[1] = (a > 0.0f) ? a : 1.0E-3f*m/wHi;
+            p[2] = (b > 0.0f) ? 1.0f/b : 1.0E3f/(m*wLo);
+        } else {
+            m = 1.0f/(sqrtf(zRe[iMax]*zRe[iMax] + zIm[iMax]*zIm[iMax]) + FIT_TINY);
+            p[0] = 1.0f/fmaxf(sr, 1.0E-3f*m);
+            p[2] = (a > 0.0f) ? a : 1.0E-3f*m/wHi;
+            p[1] = (b > 0.0f) ? 1.0f/b : 1.0E3f/(m*wLo);
+        }
+        return;
+    }
+
+    if (model == FIT_RL_PAR_C) {
+        p[0] = fmaxf(zRe[iLo], FIT_TINY);
+        p[1] = fmaxf(zIm[iLo]/wLo, 1.0E-12f);
+        if (iMax != iLo && iMax != iHi)
+            p[2] = 1.0f/(wMax*wMax*p[1]);
+        else                          // Resonance above the data
+            p[2] = 1.0f/(4.0f*wHi*wHi*p[1]);
+        return;
+    }
+
+    if (model == FIT_SPEAKER) {
+        // Le makes |Z| large at the top, so resonance is the R maximum
+        iMax = 0;
+        for (i = 1; i < n; i++)
+            if (zRe[i] > zRe[iMax]) iMax = i;
+        wMax = 6.2831853f*f[iMax];
+        p[0] = fmaxf(fminf(zRe[iLo], zRe[iHi]), FIT_TINY);
+        p[1] = fmaxf(zIm[iHi]/wHi, 1.0E-9f);
+        p[2] = fmaxf(zRe[iMax] - p[0], p[0]);
+        p[4] = 5.0f/(wMax*p[2]);      // Qms of 5
+        p[3] = 1.0f/(wMax*wMax*p[4]);
+        return;
+    }
+
+    // FIT_CRYSTAL, series resonance at the |Z| minimum, parallel at the max
+    p[0] = fmaxf(zRe[iMin], FIT_TINY);
+    p[3] = (zIm[iLo] < 0.0f) ? -1.0f/(wLo*zIm[iLo]) : 1.0E-12f;
+    a = (wMax > wMin) ? (wMax*wMax)/(wMin*wMin) - 1.0f : 0.01f;
+    p[2] = p[3]*a;
+    p[1] = 1.0f/(wMin*wMin*p[2]);
+}
+
+// Sum of squared residuals for internal parameters pi.  With jtj != NULL
+// also J'J and J'r, with J the derivatives for ln(pi).
+static float fitCost(uint16_t model, const float *pi, const float *f,
+                     const float *zRe, const float *zIm, uint16_t n,
+                     float *jtj, float *jtr)
+{
+    float q[FIT_MAX_PARAMS];
+    float jr[FIT_MAX_PARAMS], ji[FIT_MAX_PARAMS];
+    float mr, mi, kr, ki, rr, ri, s, cost = 0.0f;
+    uint16_t np = nParams[model], i, j, k;
+
+    if (jtj) {
+        for (k = 0; k < np*np; k++) jtj[k] = 0.0f;
+        for (k = 0; k < np; k++) jtr[k] = 0.0f;
+    }
+    for (i = 0; i < n; i++) {
+        s = sqrtf(zRe[i]*zRe[i] + zIm[i]*zIm[i]);
+        if (s < FIT_TINY)
+            continue;
+        s = 1.0f/s;
+        modelZi(model, pi, f[i], &mr, &mi);
+        rr = (mr - zRe[i])*s;
+        ri = (mi - zIm[i])*s;
+        cost += rr*rr + ri*ri;
+        if (!jtj)
+            continue;
+        for (k = 0; k < np; k++) {
+            for (j = 0; j < np; j++) q[j] = pi[j];
+            q[k] = pi[k]*(1.0f + FIT_H);
+            modelZi(model, q, f[i], &kr, &ki);
+            jr[k] = (kr - mr)*s/FIT_H;
+            ji[k] = (ki - mi)*s/FIT_H;
+        }
+        for (k = 0; k < np; k++) {
+            jtr[k] += jr[k]*rr + ji[k]*ri;
+            for (j = 0; j <= k; j++)
+                jtj[k*np + j] += jr[k]*jr[j] + ji[k]*ji[j];
+        }
+    }
+    if (jtj) {
+        for (k = 0; k < np; k++)
+            for (j = 0; j < k; j++)
+                jtj[j*np + k] = jtj[k*np + j];
+    }
+    return cost;
+}
+
+// Solves a x = b, n by n, partial pivoting.  a and b are overwritten.
+static bool fitSolve(float *a, float *b, float *x, uint16_t n)
+{
+    uint16_t i, j, k, iPiv;
+    float t;
+
+    for (k = 0; k < n; k++) {
+        iPiv = k;
+        for (i = k + 1; i < n; i++)
+            if (fabsf(a[i*n + k]) > fabsf(a[iPiv*n + k])) iPiv = i;
+        if (fabsf(a[iPiv*n + k]) < FIT_TINY)
+            return false;
+        if (iPiv != k) {
+            for (j = 0; j < n; j++) {
+                t = a[k*n + j];  a[k*n + j] = a[iPiv*n + j];  a[iPiv*n + j] = t;
+            }
+            t = b[k];  b[k] = b[iPiv];  b[iPiv] = t;
+        }
+        for (i = k + 1; i < n; i++) {
+            t = a[i*n + k]/a[k*n + k];
+            for (j = k; j < n; j++)
+                a[i*n + j] -= t*a[k*n + j];
+            b[i] -= t*b[k];
+        }
+    }
+    for (k = n; k-- > 0; ) {
+        t = b[k];
+        for (j = k + 1; j < n; j++)
+            t -= a[k*n + j]*x[j];
+        x[k] = t/a[k*n + k];
+    }
+    return true;
+}
+
+bool fitZ(uint16_t model, const float *f, const float *zRe, const float *zIm,
+          uint16_t n, FitResult *fr)
+{
+    float p[FIT_MAX_PARAMS], pi[FIT_MAX_PARAMS], pt[FIT_MAX_PARAMS];
+    float jtj[FIT_MAX_PARAMS*FIT_MAX_PARAMS], jtr[FIT_MAX_PARAMS];
+    float a[FIT_MAX_PARAMS*FIT_MAX_PARAMS], b[FIT_MAX_PARAMS], d[FIT_MAX_PARAMS];
+    float cost, costNew = 0.0f, lambda = 1.0E-3f;
+    uint16_t np, it, k, j, nTry;
+    bool better;
+
+    if (model >= FIT_N_MODELS)
+        return false;
+    np = nParams[model];
+    if (n < np)
+        return false;
+    fitStart(model, f, zRe, zIm, n, p);
+    for (k = 0; k < np; k++)
+        p[k] = fmaxf(p[k], FIT_TINY);
+    toInternal(model, p, pi);
+
+    cost = fitCost(model, pi, f, zRe, zIm, n, jtj, jtr);
+    for (it = 0; it < FIT_MAX_ITER; it++) {
+        better = false;
+        for (nTry = 0; nTry < 10 && !better; nTry++) {
+            for (k = 0; k < np; k++) {
+                for (j = 0; j < np; j++)
+                    a[k*np + j] = jtj[k*np + j];
+                a[k*np + k] += lambda*(jtj[k*np + k] + FIT_TINY);
+                b[k] = -jtr[k];
+            }
+            if (!fitSolve(a, b, d, np)) {
+                lambda *= 10.0f;
+                continue;
+            }
+            for (k = 0; k < np; k++)     // Step is in ln(p)
+                pt[k] = pi[k]*expf(fminf(fmaxf(d[k], -5.0f), 5.0f));
+            costNew = fitCost(model, pt, f, zRe, zIm, n, NULL, NULL);
+            if (costNew < cost) {
+                better = true;
+                lambda = fmaxf(0.3f*lambda, 1.0E-7f);
+            } else {
+                lambda *= 5.0f;
+            }
+        }
+        if (!better)
+            break;                  // No step makes it better, done
+        for (k = 0; k < np; k++)
+            pi[k] = pt[k];
+        if (cost - costNew < 1.0E-6f*cost) {
+            cost = costNew;
+            break;
+        }
+        cost = fitCost(model, pi, f, zRe, zIm, n, jtj, jtr);
+    }
+
+    fr->model = model;
+    fr->nParams = np;
+    fr->iterations = it;
+    fr->nPoints = n;
+    for (k = 0; k < FIT_MAX_PARAMS; k++)
+        fr->p[k] = 0.0f;
+    toPhysical(model, pi, fr->p);
+    fr->rmsPct = 100.0f*sqrtf(cost/(float)n);
+    return true;
+}
+
+bool fitBest(const float *f, const float *zRe, const float *zIm,
+             uint16_t n, FitResult *fr)
+{
+    FitResult r[FIT_N_MODELS];
+    bool ok[FIT_N_MODELS];
+    float best = 1.0E30f;
+    int16_t iBest = -1;
+    uint16_t m;
+
+    for (m = 0; m < FIT_N_MODELS; m++) {
+        ok[m] = fitZ(m, f, zRe, zIm, n, &r[m]);
+        if (ok[m] && r[m].rmsPct < best)
+            best = r[m].rmsPct;
+    }
+    // Fewest parameters that come within 25% (or 0.1%) of the best
+    for (m = 0; m < FIT_N_MODELS; m++) {
+        if (!ok[m] || r[m].rmsPct > 1.25f*best + 0.1f)
+            continue;
+        if (iBest < 0 || r[m].nParams < r[iBest].nParams ||
+              (r[m].nParams == r[iBest].nParams && r[m].rmsPct < r[iBest].rmsPct))
+            iBest = m;
+    }
+    if (iBest < 0)
+        return false;
+    *fr = r[iBest];
+    return true;
+}
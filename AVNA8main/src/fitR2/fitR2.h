@@ -0,0 +1,85 @@
+/*
+ *  fitR2.h
+ *  Equivalent circuit fitting of Z data for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Levenberg-Marquardt fit of an R-L-C model to measured Z.  Works on float
+ * arrays of frequency, R and X, and uses no heap.  The data are not stored,
+ * J'J and J'r are summed point by point, so any number of points can be
+ * used.  Parameters are fitted as ln(value), so they stay positive and
+ * values of very different size are handled alike.  The residual of each
+ * point is (Zmodel - Zmeas)/|Zmeas|, so all points count the same whatever
+ * the |Z|.  The starting values come from the data, see fitStart().
+ *
+ * Models, parameters in order:
+ *    FIT_SERIES_RLC    R, L, C in series
+ *    FIT_PARALLEL_RLC  R, L, C in parallel
+ *    FIT_RL_PAR_C      R and L in series, all in parallel with C (a coil)
+ *    FIT_SPEAKER       Re, Le in series with Res, Lces, Cmes in parallel,
+ *                      the electrical Thiele-Small model
+ *    FIT_CRYSTAL       R1, L1, C1 in series, all in parallel with C0 (BVD)
+ *
+ *     FitResult fr;
+ *     if (fitZ(FIT_SERIES_RLC, freq, re, im, n, &fr)) ... fr.p[0] is R
+ *
+ * fitBest() tries each model and keeps the simplest that fits about as
+ * well as the best.  Roughly a millisecond per model for 13 points on a
+ * Teensy 3.6.
+ */
+
+#ifndef fitR2_h_
+#define fitR2_h_
+
+#include "Arduino.h"
+
+#define FIT_SERIES_RLC   0
+#define FIT_PARALLEL_RLC 1
+#define FIT_RL_PAR_C     2
+#define FIT_SPEAKER      3
+#define FIT_CRYSTAL      4
+#define FIT_N_MODELS     5
+#define FIT_MAX_PARAMS   5
+#define FIT_MAX_ITER     100
+
+struct FitResult {
+    uint16_t model;
+    uint16_t nParams;
+    uint16_t iterations;
+    uint16_t nPoints;
+    float p[FIT_MAX_PARAMS];    // Ohm, H, F
+    float rmsPct;               // RMS of |Zmodel - Zmeas|/|Zmeas|, percent
+};
+
+// Fit one model.  Returns false for fewer points than parameters.
+bool fitZ(uint16_t model, const float *f, const float *zRe, const float *zIm,
+          uint16_t n, FitResult *fr);
+// All models, the best in *fr.  Returns false if none could be fitted.
+bool fitBest(const float *f, const float *zRe, const float *zIm,
+          uint16_t n, FitResult *fr);
+// Z of the model at frequency f
+void fitModelZ(uint16_t model, const float *p, float f, float *re, float *im);
+uint16_t fitNParams(uint16_t model);
+const char *fitModelName(uint16_t model);
+// Name of parameter k, such as "L1"
+const char *fitParamName(uint16_t model, uint16_t k);
+#endif
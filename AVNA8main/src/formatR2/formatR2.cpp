@@ -0,0 +1,134 @@
+/*
+ *  formatR2.cpp
+ *  Fast float formatting for bulk serial output.  See formatR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "formatR2.h"
+
+static const uint32_t pow10R2[10] = {1UL, 10UL, 100UL, 1000UL, 10000UL,
+    100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL};
+
+// Decimal digits of v, most significant first.  Returns the count.
+static uint16_t putDigits(char *out, uint32_t v)
+{
+    char tmp[10];
+    uint16_t k = 0, len;
+
+    do {
+        tmp[k++] = '0' + (v % 10);
+        v /= 10;
+    } while (v > 0);
+    len = k;
+    while (k > 0)
+        *out++ = tmp[--k];
+    return len;
+}
+
+uint16_t formatFloat(char *out, float x, uint8_t digits)
+{
+    union {
+        float f32;
+        uint32_t i32;
+    } u;
+    uint32_t expo, mant, ip, fp;
+    int32_t shift;
+    uint64_t prod, whole, frac, half, dist, dd;
+    float err, distUnits, ax;
+    uint16_t len = 0, k;
+
+    if (digits > 9)
+        return 0;
+    u.f32 = x;
+    expo = (u.i32 >> 23) & 0xFF;
+    mant = u.i32 & 0x7FFFFF;
+    if (expo == 0xFF) {                     // nan and inf, as Print
+        if (mant != 0) {
+            out[0] = 'n';  out[1] = 'a';  out[2] = 'n';
+        } else {
+            out[0] = 'i';  out[1] = 'n';  out[2] = 'f';
+        }
+        return 3;
+    }
+    if (x > 4294967040.0f || x < -4294967040.0f) {
+        out[0] = 'o';  out[1] = 'v';  out[2] = 'f';
+        return 3;
+    }
+    // |x| = mant * 2^shift, exactly
+    if (expo == 0) {
+        shift = -149;
+    } else {
+        mant |= 0x800000;
+        shift = (int32_t)expo - 150;
+    }
+
+    // y = |x|*10^digits + 0.5.  Find floor(y), and how far the fractional
+    // part of y is from the rounding boundary, in units of the last digit.
+    prod = (uint64_t)mant * (uint64_t)pow10R2[digits];     // < 2^54
+    if (shift >= 0) {
+        if (shift > 9)                 // Only with no digits, above 2^32
+            return 0;
+        whole = prod << shift;
+        distUnits = 0.5f;
+    } else if (shift > -63) {
+        whole = prod >> (-shift);
+        frac = prod - (whole << (-shift));
+        half = 1ULL << (-shift - 1);
+        if (frac >= half) {
+            whole++;
+            dist = frac - half;
+        } else {
+            dist = half - frac;
+        }
+        // Only the size matters here, so float is fine
+        distUnits = ldexpf((float)dist, shift);
+    } else {                            // Very small, y is 0.5
+        whole = 0;
+        distUnits = 0.5f;
+    }
+
+    // Print works in double, 53 bits.  Allow it a generous error, with the
+    // rounding constant included.  Closer than that to the boundary, and the
+    // result is whatever the double arithmetic gives, so let Print do it.
+    ax = fabsf(x);
+    if (ax < 1.0f/(float)pow10R2[digits])
+        ax = 1.0f/(float)pow10R2[digits];
+    err = (float)pow10R2[digits]*ax*3.5527137E-15f;     // 2^-48
+    if (distUnits <= err)
+        return 0;
+
+    if (x < 0.0f)
+        out[len++] = '-';
+    dd = pow10R2[digits];
+    ip = (uint32_t)(whole / dd);
+    fp = (uint32_t)(whole - (uint64_t)ip * dd);
+    len += putDigits(out + len, ip);
+    if (digits > 0) {
+        out[len++] = '.';
+        for (k = digits; k > 0; k--) {       // Leading zeros kept
+            out[len + k - 1] = '0' + (fp % 10);
+            fp /= 10;
+        }
+        len += digits;
+    }
+    return len;
+}
@@ -0,0 +1,101 @@
+/*
+ *  formatR2.h
+ *  Fast float formatting for bulk serial output
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Print::print(float, digits) does the conversion with a loop of double
+ * multiplies, and double is software on the Teensy 3.6.  formatFloat() gets
+ * the same characters with 32 and 64-bit integers only, from the exact
+ * value of the float.  The double arithmetic of Print only differs from the
+ * exact answer when the value is right at a rounding boundary.  Those cases
+ * are recognized and formatFloat() returns 0, and the caller uses Print.
+ * Also returned as 0 is anything over 9 digits.
+ *
+ * FormatBuffer collects a line (or more) of text and sends it to a Print
+ * with one write() per buffer full, rather than a write() for each piece.
+ *     FormatBuffer fb(Serial, buf, sizeof(buf));
+ *     fb.addFloat(x, 6);  fb.addChar(' ');  fb.addFloat(y, 6);
+ *     fb.addStr("\r\n");  fb.flush();
+ * The output is byte for byte what Serial.print(x, 6) ... would send.
+ */
+
+#ifndef formatR2_h_
+#define formatR2_h_
+
+#include "Arduino.h"
+
+// Characters of x with digits after the decimal point, to out[].  Not null
+// terminated.  Returns the length, at most 24, or 0 if Print must be used.
+uint16_t formatFloat(char *out, float x, uint8_t digits);
+
+class FormatBuffer
+{
+public:
+    FormatBuffer(Print &_p, char *_buf, uint16_t _size) {
+        p = &_p;
+        buf = _buf;
+        size = _size;
+        n = 0;
+    }
+
+    void addFloat(float x, uint8_t digits) {
+        uint16_t len;
+        room(24);
+        len = formatFloat(buf + n, x, digits);
+        if (len > 0) {
+            n += len;
+        } else {              // Boundary case, exactly as Print
+            flush();
+            p->print(x, digits);
+        }
+    }
+
+    void addStr(const char *s) {
+        while (*s) {
+            room(1);
+            buf[n++] = *s++;
+        }
+    }
+
+    void addChar(char c) {
+        room(1);
+        buf[n++] = c;
+    }
+
+    void flush(void) {
+        if (n > 0)
+            p->write((const uint8_t *)buf, n);
+        n = 0;
+    }
+
+private:
+    Print *p;
+    char *buf;
+    uint16_t size, n;
+
+    void room(uint16_t k) {
+        if (n + k > size)
+            flush();
+    }
+};
+#endif
@@ -0,0 +1,184 @@
+/*
+ *  logR2.cpp
+ *  Data logging to the SD card for the AVNA.  See logR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "logR2.h"
+
+void DataLog::start(uint32_t _maxBytes)
+{
+    if (logging)
+        stop();
+    maxBytes = _maxBytes;
+    if (maxBytes < 4096)
+        maxBytes = 4096;
+    head = 0;
+    tail = 0;
+    seq = 0;
+    nLost = 0;
+    nErrors = 0;
+    fileNum = 0;
+    part = 0;
+    msRetry = millis() - LOG_RETRY_MS;   // First open right away
+    msSync = millis();
+    logging = true;
+}
+
+// Everything in the ring goes to the file, if there is one
+void DataLog::stop(void)
+{
+    uint16_t n;
+
+    if (fileOpen) {
+        while ((n = waiting()) > 0) {
+            if (n > LOG_PER_SECTOR)
+                n = LOG_PER_SECTOR;
+            if (!writeRecords(n))
+                break;
+        }
+        if (fileOpen)
+            closeFile();
+    }
+    nLost += waiting();
+    head = 0;
+    tail = 0;
+    logging = false;
+}
+
+bool DataLog::add(uint8_t type, uint8_t flags, uint16_t aux, float f,
+                  float v0, float v1, float v2, float v3)
+{
+    struct logRecord *r;
+    uint16_t next;
+
+    if (!logging)
+        return false;
+    next = (head + 1) % LOG_RING;
+    if (next == tail) {
+        seq++;                       // Shows as a gap
+        nLost++;
+        return false;
+    }
+    r = &ring[head];
+    r->ms = millis();
+    r->seq = seq++;
+    r->type = type;
+    r->flags = flags;
+    r->aux = aux;
+    r->f = f;
+    r->v[0] = v0;
+    r->v[1] = v1;
+    r->v[2] = v2;
+    r->v[3] = v3;
+    head = next;
+    return true;
+}
+
+// At most one sector write, or one file open, per call
+void DataLog::service(bool cardOK)
+{
+    uint32_t now = millis();
+
+    if (!logging)
+        return;
+    if (!fileOpen) {
+        if (!cardOK || now - msRetry < LOG_RETRY_MS)
+            return;
+        msRetry = now;
+        openNext();
+        return;
+    }
+    if (waiting() >= LOG_PER_SECTOR) {
+        if (writeRecords(LOG_PER_SECTOR) && bytes >= maxBytes) {
+            closeFile();
+            msRetry = now - LOG_RETRY_MS;    // Next file on the next call
+        }
+    } else if (now - msSync >= LOG_SYNC_MS) {
+        file.flush();
+        msSync = now;
+    }
+}
+
+bool DataLog::openNext(void)
+{
+    char name[12] = "LOG000.BIN";
+    uint8_t sector[512];
+    struct logHeader h;
+    uint16_t i;
+
+    for (i = (part == 0) ? 0 : fileNum + 1; i < 1000; i++) {
+        name[3] = '0' + i/100;
+        name[4] = '0' + (i/10) % 10;
+        name[5] = '0' + i % 10;
+        if (!SD.exists(name))
+            break;
+    }
+    if (i >= 1000 || !(file = SD.open(name, FILE_WRITE))) {
+        nErrors++;
+        return false;
+    }
+    fileNum = i;
+    memset(&h, 0, sizeof(h));
+    strcpy(h.magic, "AVNALOG");
+    h.version = LOG_VERSION;
+    h.recordBytes = sizeof(struct logRecord);
+    h.fileNumber = fileNum;
+    h.part = part;
+    h.msOpen = millis();
+    h.seqFirst = (tail == head) ? seq : ring[tail].seq;
+    memset(sector, 0, sizeof(sector));
+    memcpy(sector, &h, sizeof(h));
+    if (file.write(sector, sizeof(sector)) != sizeof(sector)) {
+        file.close();
+        nErrors++;
+        return false;
+    }
+    part++;
+    bytes = sizeof(sector);
+    fileOpen = true;
+    msSync = millis();
+    return true;
+}
+
+// n records from tail, which do not wrap since tail moves by whole
+// sectors except for the last write in stop().
+bool DataLog::writeRecords(uint16_t n)
+{
+    size_t nb = n*sizeof(struct logRecord);
+
+    if (file.write((const uint8_t *)&ring[tail], nb) != nb) {
+        nErrors++;                   // Card gone, try again in a new file
+        closeFile();
+        msRetry = millis();
+        return false;
+    }
+    tail = (tail + n) % LOG_RING;
+    bytes += nb;
+    return true;
+}
+
+void DataLog::closeFile(void)
+{
+    file.close();
+    fileOpen = false;
+}
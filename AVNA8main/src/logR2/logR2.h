@@ -0,0 +1,140 @@
+/*
+ *  logR2.h
+ *  Data logging to the SD card for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Long term logging of measurements to the SD card as fixed size binary
+ * records.  add() only copies a record to a RAM ring and is safe to call
+ * from any measurement.  service(), called from loop(), writes one
+ * 512 byte sector of LOG_PER_SECTOR records when that many are waiting,
+ * so the SD card writes are whole, aligned sectors and are never in the
+ * middle of a measurement.  At most LOG_PER_SECTOR-1 records are in RAM
+ * only, and the directory entry is brought up to date every LOG_SYNC_MS.
+ *
+ * Files are LOGnnn.BIN, the first unused number.  Each starts with a
+ * 512 byte header sector, struct logHeader, then records.  When a file
+ * reaches maxBytes it is closed and the next one opened.
+ *
+ * If a write fails (card removed) the file is closed and the sector stays
+ * in the ring.  After the card is back (cardOK in service() true) a new
+ * file is opened, no more often than every LOG_RETRY_MS, and the waiting
+ * records go there.  Records of a partly written sector may be in both
+ * files, with the same seq.  If the ring fills, new records are dropped.  seq
+ * counts every add(), so dropped records show as gaps in seq.
+ *
+ * Records, all little-endian:
+ *     ms     uint32   millis() at add()
+ *     seq    uint32   count of records since start()
+ *     type   uint8    LOG_xxx below
+ *     flags  uint8    type dependent
+ *     aux    uint16   type dependent
+ *     f      float32  frequency, Hz
+ *     v[4]   float32  type dependent, see AVNA8log.ino
+ * tools/avnaLogDecode.py in the repository reads these.
+ */
+
+#ifndef logR2_h_
+#define logR2_h_
+
+#include "Arduino.h"
+#include <SD.h>
+
+#define LOG_VERSION     1
+#define LOG_RING      128            // Records, a multiple of LOG_PER_SECTOR
+#define LOG_PER_SECTOR 16
+#define LOG_SYNC_MS  10000
+#define LOG_RETRY_MS  2000
+
+#define LOG_VVM    1
+#define LOG_Z      2
+#define LOG_T      3
+#define LOG_ASA    4
+#define LOG_LOCKIN 5
+
+struct logRecord {
+    uint32_t ms;
+    uint32_t seq;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t aux;
+    float f;
+    float v[4];
+};                                   // 32 bytes
+
+struct logHeader {
+    char magic[8];                   // "AVNALOG", null
+    uint16_t version;                // LOG_VERSION
+    uint16_t recordBytes;            // sizeof(logRecord)
+    uint16_t fileNumber;             // nnn of LOGnnn.BIN
+    uint16_t part;                   // Files since start(), 0 is the first
+    uint32_t msOpen;                 // millis() when opened
+    uint32_t seqFirst;               // seq of the first record in the file
+};
+
+class DataLog
+{
+public:
+    DataLog() {
+        logging = false;
+        fileOpen = false;
+    }
+
+    void start(uint32_t _maxBytes);
+    void stop(void);
+    bool add(uint8_t type, uint8_t flags, uint16_t aux, float f,
+             float v0, float v1, float v2, float v3);
+    void service(bool cardOK);
+
+    bool running(void) {
+        return logging;
+    }
+
+    bool writing(void) {             // A file is open
+        return fileOpen;
+    }
+
+    uint16_t waiting(void) {
+        return (head - tail + LOG_RING) % LOG_RING;
+    }
+
+    uint32_t records(void)     { return seq; }
+    uint32_t lost(void)        { return nLost; }
+    uint32_t errors(void)      { return nErrors; }
+    uint16_t fileNumber(void)  { return fileNum; }
+    uint32_t fileBytes(void)   { return bytes; }
+
+private:
+    bool logging, fileOpen;
+    File file;
+    uint16_t head, tail;             // Records in ring[] are tail to head-1
+    uint32_t seq, nLost, nErrors;
+    uint32_t maxBytes, bytes;
+    uint16_t fileNum, part;
+    uint32_t msSync, msRetry;
+    struct logRecord ring[LOG_RING];
+
+    bool openNext(void);
+    bool writeRecords(uint16_t n);
+    void closeFile(void);
+};
+#endif
@@ -0,0 +1,108 @@
+/*
+ *  perfR2.cpp
+ *  Cycle counter profiling for the AVNA.  See perfR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "perfR2.h"
+
+struct perfStage perfData[PERF_N_STAGES];
+volatile bool perfEnable = true;
+
+const char *perfStageName[PERF_N_STAGES] = {
+    "FFT1024 update",
+    "Noise update",
+    "Zoom FFT update",
+    "Harmonics update",
+    "Meas wait",
+    "Meas work",
+    "measureZ",
+    "show_spectrum",
+    "Screen to SD",
+    "Command",
+    "Lock-in update",
+    "FFT2 update"
+};
+
+void perfBegin(void)
+{
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;          // Enable the DWT block
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA; // and its cycle counter
+    perfReset();
+}
+
+void perfReset(void)
+{
+    for (int s=0; s<PERF_N_STAGES; s++)
+        perfStageClear(&perfData[s]);
+}
+
+void perfStageClear(struct perfStage *ps)
+{
+    __disable_irq();
+    ps->count = 0;
+    ps->minCycles = 0xFFFFFFFF;
+    ps->maxCycles = 0;
+    ps->sumCycles = 0;
+    for (int b=0; b<PERF_N_BINS; b++)
+        ps->hist[b] = 0;
+    __enable_irq();
+}
+
+// Times in microseconds.  Stages with no data are not printed.
+void perfPrint(Print &p, bool showHist)
+{
+    struct perfStage ps;
+
+    p.println("Stage, count, min us, ave us, max us");
+    for (int s=0; s<PERF_N_STAGES; s++) {
+        __disable_irq();
+        ps = perfData[s];                   // Copy, consistent set
+        __enable_irq();
+        if (ps.count > 0)
+            perfPrintStage(p, perfStageName[s], &ps, showHist);
+    }
+}
+
+// One CSV line, name, count, min, ave, max, and optionally the histogram
+void perfPrintStage(Print &p, const char *name, struct perfStage *ps, bool showHist)
+{
+    float usPerCycle = 1.0E6f/(float)F_CPU;
+
+    p.print(name);
+    p.print(", ");
+    p.print(ps->count);
+    p.print(", ");
+    p.print(usPerCycle*(float)ps->minCycles, 2);
+    p.print(", ");
+    p.print(usPerCycle*(float)ps->sumCycles/(float)ps->count, 2);
+    p.print(", ");
+    p.println(usPerCycle*(float)ps->maxCycles, 2);
+    if (!showHist) return;
+    for (int b=0; b<PERF_N_BINS; b++) {
+        if (ps->hist[b] == 0) continue;
+        p.print("    >=");
+        p.print(usPerCycle*(float)(1UL << b), 3);
+        p.print(" us: ");
+        p.println(ps->hist[b]);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ *  perfR2.h
+ *  Cycle counter profiling for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Run time profiling with the ARM DWT cycle counter, CPU clock cycles
+ * (180 MHz on a Teensy 3.6).  Each stage keeps count, min, max, sum and a
+ * histogram with one bin per power of 2 of cycles, so bin b holds times
+ * from 2^b to 2^(b+1)-1 cycles.
+ *
+ * Usage:
+ *     uint32_t t0 = perfStart();
+ *     ...code to be timed...
+ *     perfStop(PERF_MEASUREZ, t0);
+ *
+ * perfStop() is safe to call from update() at interrupt level.  Overhead
+ * is a few dozen cycles.  perfEnable=false skips the record keeping.
+ * The cycle counter is enabled by perfBegin(), from setup().
+ *
+ * A perfStage can also be used on its own, with perfStageClear() and
+ * perfStageAdd(), as the BENCH command does.  PerfNullPrint is a Print that
+ * discards everything, for timing the formatting of serial output.
+ */
+
+#ifndef perfR2_h_
+#define perfR2_h_
+
+#include "Arduino.h"
+
+// Stages that are timed.  Add to perfStageName[] in perfR2.cpp, as well.
+#define PERF_FFT_UPDATE     0
+#define PERF_NOISE_UPDATE   1
+#define PERF_ZOOM_UPDATE    2
+#define PERF_HARM_UPDATE    3
+#define PERF_MEAS_WAIT      4
+#define PERF_MEAS_WORK      5
+#define PERF_MEASUREZ       6
+#define PERF_SHOW_SPECTRUM  7
+#define PERF_SCREEN_DUMP    8
+#define PERF_COMMAND        9
+#define PERF_LOCKIN_UPDATE 10
+#define PERF_FFT2_UPDATE   11
+#define PERF_N_STAGES      12
+
+#define PERF_N_BINS 32
+
+struct perfStage {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t sumCycles;
+    uint32_t hist[PERF_N_BINS];
+};
+
+extern struct perfStage perfData[PERF_N_STAGES];
+extern const char *perfStageName[PERF_N_STAGES];
+extern volatile bool perfEnable;
+
+void perfBegin(void);
+void perfReset(void);
+void perfPrint(Print &p, bool showHist);
+void perfStageClear(struct perfStage *ps);
+void perfPrintStage(Print &p, const char *name, struct perfStage *ps, bool showHist);
+
+class PerfNullPrint : public Print
+{
+public:
+    virtual size_t write(uint8_t b) { return 1; }
+    virtual size_t write(const uint8_t *buffer, size_t size) { return size; }
+};
+
+static inline uint32_t perfStart(void) {
+    return ARM_DWT_CYCCNT;
+}
+
+static inline void perfStageAdd(struct perfStage *ps, uint32_t tStart) {
+    uint32_t dt, b;
+
+    dt = ARM_DWT_CYCCNT - tStart;          // Unsigned, so wrap is OK
+    __disable_irq();
+    ps->count++;
+    ps->sumCycles += dt;
+    if (dt < ps->minCycles) ps->minCycles = dt;
+    if (dt > ps->maxCycles) ps->maxCycles = dt;
+    b = 31 - __builtin_clz(dt | 1);
+    ps->hist[b]++;
+    __enable_irq();
+}
+
+static inline void perfStop(uint16_t stage, uint32_t tStart) {
+    if (perfEnable)
+        perfStageAdd(&perfData[stage], tStart);
+}
+#endif
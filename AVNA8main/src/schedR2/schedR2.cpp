@@ -0,0 +1,155 @@
+/*
+ *  schedR2.cpp
+ *  Cooperative task scheduler for the AVNA.  See schedR2.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "schedR2.h"
+
+int16_t Scheduler::add(const char *name, void (*fn)(void), uint8_t priority,
+                       uint32_t periodUs, uint32_t budgetUs)
+{
+    struct schedTask *s;
+    int16_t k;
+
+    if (nTasks >= SCHED_MAX_TASKS)
+        return -1;
+    s = &task[nTasks];
+    s->name = name;
+    s->fn = fn;
+    s->priority = priority;
+    s->enabled = true;
+    s->signaled = false;
+    s->periodUs = periodUs;
+    s->budgetUs = budgetUs;
+    s->dueUs = micros();
+    s->runs = 0;
+    s->overruns = 0;
+    s->maxUs = 0;
+    s->maxLateUs = 0;
+    s->sumUs = 0;
+    // Insertion into order[], after any of the same priority
+    for (k = nTasks; k > 0 && task[order[k-1]].priority > priority; k--)
+        order[k] = order[k-1];
+    order[k] = nTasks;
+    return nTasks++;
+}
+
+void Scheduler::run(void)
+{
+    struct schedTask *s;
+    uint32_t tPass, now, late, dt;
+
+    tPass = micros();
+    for (uint16_t k = 0; k < nTasks; k++) {
+        s = &task[order[k]];
+        if (!s->enabled)
+            continue;
+        now = micros();
+        if (s->periodUs == SCHED_EVENT) {
+            if (!s->signaled)
+                continue;
+            s->signaled = false;
+            late = now - s->dueUs;
+        } else {
+            if ((int32_t)(now - s->dueUs) < 0)
+                continue;
+            late = now - s->dueUs;
+            if (s->periodUs == SCHED_EVERY) {
+                late = 0;                // Sleep over, not late
+            } else {
+                s->dueUs += s->periodUs;
+                if ((int32_t)(now - s->dueUs) >= 0)
+                    s->dueUs = now + s->periodUs;
+            }
+        }
+
+        current = order[k];
+        now = micros();
+        s->fn();
+        dt = micros() - now;
+        current = -1;
+
+        s->runs++;
+        s->sumUs += dt;
+        if (dt > s->maxUs)
+            s->maxUs = dt;
+        if (dt > s->budgetUs)
+            s->overruns++;
+        if (late > s->maxLateUs)
+            s->maxLateUs = late;
+    }
+    passes++;
+    dt = micros() - tPass;
+    if (dt > maxPassUs)
+        maxPassUs = dt;
+}
+
+void Scheduler::clearStats(void)
+{
+    for (uint16_t k = 0; k < nTasks; k++) {
+        task[k].runs = 0;
+        task[k].overruns = 0;
+        task[k].maxUs = 0;
+        task[k].maxLateUs = 0;
+        task[k].sumUs = 0;
+    }
+    passes = 0;
+    maxPassUs = 0;
+}
+
+// One CSV line per task, in priority order
+void Scheduler::printStats(Print &p)
+{
+    struct schedTask *s;
+
+    p.println("Task, priority, period us, budget us, runs, overruns, ave us, max us, max late us");
+    for (uint16_t k = 0; k < nTasks; k++) {
+        s = &task[order[k]];
+        p.print(s->name);
+        p.print(", ");
+        p.print(s->priority);
+        p.print(", ");
+        if (s->periodUs == SCHED_EVERY)
+            p.print("every");
+        else if (s->periodUs == SCHED_EVENT)
+            p.print("event");
+        else
+            p.print(s->periodUs);
+        p.print(", ");
+        p.print(s->budgetUs);
+        p.print(", ");
+        p.print(s->runs);
+        p.print(", ");
+        p.print(s->overruns);
+        p.print(", ");
+        p.print(s->runs > 0 ? (float)s->sumUs/(float)s->runs : 0.0f, 1);
+        p.print(", ");
+        p.print(s->maxUs);
+        p.print(", ");
+        p.println(s->maxLateUs);
+    }
+    p.print("Passes, ");
+    p.print(passes);
+    p.print(", max pass us, ");
+    p.println(maxPassUs);
+}
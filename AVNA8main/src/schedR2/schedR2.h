@@ -0,0 +1,105 @@
+/*
+ *  schedR2.h
+ *  Cooperative task scheduler for the AVNA loop()
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* loop() calls run(), and each call is one pass over the tasks, highest
+ * priority (0) first and in the order added for equal priority.  A task
+ * is a void function that does a bounded piece of work and returns.  The
+ * period, in microseconds, is one of
+ *     SCHED_EVERY  Every pass, unless sleeping, see sleep()
+ *     SCHED_EVENT  Once after each signal()
+ *     n            Every n us.  If a task gets more than a period behind,
+ *                  runs are skipped, not bunched up.
+ * From inside a task, sleep(us) puts off its next run, in place of a
+ * blocking delay().
+ *
+ * Each task has a time budget.  A run longer than the budget is counted
+ * as an overrun.  Also kept are the run count, the average and max run
+ * time, and the max lateness, the time from due (or from signal()) to
+ * the start of the run.  The lateness is the latency that the task sees.
+ * printStats() sends these as CSV.  Times are from micros().
+ */
+
+#ifndef schedR2_h_
+#define schedR2_h_
+
+#include "Arduino.h"
+
+#define SCHED_MAX_TASKS 12
+#define SCHED_EVERY 0UL
+#define SCHED_EVENT 0xFFFFFFFFUL
+
+struct schedTask {
+    const char *name;
+    void (*fn)(void);
+    uint8_t priority;
+    bool enabled, signaled;
+    uint32_t periodUs, budgetUs;
+    uint32_t dueUs;              // Next run, or time of signal()
+    uint32_t runs, overruns;
+    uint32_t maxUs, maxLateUs;
+    uint64_t sumUs;
+};
+
+class Scheduler
+{
+public:
+    Scheduler() {
+        nTasks = 0;
+        current = -1;
+        clearStats();
+    }
+
+    // Returns the task id, or -1 if there are already SCHED_MAX_TASKS
+    int16_t add(const char *name, void (*fn)(void), uint8_t priority,
+                uint32_t periodUs, uint32_t budgetUs);
+    void run(void);
+
+    void signal(int16_t id) {
+        if (id < 0 || id >= nTasks || task[id].signaled) return;
+        task[id].signaled = true;
+        task[id].dueUs = micros();
+    }
+
+    void enable(int16_t id, bool on) {
+        if (id >= 0 && id < nTasks)
+            task[id].enabled = on;
+    }
+
+    void sleep(uint32_t us) {
+        if (current >= 0)
+            task[current].dueUs = micros() + us;
+    }
+
+    void clearStats(void);
+    void printStats(Print &p);
+
+private:
+    struct schedTask task[SCHED_MAX_TASKS];
+    uint8_t order[SCHED_MAX_TASKS];      // Task ids by priority
+    uint16_t nTasks;
+    int16_t current;                     // Running task, or -1
+    uint32_t passes, maxPassUs;
+};
+#endif
@@ -0,0 +1,109 @@
+/*
+ *  snapR2.h
+ *  Triple buffered 512 bin spectrum, written in update() and read in loop()
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* A SpecSnap holds three 512 float buffers.  The audio interrupt always
+ * has one, "back", to write.  loop() always has one, "front", to read.  The
+ * third, "middle", is the newest finished spectrum.  Each side only
+ * trades its own buffer for middle, with one atomic exchange of a byte,
+ * so neither side ever waits, copies 2 KB, or turns off interrupts.  A
+ * spectrum that loop() has taken stays the same until it takes the next
+ * one, however long the LCD or serial output takes.
+ *
+ * Writer, in update():
+ *    fill writeBuffer(), then publish()
+ * Reader, in loop():
+ *    if(take())  use readBuffer()
+ * Every published spectrum has a sequence number.  A spectrum that was
+ * replaced in middle before it was taken is lost, and counted by lost().
+ * frames() counts only those taken.
+ *
+ * The exchange is LDREXB/STREXB on the Cortex-M4.  Exception entry clears
+ * the exclusive monitor, so an interrupt between the two makes the reader
+ * try again.  In the interrupt the exchange can not be interrupted by
+ * loop().
+ */
+
+#ifndef snapR2_h_
+#define snapR2_h_
+
+#include "Arduino.h"
+#include "arm_math.h"
+
+#define SNAP_FRESH 0x80      // In middle, not yet taken
+
+class SpecSnap
+{
+public:
+    SpecSnap() : back(0), middle(1), front(2), seqWritten(0), seqRead(0), nRead(0), nLost(0) {
+        memset(buf, 0, sizeof(buf));
+        seq[0] = 0;  seq[1] = 0;  seq[2] = 0;
+    }
+
+    // Writer side, the audio interrupt
+    float32_t *writeBuffer(void) {
+        return buf[back];
+    }
+    void publish(void) {
+        seq[back] = ++seqWritten;
+        back = __atomic_exchange_n(&middle, (uint8_t)(back | SNAP_FRESH), __ATOMIC_ACQ_REL) & 3;
+    }
+
+    // Reader side, loop().  True if there is a new spectrum in readBuffer().
+    bool take(void) {
+        if (!(__atomic_load_n(&middle, __ATOMIC_ACQUIRE) & SNAP_FRESH))
+            return false;
+        front = __atomic_exchange_n(&middle, front, __ATOMIC_ACQ_REL) & 3;
+        nLost += seq[front] - seqRead - 1;
+        seqRead = seq[front];
+        nRead++;
+        return true;
+    }
+    const float32_t *readBuffer(void) {
+        return buf[front];
+    }
+    // Spectra taken by loop(), and spectra that were never taken
+    uint32_t frames(void) {
+        return nRead;
+    }
+    uint32_t lost(void) {
+        return nLost;
+    }
+    void clearCounts(void) {
+        nRead = 0;
+        nLost = 0;
+    }
+
+private:
+    float32_t buf[3][512];
+    volatile uint32_t seq[3];   // seqWritten when each buffer was published
+    uint8_t back;               // Interrupt only
+    volatile uint8_t middle;    // Index, plus SNAP_FRESH
+    uint8_t front;              // loop() only
+    uint32_t seqWritten;        // Interrupt only
+    uint32_t seqRead;           // Sequence number of the last taken
+    uint32_t nRead;
+    uint32_t nLost;
+};
+#endif
@@ -0,0 +1,103 @@
+/*
+ *  specAveR2.h
+ *  In-place averaging and hold kernels for the 512 bin ASA spectrum
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Each kernel works on n floats, in place on its first argument, and
+ * the second argument may be the FFT output[] array itself.  These are
+ * the steps of the ASA averaging modes in doFFT():
+ *   Block     specAdd() for SAnAve frames, then start over
+ *   Exponential  specExpAve() every frame, alpha = 1/SAnAve
+ *   Max hold  specMaxHold() every frame, until restarted
+ *   Min hold  specMinHold() every frame, until restarted
+ * For log averaging the frame is first converted by specToDB() and the
+ * result back to power by specFromDB().  Log averaging of noise reads
+ * 2.51 dB low (the mean of the log of a chi-square, 2 degree of freedom,
+ * power) but it keeps a sine that is being switched or swept from
+ * dominating the average.
+ */
+
+#ifndef specAveR2_h_
+#define specAveR2_h_
+
+#include "Arduino.h"
+#include "arm_math.h"
+
+// Powers of 1E-20 and below are all -200 dB
+#define SPEC_DB_FLOOR -200.0f
+
+// ave[i] += x[i]
+static inline void specAdd(float32_t *ave, const float32_t *x, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        ave[i] += x[i];
+}
+
+// ave[i] += alpha*(x[i] - ave[i]), a one pole lowpass with a time
+// constant of 1/alpha frames
+static inline void specExpAve(float32_t *ave, const float32_t *x, float32_t alpha, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        ave[i] += alpha*(x[i] - ave[i]);
+}
+
+static inline void specMaxHold(float32_t *hold, const float32_t *x, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        if (x[i] > hold[i])
+            hold[i] = x[i];
+}
+
+static inline void specMinHold(float32_t *hold, const float32_t *x, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        if (x[i] < hold[i])
+            hold[i] = x[i];
+}
+
+// y[i] = scale*x[i].  y may be x.
+static inline void specScale(float32_t *y, const float32_t *x, float32_t scale, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        y[i] = scale*x[i];
+}
+
+// y[i] = 10*log10(x[i]) in dB, not below SPEC_DB_FLOOR.  y may be x.
+static inline void specToDB(float32_t *y, const float32_t *x, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        y[i] = (x[i] > 1.0E-20f ? 10.0f*log10f(x[i]) : SPEC_DB_FLOOR);
+}
+
+/* y[i] = scale*10^(x[i]/10), power from dB.  y may be x.  Any dB scale
+ * factor, like 1/SAnAve for a block sum, goes in with dbScale.
+ */
+static inline void specFromDB(float32_t *y, const float32_t *x, float32_t dbScale,
+                              float32_t scale, uint16_t n)
+{
+    // 10^(d/10) = 2^(d*log2(10)/10)
+    const float32_t k = 0.33219281f*dbScale;
+    for (uint16_t i = 0; i < n; i++)
+        y[i] = scale*exp2f(k*x[i]);
+}
+#endif
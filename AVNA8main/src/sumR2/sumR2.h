@@ -0,0 +1,107 @@
+/*
+ *  sumR2.h
+ *  Exact sums of 16-bit samples with the Cortex-M4 DSP instructions
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* sumInt16(pd, n, acc) returns acc plus the sum of n int16 samples, exact.
+ * On the Teensy 3.6 (Cortex-M4) SMLALD multiplies both halves of a 32-bit
+ * word by 1 and adds both products to a 64-bit accumulator, two samples per
+ * 1-cycle instruction, with the loads done 4 words at a time.  Elsewhere a
+ * plain loop gives the identical result.  pd must be 4-byte aligned, as the
+ * audio library blocks are.
+ *
+ * The float sum this replaces rounds once the sum is over 2^24 and needs
+ * a conversion and a float add per sample, plus a software double add per
+ * block.  With int64 there is no rounding at all, and the one conversion
+ * to floating point is done per measurement.
+ *
+ * With SUMR2_EMULATE defined, a host build runs the SMLALD loop with the
+ * instruction done in C.  tools/sumR2HostTest.cpp uses this to check it
+ * against the plain loop.
+ */
+
+#ifndef sumR2_h_
+#define sumR2_h_
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#include <stdint.h>
+#endif
+
+#if defined(__ARM_ARCH_7EM__) || defined(SUMR2_EMULATE)
+// One SMLALD, {hi,lo} += x.lo*y.lo + x.hi*y.hi, signed 16-bit halves
+static inline void smlaldR2(uint32_t *lo, uint32_t *hi, uint32_t x, uint32_t y)
+    __attribute__((always_inline, unused));
+
+static inline void smlaldR2(uint32_t *lo, uint32_t *hi, uint32_t x, uint32_t y)
+{
+#if defined(__ARM_ARCH_7EM__)
+    asm volatile("smlald %0, %1, %2, %3" : "+r" (*lo), "+r" (*hi) : "r" (x), "r" (y));
+#else
+    uint64_t a = ((uint64_t)*hi << 32) | *lo;
+    a += (uint64_t)((int64_t)(int16_t)x*(int16_t)y +
+                    (int64_t)(int16_t)(x >> 16)*(int16_t)(y >> 16));
+    *lo = (uint32_t)a;
+    *hi = (uint32_t)(a >> 32);
+#endif
+}
+#endif
+
+static inline int64_t sumInt16(const int16_t *pd, uint16_t n, int64_t acc)
+    __attribute__((always_inline, unused));
+
+static inline int64_t sumInt16(const int16_t *pd, uint16_t n, int64_t acc)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(SUMR2_EMULATE)
+    const uint32_t *p32 = (const uint32_t *)pd;
+    const uint32_t ones = 0x00010001;
+    uint32_t lo = (uint32_t)acc;
+    uint32_t hi = (uint32_t)((uint64_t)acc >> 32);
+    uint32_t a, b, c, d;
+    uint16_t nw = n >> 1;
+
+    while (nw >= 4) {
+        a = p32[0];  b = p32[1];  c = p32[2];  d = p32[3];
+        p32 += 4;
+        smlaldR2(&lo, &hi, a, ones);
+        smlaldR2(&lo, &hi, b, ones);
+        smlaldR2(&lo, &hi, c, ones);
+        smlaldR2(&lo, &hi, d, ones);
+        nw -= 4;
+    }
+    while (nw--) {
+        a = *p32++;
+        smlaldR2(&lo, &hi, a, ones);
+    }
+    acc = (int64_t)(((uint64_t)hi << 32) | lo);
+    if (n & 1)
+        acc += pd[n - 1];
+    return acc;
+#else
+    for (uint16_t i = 0; i < n; i++)
+        acc += pd[i];
+    return acc;
+#endif
+}
+#endif
@@ -25,29 +25,31 @@
  */
 // See the following for details
 #include "synth_GaussianWhiteNoiseR2.h"
+#include "../perfR2/perfR2.h"
 
 void AudioSynthNoiseGaussian::update(void) {
+    audio_block_t *blockOut;
+    uint32_t tPerf = perfStart();
+
+    blockOut = allocate();
+    if (!blockOut) return;
+    fillBlock(&blockOut->data[0]);  // Ptr to write data (128 16-bit ints)
+    transmit(blockOut);
+    release(blockOut);
+    perfStop(PERF_NOISE_UPDATE, tPerf);
+}
+
+void AudioSynthNoiseGaussian::fillBlock(int16_t* pd) {
 #define ABS(X)   ((X>=0)? X : -(X) )
 #define ROUND(X) (X>=0)? (int) (X + 0.5) : (int)-(ABS(X) +0.5)
 
-    audio_block_t *blockOut;
     uint32_t it;
     float rdev = 0.0f;
     float gwn_f32, y_f32;
-    int16_t* pd;
-
- uint32_t xxpm;
- uint32_t xxpm2;
-
-    blockOut = allocate();
-    if (!blockOut) return;
-    pd = &blockOut->data[0];  // Ptr to write data (128 16-bit ints)
 
     if (sd < 0.00001f) {
         for(int i=0; i<AUDIO_BLOCK_SAMPLES; i++)
             *pd++ = 0;
-        transmit(blockOut);
-        release(blockOut);
         return;  // Not enabled, spend minimal time here
     }
 
@@ -100,8 +102,4 @@ void AudioSynthNoiseGaussian::update(void) {
         else
             *pd++ = ROUND(32768.0f*y_f32);  // Convert to int16_t
     }    // End, i over all samples
-
-
-    transmit(blockOut);
-    release(blockOut);                 //  Serial.print(xxpm2);Serial.print(" ");Serial.println(xxpm);
 }
@@ -110,6 +110,10 @@ public:
 		idum = _idum;
     }
 
+    // One block of AUDIO_BLOCK_SAMPLES outputs to pd.  This is the work of
+    // update(), separate so that it can be timed outside the audio system.
+    void fillBlock(int16_t* pd);
+
     virtual void update(void);
 
 private:
@@ -0,0 +1,264 @@
+/*
+ *  synth_arbitrary_p.cpp
+ *  Arbitrary waveform generator for the AVNA.  See synth_arbitrary_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "synth_arbitrary_p.h"
+
+void AudioSynthArbitrary_p::setTable(const int16_t *data, uint16_t n)
+{
+    if (n > ARB_TABLE_MAX)
+        n = ARB_TABLE_MAX;
+    tableLen = 0;                  // update() is silent while it changes
+    for (uint16_t i=0; i<n; i++)
+        table[i] = data[i];
+    tableLen = (n < 2) ? 0 : n;
+    streamEnded = false;
+}
+
+void AudioSynthArbitrary_p::setHarmonics(const float32_t *a, uint16_t n)
+{
+    float32_t x, scale, peak = 0.0f;
+    const float32_t w = 2.0f*PI/(float32_t)ARB_TABLE_MAX;
+
+    if (n > ARB_HARM_MAX)
+        n = ARB_HARM_MAX;
+    tableLen = 0;
+    // Twice through, the first for the peak
+    for (int pass=0; pass<2; pass++) {
+        scale = (peak > 1.0f) ? 32767.0f/peak : 32767.0f;
+        for (uint32_t i=0; i<ARB_TABLE_MAX; i++) {
+            x = 0.0f;
+            for (uint32_t k=1; k<=n; k++)
+                x += a[k-1]*sinf(w*(float32_t)((k*i) % ARB_TABLE_MAX));
+            if (pass == 0 && fabsf(x) > peak)
+                peak = fabsf(x);
+            else if (pass == 1)
+                table[i] = (int16_t)(scale*x);
+        }
+    }
+    tableLen = ARB_TABLE_MAX;
+    streamEnded = false;
+}
+
+/* Positions f at the first sample and returns the sample bytes.  A RIFF
+ * file must be WAVE, PCM, 16-bit and mono; -1 if not.  Anything else is
+ * taken as raw samples, all of the file.
+ */
+int32_t AudioSynthArbitrary_p::openSamples(File &f)
+{
+    uint8_t h[16];
+    uint32_t size;
+    bool fmtOK = false;
+
+    if (f.read(h, 12) != 12 || memcmp(h, "RIFF", 4) != 0) {
+        f.seek(0);
+        return (int32_t)(f.size() & ~1UL);
+    }
+    if (memcmp(h + 8, "WAVE", 4) != 0)
+        return -1;
+    while (f.read(h, 8) == 8) {
+        memcpy(&size, h + 4, 4);
+        if (memcmp(h, "fmt ", 4) == 0) {
+            if (size < 16 || f.read(h, 16) != 16)
+                return -1;
+            // Format 1 (PCM), 1 channel, 16 bits
+            fmtOK = (h[0] == 1 && h[1] == 0 && h[2] == 1 && h[3] == 0 &&
+                     h[14] == 16 && h[15] == 0);
+            f.seek(f.position() + size - 16 + (size & 1));
+        } else if (memcmp(h, "data", 4) == 0) {
+            return fmtOK ? (int32_t)(size & ~1UL) : -1;
+        } else {
+            f.seek(f.position() + size + (size & 1));
+        }
+    }
+    return -1;
+}
+
+bool AudioSynthArbitrary_p::loadTable(const char *name)
+{
+    File f;
+    int32_t bytes;
+    uint16_t n;
+
+    if (!(f = SD.open(name)))
+        return false;
+    bytes = openSamples(f);
+    if (bytes < 4) {
+        f.close();
+        return false;
+    }
+    n = (bytes/2 > ARB_TABLE_MAX) ? ARB_TABLE_MAX : bytes/2;
+    tableLen = 0;
+    n = f.read((uint8_t *)table, 2*n)/2;      // Little-endian, as the Teensy
+    f.close();
+    tableLen = (n < 2) ? 0 : n;
+    streamEnded = false;
+    return tableLen > 0;
+}
+
+bool AudioSynthArbitrary_p::openStream(const char *name, bool _loop, void *work)
+{
+    int32_t bytes;
+
+    closeStream();
+    half = (int16_t (*)[ARB_STREAM_N])work;
+    if (!(file = SD.open(name)))
+        return false;
+    bytes = openSamples(file);
+    if (bytes < 2) {
+        file.close();
+        return false;
+    }
+    fileOpen = true;
+    loop = _loop;
+    fileEnd = false;
+    dataStart = file.position();
+    dataBytes = (uint32_t)bytes;
+    bytesLeft = dataBytes;
+    fill[0] = 0;
+    fill[1] = 0;
+    fillHalf(0);                   // Prefetch both, then start
+    fillHalf(1);
+    playHalf = 0;
+    playPos = 0;
+    nUnder = 0;
+    streamEnded = false;
+    streamOn = true;
+    return true;
+}
+
+void AudioSynthArbitrary_p::closeStream(void)
+{
+    streamOn = false;
+    streamEnded = false;
+    if (fileOpen) {
+        file.close();
+        fileOpen = false;
+    }
+}
+
+// Read half h, going back to dataStart at the end if loop
+void AudioSynthArbitrary_p::fillHalf(uint16_t h)
+{
+    uint32_t want, got, n = 0;
+
+    while (n < ARB_STREAM_N && !fileEnd) {
+        if (bytesLeft == 0) {
+            if (!loop) {
+                fileEnd = true;
+                break;
+            }
+            file.seek(dataStart);
+            bytesLeft = dataBytes;
+        }
+        want = 2*(ARB_STREAM_N - n);
+        if (want > bytesLeft)
+            want = bytesLeft;
+        got = file.read((uint8_t *)(half[h] + n), want) & ~1UL;
+        if (got == 0) {            // Card gone, or a short file
+            fileEnd = true;
+            break;
+        }
+        bytesLeft -= got;
+        n += got/2;
+    }
+    fill[h] = n;
+}
+
+void AudioSynthArbitrary_p::service(void)
+{
+    uint16_t h;
+
+    if (!fileOpen)
+        return;
+    if (!streamOn) {               // Played to the end
+        file.close();
+        fileOpen = false;
+        return;
+    }
+    // After an underrun both may be free, and playHalf is the one next
+    for (uint16_t j=0; j<2; j++) {
+        h = playHalf ^ j;
+        if (fill[h] == 0 && !fileEnd)
+            fillHalf(h);
+    }
+}
+
+void AudioSynthArbitrary_p::update(void)
+{
+    audio_block_t *block;
+    uint64_t pos;
+    uint32_t idx, next, frac, len;
+    int32_t v1, v2, m = magnitude;
+
+    if (m == 0 || streamEnded)
+        return;
+    if (streamOn) {
+        block = allocate();
+        if (!block) return;
+        for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+            if (playPos >= fill[playHalf]) {
+                if (fill[playHalf] > 0) {      // Done with it, to service()
+                    fill[playHalf] = 0;
+                    playHalf ^= 1;
+                    playPos = 0;
+                }
+                if (fill[playHalf] == 0) {
+                    if (fileEnd) {             // All played, silent
+                        streamEnded = true;    // until a new source
+                        streamOn = false;
+                    }
+                    else
+                        nUnder++;
+                    for ( ; i<AUDIO_BLOCK_SAMPLES; i++)
+                        block->data[i] = 0;
+                    break;
+                }
+            }
+            block->data[i] = (int16_t)((half[playHalf][playPos++]*m) >> 15);
+        }
+        transmit(block);
+        release(block);
+        return;
+    }
+
+    len = tableLen;
+    if (len == 0)
+        return;
+    block = allocate();
+    if (!block) return;
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+        // phase*len, the index is the high word and the fraction below it
+        pos = (uint64_t)phaseAcc*len;
+        idx = (uint32_t)(pos >> 32);
+        frac = (uint32_t)(pos >> 16) & 0xFFFF;
+        next = (idx + 1 < len) ? idx + 1 : 0;
+        v1 = table[idx]*(int32_t)(0x10000 - frac);
+        v2 = table[next]*(int32_t)frac;
+        block->data[i] = (int16_t)((((v1 + v2) >> 16)*m) >> 15);
+        phaseAcc += phaseInc;
+    }
+    transmit(block);
+    release(block);
+}
@@ -0,0 +1,168 @@
+/*
+ *  synth_arbitrary_p.h
+ *  Arbitrary waveform generator, RAM wavetables and uSD streaming, for the AVNA
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Two sources, one at a time.
+ *
+ * Wavetable.  One period of up to ARB_TABLE_MAX int16 points, of any
+ * length, played by a 32-bit phase accumulator.  Index and fraction are
+ * the high and low parts of phase*length, so the length need not be a
+ * power of 2, and the output is interpolated between points as in
+ * AudioSynthWaveformSine.  The frequency resolution is sampleRate/2^32.
+ * setTable() copies a table from RAM, loadTable() reads one from a uSD
+ * file and setHarmonics() makes one from harmonic amplitudes.  The table
+ * at power on is a sine.
+ *
+ * Stream.  A uSD file, played at one file sample per output sample, so
+ * its own sample rate is not used.  The file is read in the loop, by
+ * service(), never in update().  Two halves of ARB_STREAM_N samples take
+ * turns: update() plays one while service() fills the other, as soon as
+ * it is free.  openStream() fills both before playing starts.  A half
+ * takes ARB_STREAM_N/sampleRate, 85 msec at 48 kHz and 43 msec at 96 kHz,
+ * so a read can be that late before update() runs out.  The sketch calls
+ * service() from the long measurement waits as well as from the loop.  If
+ * it is late anyway, the block is zero and underruns() counts it.  With
+ * loop the file starts over at the end.  Without, or if the file cannot be
+ * read, the stream ends and ended() is true.  It stays silent, not going
+ * back to the table, until openStream(), closeStream() or a new table.
+ *
+ * Files are 16-bit mono WAV (the data chunk is found) or, without a RIFF
+ * header, raw 16-bit little-endian samples.
+ *
+ * Idle (no table, amplitude 0, or stream ended) no block is transmitted.
+ * Running, well under 1% of a Teensy 3.6.  RAM is 2*ARB_TABLE_MAX bytes,
+ * 4 kBytes.  openStream() is given ARB_STREAM_WORK_BYTES, 16 kBytes, of
+ * RAM for the halves, 4-byte aligned, and uses it until closeStream() or
+ * the end of the stream.
+ */
+
+#ifndef synth_arbitrary_p_h_
+#define synth_arbitrary_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+#include <SD.h>
+
+#define ARB_TABLE_MAX 2048
+#define ARB_STREAM_N  4096
+#define ARB_STREAM_WORK_BYTES (4*ARB_STREAM_N)
+#define ARB_HARM_MAX  8
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+class AudioSynthArbitrary_p : public AudioStream
+{
+public:
+    AudioSynthArbitrary_p() : AudioStream(0, NULL) {
+        magnitude = 0;
+        phaseAcc = 0;
+        phaseInc = 0;
+        streamOn = false;
+        fileOpen = false;
+        streamEnded = false;
+        half = NULL;
+        nUnder = 0;
+        setTable(AudioWaveformSine, 256);
+    }
+
+    void frequency(float32_t freq, float32_t sampleRate) {
+        if (freq < 0.0f || freq > 0.5f*sampleRate)
+            freq = 0.0f;
+        phaseInc = (uint32_t)(4294967296.0*(double)freq/(double)sampleRate);
+    }
+
+    // 0 to 1.0, full scale for the largest table or file sample
+    void amplitude(float32_t a) {
+        if (a < 0.0f) a = 0.0f;
+        if (a > 1.0f) a = 1.0f;
+        magnitude = (int32_t)(a*32767.0f);
+    }
+
+    // One period, 2 to ARB_TABLE_MAX points.  Longer is cut short.
+    void setTable(const int16_t *data, uint16_t n);
+
+    // One period from a uSD file.  False if it cannot be read.
+    bool loadTable(const char *name);
+
+    // Sine harmonics 1 to n, amplitudes in a[], scaled down if the peak is
+    // over 1.0.  n up to ARB_HARM_MAX, on ARB_TABLE_MAX points.
+    void setHarmonics(const float32_t *a, uint16_t n);
+
+    uint16_t tableLength(void) {
+        return tableLen;
+    }
+
+    // Play a uSD file in place of the table.  False if it cannot be opened.
+    bool openStream(const char *name, bool _loop, void *work);
+
+    // Back to the table
+    void closeStream(void);
+
+    // True from openStream() until the end of the file (never with loop)
+    bool streaming(void) {
+        return streamOn;
+    }
+
+    // True from the end of a stream until the next source is set
+    bool ended(void) {
+        return streamEnded;
+    }
+
+    // From loop(), often.  Reads a half when one is free.
+    void service(void);
+
+    // Blocks output as zero, waiting for service()
+    uint32_t underruns(void) {
+        return nUnder;
+    }
+
+    virtual void update(void);
+
+private:
+    int32_t openSamples(File &f);
+    void fillHalf(uint16_t h);
+    volatile int32_t magnitude;                // q15
+    uint32_t phaseAcc;
+    volatile uint32_t phaseInc;
+    volatile uint16_t tableLen;
+    int16_t table[ARB_TABLE_MAX];
+    // Stream.  fill[h] is the samples in half h, 0 when free.  update()
+    // only frees a half and service() only fills a free one.
+    volatile bool streamOn;
+    volatile bool streamEnded;
+    volatile uint16_t fill[2];
+    volatile uint16_t playHalf;
+    uint16_t playPos;
+    int16_t (*half)[ARB_STREAM_N];            // 2 of them, in the work RAM
+    File file;
+    bool fileOpen;
+    bool loop;
+    bool fileEnd;
+    uint32_t dataStart, dataBytes, bytesLeft;
+    volatile uint32_t nUnder;
+};
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  synth_sweepExp_p.cpp
+ *  Exponential sine sweep for the AVNA.  See synth_sweepExp_p.h
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "synth_sweepExp_p.h"
+
+// Interpolated sine of a 32-bit phase, q15 result
+static inline int32_t sineQ15(uint32_t ph)
+{
+    uint32_t idx = ph >> 24;
+    uint32_t scale = (ph >> 8) & 0xFFFF;
+    int32_t v1 = AudioWaveformSine[idx] * (0x10000 - scale);
+    int32_t v2 = AudioWaveformSine[idx+1] * scale;
+    return (v1 + v2) >> 16;
+}
+
+void AudioSynthSweepExp_p::begin(float32_t f1, float32_t f2, uint32_t _nSamples,
+                                 float32_t amplitude, float32_t sampleRate)
+{
+    if (_nSamples < 64 || f1 <= 0.0f || f2 <= f1 || amplitude <= 0.0f) {
+        running = false;
+        return;
+    }
+    if (amplitude > 1.0f)
+        amplitude = 1.0f;
+    nSamples = _nSamples;
+    nCount = 0;
+    nFade = nSamples/32;
+    phaseAcc = 0;
+    inc0 = 4294967296.0f*f1/sampleRate;
+    lnStep = logf(f2/f1)/(float32_t)nSamples;
+    incStep = expf(lnStep);
+    magnitude = (int32_t)(amplitude*32767.0f);
+    running = true;
+}
+
+void AudioSynthSweepExp_p::update(void)
+{
+    audio_block_t *block;
+    float32_t inc;
+    uint32_t k;
+    int32_t s, e;
+
+    if (!running) return;
+    block = allocate();
+    if (!block) return;
+
+    inc = inc0*expf(lnStep*(float32_t)nCount);
+    for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
+        if (nCount >= nSamples) {
+            block->data[i] = 0;
+            continue;
+        }
+        s = (sineQ15(phaseAcc)*magnitude) >> 15;
+        // sin^2 fade, a quarter cycle of the table over nFade samples
+        k = nCount;
+        if (nSamples - 1 - nCount < k)
+            k = nSamples - 1 - nCount;
+        if (k < nFade) {
+            e = sineQ15((uint32_t)(1073741824.0f*(float32_t)k/(float32_t)nFade));
+            s = (s*((e*e) >> 15)) >> 15;
+        }
+        block->data[i] = (int16_t)s;
+        phaseAcc += (uint32_t)inc;
+        inc *= incStep;
+        nCount++;
+    }
+    if (nCount >= nSamples)
+        running = false;
+    transmit(block);
+    release(block);
+}
@@ -0,0 +1,85 @@
+/*
+ *  synth_sweepExp_p.h
+ *  Exponential sine sweep for the AVNA, for ESS impulse response measurements
+ *
+ * Copyright (c) 2020 Robert Larkin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Exponential (Farina) sine sweep from f1 to f2 in nSamples,
+ *       x(n) = sin(2 pi f1 L (exp(n/L) - 1)/fs),    L = nSamples/ln(f2/f1)
+ * The instantaneous frequency is f1*exp(n/L), so each octave takes the same
+ * time and the sweep has a pink spectrum.  A phase accumulator runs at that
+ * frequency.  Its increment is found with expf() at the start of each block
+ * and multiplied by a constant ratio for each sample, so float rounding
+ * does not build up over a long sweep.
+ *
+ * The first and last nSamples/32 are faded with sin^2 to reduce the ripple
+ * at the band edges.  The exact sweep law does not matter to the
+ * deconvolution, that uses the sweep as captured, only the timing of the
+ * harmonic responses comes from f1, f2 and nSamples.
+ *
+ * begin(), with audio interrupts off, starts the sweep on the next update().
+ * After nSamples the output is zero and isRunning() goes false.  Idle, no
+ * block is transmitted.  Running, about 1% of a Teensy 3.6 at 96 kHz.
+ */
+
+#ifndef synth_sweepExp_p_h_
+#define synth_sweepExp_p_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+class AudioSynthSweepExp_p : public AudioStream
+{
+public:
+    AudioSynthSweepExp_p() : AudioStream(0, NULL) {
+        running = false;
+    }
+
+    // Frequencies in Hz, amplitude 0 to 1.0 of full scale
+    void begin(float32_t f1, float32_t f2, uint32_t _nSamples,
+               float32_t amplitude, float32_t sampleRate);
+
+    void stop(void) {
+        running = false;
+    }
+
+    bool isRunning(void) {
+        return running;
+    }
+
+    virtual void update(void);
+
+private:
+    volatile bool running;
+    uint32_t nSamples, nCount, nFade;
+    uint32_t phaseAcc;
+    float32_t inc0;              // Phase increment at f1, 2^32 per cycle
+    float32_t lnStep;            // ln(f2/f1)/nSamples
+    float32_t incStep;           // exp(lnStep)
+    int32_t magnitude;           // q15
+};
+#endif
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""avnaBinDecode.py  -  Read the binary frames of the AVNA "BINARY 1" mode.
+
+The frame layout is in AVNA8main/src/binFrameR2/binFrameR2.h.  Text between
+frames (such as "ch> " or DIST lines) is collected and shown as text.
+
+    python3 avnaBinDecode.py capture.bin          Decode a saved capture
+    python3 avnaBinDecode.py /dev/ttyACM0 SPECTRUM 0 0 1
+        Open the serial port (needs pyserial), send "BINARY 1", send the
+        rest of the line as one command, and decode for a few seconds.
+
+Each frame prints as a summary line and then one CSV line per item.
+Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+"""
+
+import struct
+import sys
+import time
+import zlib
+
+BF_NAMES = {1: "SPECTRUM_F32", 2: "SPECTRUM_CDB", 3: "S11", 4: "S21",
+            5: "FREQ", 6: "Z", 7: "SWEEP_PT", 8: "TF", 9: "XSPEC"}
+HEADER = struct.Struct("<2sBBHHff")     # 16 bytes
+
+
+def frames(data):
+    """Yield ("text", str) and ("frame", dict) items from a byte string."""
+    i = 0
+    text = bytearray()
+    while i < len(data):
+        if data[i:i + 2] == b"AV" and len(data) - i >= HEADER.size + 4:
+            sync, ver, ftype, count, item, a0, a1 = HEADER.unpack_from(data, i)
+            end = i + HEADER.size + count * item
+            if ver == 1 and ftype in BF_NAMES and end + 4 <= len(data):
+                crc, = struct.unpack_from("<I", data, end)
+                if crc == zlib.crc32(data[i:end]) & 0xFFFFFFFF:
+                    if text:
+                        yield "text", text.decode("ascii", "replace")
+                        text = bytearray()
+                    yield "frame", decode(ftype, count, item, a0, a1,
+                                          data[i + HEADER.size:end])
+                    i = end + 4
+                    continue
+        text.append(data[i])
+        i += 1
+    if text:
+        yield "text", text.decode("ascii", "replace")
+
+
+def decode(ftype, count, item, a0, a1, payload):
+    f = {"type": BF_NAMES[ftype], "count": count, "axis0": a0, "axis1": a1}
+    if ftype == 2:
+        vals = struct.unpack("<%dh" % count, payload)
+        f["items"] = [(a0 + k * a1, 0.01 * v) for k, v in enumerate(vals)]
+    elif ftype == 1:
+        vals = struct.unpack("<%df" % count, payload)
+        f["items"] = [(a0 + k * a1, v) for k, v in enumerate(vals)]
+    elif ftype in (8, 9):
+        n = item // 4
+        vals = struct.unpack("<%df" % (n * count), payload)
+        f["items"] = [(a0 + k * a1,) + vals[n * k:n * k + n]
+                      for k in range(count)]
+    else:
+        n = item // 4
+        vals = struct.unpack("<%df" % (count * n), payload)
+        f["items"] = [vals[k * n:(k + 1) * n] for k in range(count)]
+    return f
+
+
+def show(data):
+    nFrames = 0
+    for kind, x in frames(data):
+        if kind == "text":
+            print("# text: " + x.strip())
+            continue
+        nFrames += 1
+        print("# %s count=%d axis0=%g axis1=%g" %
+              (x["type"], x["count"], x["axis0"], x["axis1"]))
+        for it in x["items"]:
+            print(",".join("%.9g" % v for v in it))
+    print("# %d frames" % nFrames)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    if len(sys.argv) == 2:
+        with open(sys.argv[1], "rb") as fin:
+            show(fin.read())
+        return 0
+    import serial                     # pyserial, only for live capture
+    port = serial.Serial(sys.argv[1], 115200, timeout=0.2)
+    port.write(b"BINARY 1\r")
+    time.sleep(0.2)
+    port.write((" ".join(sys.argv[2:]) + "\r").encode("ascii"))
+    data = bytearray()
+    tEnd = time.time() + 3.0
+    while time.time() < tEnd:
+        data += port.read(65536)
+    show(bytes(data))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""avnaLogDecode.py  -  Convert the AVNA LOG files, LOGnnn.BIN, to CSV.
+
+The file layout is in AVNA8main/src/logR2/logR2.h and the values of each
+record type are in AVNA8main/AVNA8log.ino.
+
+    python3 avnaLogDecode.py LOG000.BIN LOG001.BIN ... > log.csv
+
+Files are read in the order given.  Records with a seq already seen (from a
+rewrite after the card was removed) are skipped and gaps in seq are noted.
+Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+"""
+
+import struct
+import sys
+
+HEADER = struct.Struct("<8sHHHHII")     # First bytes of the 512 byte sector
+RECORD = struct.Struct("<IIBBHf4f")     # 32 bytes
+TYPES = {1: "VVM", 2: "Z", 3: "T", 4: "ASA", 5: "LOCKIN"}
+
+
+def records(fileName):
+    """Yield (header, record tuple) for each record of one file."""
+    with open(fileName, "rb") as fin:
+        data = fin.read()
+    if len(data) < 512:
+        return
+    h = HEADER.unpack_from(data, 0)
+    if h[0] != b"AVNALOG\x00" or h[2] != RECORD.size:
+        sys.stderr.write("%s: not an AVNA log file\n" % fileName)
+        return
+    for off in range(512, len(data) - RECORD.size + 1, RECORD.size):
+        yield h, RECORD.unpack_from(data, off)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    seen = set()
+    lastSeq = None
+    print("file,ms,seq,type,flags,aux,freq,v0,v1,v2,v3")
+    for fileName in sys.argv[1:]:
+        for h, r in records(fileName):
+            ms, seq, rtype, flags, aux, f = r[:6]
+            if seq in seen:
+                continue
+            seen.add(seq)
+            if lastSeq is not None and seq != lastSeq + 1:
+                print("# gap, %d records lost" % (seq - lastSeq - 1))
+            lastSeq = seq
+            print("%d,%d,%d,%s,%d,%d,%.9g,%s" %
+                  (h[3], ms, seq, TYPES.get(rtype, str(rtype)), flags, aux,
+                   f, ",".join("%.9g" % v for v in r[6:])))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
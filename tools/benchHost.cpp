@@ -0,0 +1,73 @@
+/* benchHost.cpp  -  The BENCH command kernels of AVNA8main/src/benchR2 on a
+ * PC.
+ *
+ * Runs benchDSP() and benchFormat() on the same fixed seed data as BENCH on
+ * the Teensy, and prints the same machine-readable lines,
+ *     Benchmark, n=100, F_CPU=1000000000
+ *     Kernel, count, min us, ave us, max us
+ *     FFT1024 window, 100, ...
+ * so that one parser reads both.  The measureZ, print, sweep and ASA
+ * kernels use the sketch globals and only run on the Teensy.  The headers
+ * in tools/hostStubs stand in for the Teensy core, the Audio library and
+ * CMSIS.  The cycle counter is a nanosecond clock, and the q15 FFT is a
+ * plain radix-2, not CMSIS, so compare host runs with host runs only.
+ * SUMR2_EMULATE runs the SMLALD loop of sumInt16(), as sumR2HostTest.
+ * From the repository top:
+ *
+ *     g++ -O2 -fno-strict-aliasing -DSUMR2_EMULATE \
+ *         -I tools/hostStubs -I AVNA8main/src \
+ *         -o benchHost tools/benchHost.cpp \
+ *         AVNA8main/src/benchR2/benchR2.cpp AVNA8main/src/perfR2/perfR2.cpp \
+ *         AVNA8main/src/formatR2/formatR2.cpp \
+ *         AVNA8main/src/synth_GaussianWhiteNoiseR2/synth_GaussianWhiteNoiseR2.cpp
+ *     ./benchHost [n]
+ *
+ * n is the count per kernel, 1 to 10000, default 100, as BENCH.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#include "benchR2/benchR2.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The Audio library table, filled at the start as the Teensy one is made
+extern "C" {
+int16_t AudioWindowHanning1024[1024];
+}
+
+class StdoutPrint : public Print
+{
+public:
+    size_t write(uint8_t b) {
+        return fputc(b, stdout) == EOF ? 0 : 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) {
+        return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+static struct benchWork bw __attribute__((aligned(4)));
+static AudioSynthNoiseGaussian benchNoise;
+static StdoutPrint out;
+
+int main(int argc, char *argv[])
+{
+    long n = 100;
+
+    if (argc > 1) {
+        n = strtol(argv[1], NULL, 10);
+        if (n < 1 || n > 10000) {
+            printf("Error: n must be 1 to 10000\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < 1024; i++)
+        AudioWindowHanning1024[i] = (int16_t)lround(32767.0 *
+            (0.5 - 0.5*cos(2.0*PI*(double)i/1024.0)));
+
+    benchInputs(&bw);
+    benchHeader(out, (uint16_t)n);
+    benchDSP(out, &bw, (uint16_t)n, benchNoise);
+    benchFormat(out, &bw, (uint16_t)n);
+    return 0;
+}
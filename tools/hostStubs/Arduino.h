@@ -0,0 +1,127 @@
+/* Arduino.h  -  Host stand-in for the Teensy core, only as much as the
+ * AVNA8main/src libraries built by tools/benchHost.cpp use.
+ *
+ * The DWT cycle counter is a nanosecond clock and F_CPU is 1 GHz, so
+ * perfR2 prints microseconds.  Interrupts are no-ops.  Print::print(float,
+ * digits) works as the Teensy one, in double, so that formatFloat() is
+ * timed against the same algorithm.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#ifndef hostArduino_h_
+#define hostArduino_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define F_CPU 1000000000UL
+#define DEC 10
+#define PI 3.1415926535897932384626433832795
+
+static inline uint32_t hostNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static volatile uint32_t hostDebugReg;
+#define ARM_DWT_CYCCNT          hostNanos()
+#define ARM_DEMCR               hostDebugReg
+#define ARM_DEMCR_TRCENA        0
+#define ARM_DWT_CTRL            hostDebugReg
+#define ARM_DWT_CTRL_CYCCNTENA  0
+#define __disable_irq()         do {} while (0)
+#define __enable_irq()          do {} while (0)
+
+class Print
+{
+public:
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--)
+            n += write(*buffer++);
+        return n;
+    }
+
+    size_t print(const char *s) {
+        return write((const uint8_t *)s, strlen(s));
+    }
+    size_t print(char c)               { return write((uint8_t)c); }
+    size_t print(int n)                { return print((long)n); }
+    size_t print(unsigned int n)       { return print((unsigned long)n); }
+    size_t print(long n) {
+        if (n >= 0)
+            return printNumber((unsigned long)n, false);
+        return printNumber(0UL - (unsigned long)n, true);
+    }
+    size_t print(unsigned long n)      { return printNumber(n, false); }
+    size_t print(double x, int digits = 2) { return printFloat(x, digits); }
+
+    size_t println(void)               { return print("\r\n"); }
+    template <typename T> size_t println(T x) {
+        size_t n = print(x);
+        return n + println();
+    }
+    template <typename T> size_t println(T x, int digits) {
+        size_t n = print(x, digits);
+        return n + println();
+    }
+
+private:
+    size_t printNumber(unsigned long n, bool neg) {
+        char buf[24];
+        char *p = buf + sizeof(buf);
+        do {
+            *--p = '0' + (char)(n % 10);
+            n /= 10;
+        } while (n);
+        if (neg)
+            *--p = '-';
+        return write((const uint8_t *)p, buf + sizeof(buf) - p);
+    }
+
+    // As the Teensy core, rounding added in double, then digit by digit
+    size_t printFloat(double x, int digits) {
+        uint8_t buf[16];
+        size_t n;
+        int count = 1;
+        bool neg = false;
+        double rounding = 0.5;
+        unsigned long intPart;
+
+        if (isnan(x)) return print("nan");
+        if (isinf(x)) return print("inf");
+        if (x > 4294967040.0 || x < -4294967040.0) return print("ovf");
+        if (x < 0.0) {
+            neg = true;
+            x = -x;
+        }
+        for (int i=0; i<digits; i++)
+            rounding *= 0.1;
+        x += rounding;
+        intPart = (unsigned long)x;
+        x -= (double)intPart;
+        n = printNumber(intPart, neg);
+        if (digits > 0) {
+            if (digits > (int)sizeof(buf) - 1)
+                digits = sizeof(buf) - 1;
+            buf[0] = '.';
+            while (digits-- > 0) {
+                uint8_t d;
+                x *= 10.0;
+                d = (uint8_t)x;
+                buf[count++] = '0' + d;
+                x -= d;
+            }
+            n += write(buf, count);
+        }
+        return n;
+    }
+};
+#endif
@@ -0,0 +1,35 @@
+/* AudioStream.h  -  Host stand-in for the Teensy Audio library base class.
+ * There is no audio system.  allocate() gives no block, so an update() on
+ * the host does nothing, and only the parts timed on their own run.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#ifndef hostAudioStream_h_
+#define hostAudioStream_h_
+
+#include "Arduino.h"
+
+#define AUDIO_BLOCK_SAMPLES 128
+#define AUDIO_SAMPLE_RATE_EXACT 44117.64706f
+
+typedef struct audio_block_struct {
+    uint8_t ref_count;
+    uint8_t reserved1;
+    uint16_t memory_pool_index;
+    int16_t data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream
+{
+public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue) { }
+    virtual ~AudioStream() { }
+    virtual void update(void) = 0;
+
+protected:
+    static audio_block_t *allocate(void)          { return NULL; }
+    static void release(audio_block_t *block)     { }
+    void transmit(audio_block_t *block, unsigned char index = 0) { }
+    audio_block_t *receiveReadOnly(unsigned int index = 0) { return NULL; }
+};
+#endif
@@ -0,0 +1,73 @@
+/* arm_math.h  -  Host stand-in for the CMSIS DSP library, the types and the
+ * q15 complex FFT that benchR2 uses.  The FFT is a plain radix-2, in place,
+ * with the input bit reversed and a halving at each stage, so the output
+ * is scaled by 1/N as the CMSIS radix-4 q15 FFT.  It is not CMSIS, and
+ * neither the values nor the time are those of the Teensy.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#ifndef hostArm_math_h_
+#define hostArm_math_h_
+
+#include <stdint.h>
+#include <math.h>
+
+typedef float float32_t;
+typedef int16_t q15_t;
+
+#define HOST_FFT_MAX 1024
+
+typedef struct {
+    uint16_t fftLen;
+    uint8_t ifftFlag;
+    uint8_t bitReverseFlag;
+    q15_t twiddle[HOST_FFT_MAX];        // cos, sin for k = 0 to fftLen/2-1
+} arm_cfft_radix4_instance_q15;
+
+static inline int arm_cfft_radix4_init_q15(arm_cfft_radix4_instance_q15 *S,
+    uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag)
+{
+    if (fftLen > HOST_FFT_MAX || (fftLen & (fftLen - 1)))
+        return -1;
+    S->fftLen = fftLen;
+    S->ifftFlag = ifftFlag;
+    S->bitReverseFlag = bitReverseFlag;
+    for (int k=0; k<fftLen/2; k++) {
+        double a = 2.0*3.14159265358979323846*(double)k/(double)fftLen;
+        S->twiddle[2*k] = (q15_t)lround(32767.0*cos(a));
+        S->twiddle[2*k+1] = (q15_t)lround((ifftFlag ? 32767.0 : -32767.0)*sin(a));
+    }
+    return 0;
+}
+
+static inline void arm_cfft_radix4_q15(const arm_cfft_radix4_instance_q15 *S, q15_t *pSrc)
+{
+    uint16_t n = S->fftLen;
+    int16_t tr, ti;
+
+    for (uint16_t i=1, j=0; i<n; i++) {     // Bit reverse
+        uint16_t bit = n >> 1;
+        for ( ; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            tr = pSrc[2*i];  pSrc[2*i] = pSrc[2*j];  pSrc[2*j] = tr;
+            ti = pSrc[2*i+1];  pSrc[2*i+1] = pSrc[2*j+1];  pSrc[2*j+1] = ti;
+        }
+    }
+    for (uint16_t len=2; len<=n; len<<=1) {
+        uint16_t step = n/len;
+        for (uint16_t i=0; i<n; i+=len) {
+            for (uint16_t k=0; k<len/2; k++) {
+                int32_t wr = S->twiddle[2*k*step], wi = S->twiddle[2*k*step+1];
+                q15_t *a = pSrc + 2*(i + k), *b = pSrc + 2*(i + k + len/2);
+                int32_t br = (b[0]*wr - b[1]*wi) >> 15;
+                int32_t bi = (b[0]*wi + b[1]*wr) >> 15;
+                int32_t ar = a[0], ai = a[1];
+                a[0] = (q15_t)((ar + br) >> 1);  a[1] = (q15_t)((ai + bi) >> 1);
+                b[0] = (q15_t)((ar - br) >> 1);  b[1] = (q15_t)((ai - bi) >> 1);
+            }
+        }
+    }
+}
+#endif
@@ -0,0 +1,17 @@
+/* dspinst.h  -  Host stand-in for the Teensy Audio library DSP instruction
+ * wrappers, in C.  Only those used by the libraries that tools/ builds.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#ifndef hostDspinst_h_
+#define hostDspinst_h_
+
+#include <stdint.h>
+
+// SMUAD, the top halves times each other plus the bottom halves
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b)
+{
+    return (int32_t)(int16_t)(a >> 16)*(int16_t)(b >> 16) +
+           (int32_t)(int16_t)a*(int16_t)b;
+}
+#endif
@@ -0,0 +1,92 @@
+/* sumR2HostTest.cpp  -  Host check of sumInt16() in AVNA8main/src/sumR2.
+ *
+ * Runs the SMLALD loop of sumInt16(), with the instruction emulated in C
+ * (SUMR2_EMULATE), against a plain int64 loop.  The sums must be equal,
+ * bit for bit, for random blocks of every length 0 to 256 and for blocks
+ * of the extremes, -32768 and 32767, accumulated over as many blocks as the
+ * slowest measurement point uses.  From the repository top:
+ *
+ *     g++ -O2 -fno-strict-aliasing -I AVNA8main/src -o sumR2HostTest \
+ *         tools/sumR2HostTest.cpp
+ *     ./sumR2HostTest
+ *
+ * Prints one line per case and "PASS", or the first mismatch and "FAIL"
+ * with exit status 1.  Cycle counts are from BENCH on the Teensy, not here.
+ * Copyright (c) 2020 Robert Larkin, MIT license, see LICENSE.
+ */
+
+#define SUMR2_EMULATE
+#include "sumR2/sumR2.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Blocks in the slowest point, numTenths=10 of 0.1 s at 100 kHz
+#define LONG_BLOCKS 8000
+
+static int16_t block[256] __attribute__((aligned(4)));
+static uint32_t seed = 12345;
+static long nChecked = 0;
+
+static int16_t nextSample(void)
+{
+    seed = 1664525UL*seed + 1013904223UL;    // Fixed seed LCG, as BENCH
+    return (int16_t)(seed >> 16);
+}
+
+static int64_t sumScalar(const int16_t *pd, uint16_t n, int64_t acc)
+{
+    for (uint16_t i = 0; i < n; i++)
+        acc += pd[i];
+    return acc;
+}
+
+// Sums nBlocks of n samples both ways.  fill 0 is random, else the value.
+static bool check(const char *name, uint16_t n, long nBlocks, int32_t fill)
+{
+    int64_t accS = 0, accE = 0;
+
+    for (long b = 0; b < nBlocks; b++) {
+        for (uint16_t i = 0; i < n; i++)
+            block[i] = fill ? (int16_t)fill : nextSample();
+        accS = sumScalar(block, n, accS);
+        accE = sumInt16(block, n, accE);
+        nChecked++;
+        if (accS != accE) {
+            printf("%s, n=%u, block %ld: scalar %lld, SMLALD %lld\n", name,
+                   n, b, (long long)accS, (long long)accE);
+            return false;
+        }
+    }
+    printf("%s, n=%u, blocks=%ld, sum=%lld\n", name, n, nBlocks,
+           (long long)accS);
+    return true;
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    for (uint16_t n = 0; n <= 256 && ok; n++)
+        ok = check("random", n, 200, 0);
+    if (ok) ok = check("random long", 256, LONG_BLOCKS, 0);
+    if (ok) ok = check("all -32768", 256, LONG_BLOCKS, -32768);
+    if (ok) ok = check("all 32767", 256, LONG_BLOCKS, 32767);
+    if (ok) ok = check("all -32768 odd", 255, LONG_BLOCKS, -32768);
+    if (ok) ok = check("all 32767 odd", 255, LONG_BLOCKS, 32767);
+    // Alternating extremes, so the low word carries in both directions
+    for (long b = 0; b < 1000 && ok; b++) {
+        int64_t accS = 0x7FFFFFF0LL, accE = 0x7FFFFFF0LL;
+        for (uint16_t i = 0; i < 256; i++)
+            block[i] = ((i + b) & 1) ? 32767 : -32768;
+        accS = sumScalar(block, 256, accS);
+        accE = sumInt16(block, 256, accE);
+        nChecked++;
+        ok = (accS == accE);
+        if (!ok)
+            printf("alternating, block %ld: scalar %lld, SMLALD %lld\n", b,
+                   (long long)accS, (long long)accE);
+    }
+    printf("%ld blocks checked\n", nChecked);
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}